@@ -0,0 +1,546 @@
+#include "../include/AABB.h"
+#include "../include/BVH.h"
+#include "../include/Camera.h"
+#include "../include/Hitable.h"
+#include "../include/InstanceSet.h"
+#include "../include/Integrator.h"
+#include "../include/Material.h"
+#include "../include/RandomScene.h"
+#include "../include/Renderer.h"
+#include "../include/Scene.h"
+#include "../include/TriangleMesh.h"
+#include "../include/WavefrontIntegrator.h"
+#include "../include/glm/gtc/matrix_transform.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+// micro- and macro-benchmarks over fixed inputs: every benchmark draws from its own generator with a fixed seed, so
+// every run - on any machine, at any commit - measures the same work
+//
+// results are written to stdout as one JSON object per line, progress goes to stderr
+
+namespace
+{
+	//! settings for a benchmark run
+	struct BenchOptions
+	{
+		std::string filter;			// only benchmarks whose name contains this are run
+		uint32_t repetitions = 5;	// each benchmark is timed this many times and the fastest run is reported
+		uint32_t threadCount = 1;	// threads for the macro benchmarks, 0 for one per hardware thread
+		bool quick = false;			// smaller inputs, for a smoke test
+	};
+
+	//! a value the optimizer cannot see through, so that the benchmarked work cannot be thrown away
+	std::atomic<uint64_t> gSink{ 0 };
+
+	//! a stream of reproducible random numbers
+	class Random
+	{
+	public:
+		Random(uint32_t aSeed) : mEngine(aSeed) {}
+
+		float next() { return mDistribution(mEngine); };
+		float next(float aMin, float aMax) { return aMin + (aMax - aMin) * next(); };
+		glm::vec3 nextVec3(float aMin, float aMax) { float x = next(aMin, aMax); float y = next(aMin, aMax); return { x, y, next(aMin, aMax) }; };
+	private:
+		std::mt19937 mEngine;
+		std::uniform_real_distribution<float> mDistribution;
+	};
+
+	//! returns the seconds elapsed since the given time
+	double secondsSince(std::chrono::steady_clock::time_point aStart)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - aStart).count();
+	}
+
+	//! runs aBody aRepetitions times and returns the fastest run, in seconds
+	double fastestRun(uint32_t aRepetitions, const std::function<void()> &aBody)
+	{
+		double best = std::numeric_limits<double>::max();
+		for (uint32_t i = 0; i < aRepetitions; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			aBody();
+			best = std::min(best, secondsSince(start));
+		}
+		return best;
+	}
+
+	//! prints one result as a line of JSON
+	void report(const std::string &aName, double aValue, const char *aUnit)
+	{
+		std::cout << "{\"name\": \"" << aName << "\", \"value\": " << aValue << ", \"unit\": \"" << aUnit << "\"}" << std::endl;
+		std::cerr << "  " << aName << ": " << aValue << " " << aUnit << std::endl;
+	}
+
+	//! rays from random points on a shell of radius 20 towards random points near the origin, so that a good share of
+	//! them hits whatever sits there
+	std::vector<Ray> makeRays(size_t aCount, uint32_t aSeed, float aTargetRadius = 2.0f)
+	{
+		Random random{ aSeed };
+		std::vector<Ray> rays;
+		rays.reserve(aCount);
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			glm::vec3 origin = 20.0f * glm::normalize(random.nextVec3(-1.0f, 1.0f) + glm::vec3(1e-3f));
+			glm::vec3 target = random.nextVec3(-aTargetRadius, aTargetRadius);
+			rays.push_back(Ray(origin, target - origin, random.next()));
+		}
+		return rays;
+	}
+
+	//! times a call of aTest for every ray and reports the time per call
+	template<typename RayType, typename Test>
+	void benchmarkRays(const BenchOptions &aOptions, const std::string &aName, const std::vector<RayType> &aRays, uint32_t aPasses, Test &&aTest)
+	{
+		double seconds = fastestRun(aOptions.repetitions, [&]()
+		{
+			uint64_t hits = 0;
+			for (uint32_t pass = 0; pass < aPasses; ++pass)
+			{
+				for (const RayType &ray : aRays)
+				{
+					hits += aTest(ray) ? 1 : 0;
+				}
+			}
+			gSink += hits;
+		});
+		report(aName, 1e9 * seconds / (static_cast<double>(aRays.size()) * aPasses), "ns/op");
+	}
+
+	//! returns true if the benchmark with the given name was selected
+	bool selected(const BenchOptions &aOptions, const std::string &aName)
+	{
+		return aOptions.filter.empty() || aName.find(aOptions.filter) != std::string::npos;
+	}
+
+	void benchmarkPrimitives(const BenchOptions &aOptions)
+	{
+		const uint32_t passes = aOptions.quick ? 10 : 200;
+		std::vector<Ray> rays = makeRays(4096, 1);
+
+		if (selected(aOptions, "micro/aabb_hit"))
+		{
+			AABB box{ glm::vec3(-1.0f), glm::vec3(1.0f) };
+			benchmarkRays(aOptions, "micro/aabb_hit", rays, passes, [&](const Ray &aRay)
+			{
+				return box.hit(aRay, 0.001f, std::numeric_limits<float>::max());
+			});
+		}
+
+		if (selected(aOptions, "micro/aabb_hit_prepared"))
+		{
+			// the reciprocals are computed once per ray, as traversal does, so only the slab test itself is timed
+			AABB box{ glm::vec3(-1.0f), glm::vec3(1.0f) };
+			std::vector<TraversalRay> prepared;
+			prepared.reserve(rays.size());
+			for (const Ray &ray : rays)
+			{
+				prepared.push_back(TraversalRay(ray));
+			}
+			benchmarkRays(aOptions, "micro/aabb_hit_prepared", prepared, passes, [&](const TraversalRay &aRay)
+			{
+				return box.hit(aRay, 0.001f, std::numeric_limits<float>::max());
+			});
+		}
+
+		if (selected(aOptions, "micro/sphere_hit"))
+		{
+			Sphere sphere{ glm::vec3(0.0f), 1.0f, 0 };
+			benchmarkRays(aOptions, "micro/sphere_hit", rays, passes, [&](const Ray &aRay)
+			{
+				HitRecord record;
+				return sphere.hit(aRay, 0.001f, std::numeric_limits<float>::max(), record);
+			});
+		}
+
+		if (selected(aOptions, "micro/moving_sphere_hit"))
+		{
+			MovingSphere sphere{ glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f), 0.0f, 1.0f, 1.0f, 0 };
+			benchmarkRays(aOptions, "micro/moving_sphere_hit", rays, passes, [&](const Ray &aRay)
+			{
+				HitRecord record;
+				return sphere.hit(aRay, 0.001f, std::numeric_limits<float>::max(), record);
+			});
+		}
+	}
+
+	void benchmarkHierarchies(const BenchOptions &aOptions)
+	{
+		const uint32_t sphereCount = aOptions.quick ? 10000 : 100000;
+		const uint32_t passes = aOptions.quick ? 1 : 4;
+		const std::string suffix = "_" + std::to_string(sphereCount / 1000) + "k";
+		if (!selected(aOptions, "micro/bvhnode_hit" + suffix) && !selected(aOptions, "micro/scene_hit" + suffix))
+		{
+			return;
+		}
+
+		// the same random spheres in a box, once as a list of hitables and once in a scene
+		Random random{ 2 };
+		HitableListRef list = HitableList::create();
+		Scene scene;
+		const float extent = 2.0f * std::cbrt(static_cast<float>(sphereCount));
+		for (uint32_t i = 0; i < sphereCount; ++i)
+		{
+			glm::vec3 center = random.nextVec3(-extent, extent);
+			float radius = random.next(0.2f, 0.6f);
+			list->push_back(Sphere::create(center, radius, 0));
+			scene.addSphere(center, radius, 0);
+		}
+		std::vector<Ray> rays = makeRays(65536, 3, extent);
+
+		if (selected(aOptions, "micro/bvhnode_hit" + suffix))
+		{
+			BVHNode bvh{ list, 0.0f, 1.0f };
+			benchmarkRays(aOptions, "micro/bvhnode_hit" + suffix, rays, passes, [&](const Ray &aRay)
+			{
+				HitRecord record;
+				return bvh.hit(aRay, 0.001f, std::numeric_limits<float>::max(), record);
+			});
+		}
+
+		if (selected(aOptions, "micro/scene_hit" + suffix))
+		{
+			scene.build(0.0f, 1.0f);
+			benchmarkRays(aOptions, "micro/scene_hit" + suffix, rays, passes, [&](const Ray &aRay)
+			{
+				HitRecord record;
+				return scene.hit(aRay, 0.001f, std::numeric_limits<float>::max(), record);
+			});
+		}
+	}
+
+	//! a sphere of radius 2 tessellated into aRings rings of aSegments quads, two triangles each, with the vertices shared
+	//! between neighboring triangles
+	TriangleMeshRef makeSphereMesh(uint32_t aSegments, uint32_t aRings)
+	{
+		const float pi = 3.14159265f;
+		TriangleMeshRef mesh = TriangleMesh::create();
+		mesh->reserve(static_cast<size_t>(aSegments + 1) * (aRings + 1), 2 * static_cast<size_t>(aSegments) * aRings);
+		for (uint32_t j = 0; j <= aRings; ++j)
+		{
+			for (uint32_t i = 0; i <= aSegments; ++i)
+			{
+				float theta = pi * j / aRings;
+				float phi = 2.0f * pi * i / aSegments;
+				glm::vec3 normal{ std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi) };
+				mesh->addVertex(2.0f * normal, normal);
+			}
+		}
+		for (uint32_t j = 0; j < aRings; ++j)
+		{
+			for (uint32_t i = 0; i < aSegments; ++i)
+			{
+				uint32_t v00 = j * (aSegments + 1) + i;
+				uint32_t v10 = v00 + 1;
+				uint32_t v01 = v00 + aSegments + 1;
+				uint32_t v11 = v01 + 1;
+				mesh->addTriangle(v00, v10, v01, 0);
+				mesh->addTriangle(v10, v11, v01, 0);
+			}
+		}
+		return mesh;
+	}
+
+	void benchmarkMeshes(const BenchOptions &aOptions)
+	{
+		const uint32_t segments = aOptions.quick ? 64 : 512;
+		const uint32_t passes = aOptions.quick ? 1 : 4;
+		const std::string name = "micro/mesh_hit_" + std::to_string(segments * segments / 1000) + "k";
+		if (!selected(aOptions, name))
+		{
+			return;
+		}
+
+		TriangleMeshRef mesh = makeSphereMesh(segments, segments / 2);
+		mesh->build();
+		std::vector<Ray> rays = makeRays(65536, 5, 2.0f);
+		benchmarkRays(aOptions, name, rays, passes, [&](const Ray &aRay)
+		{
+			HitRecord record;
+			return mesh->hit(aRay, 0.001f, std::numeric_limits<float>::max(), record);
+		});
+	}
+
+	//! instances of one sphere mesh, turned and scaled at random and scattered around the origin - hits through the top
+	//! level, and rebuilding or refitting it after every instance has moved
+	void benchmarkInstances(const BenchOptions &aOptions)
+	{
+		const uint32_t instanceCount = aOptions.quick ? 1000 : 10000;
+		const uint32_t passes = aOptions.quick ? 1 : 4;
+		const std::string hitName = "micro/instance_hit_" + std::to_string(instanceCount / 1000) + "k";
+		const std::string rebuildName = "micro/instance_rebuild_" + std::to_string(instanceCount / 1000) + "k";
+		const std::string refitName = "micro/instance_refit_" + std::to_string(instanceCount / 1000) + "k";
+		if (!selected(aOptions, hitName) && !selected(aOptions, rebuildName) && !selected(aOptions, refitName))
+		{
+			return;
+		}
+
+		TriangleMeshRef mesh = makeSphereMesh(32, 16);
+		mesh->build();
+		InstanceSetRef instances = InstanceSet::create();
+		uint32_t geometry = instances->addGeometry(mesh);
+		Random random{ 6 };
+		for (uint32_t i = 0; i < instanceCount; ++i)
+		{
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), random.nextVec3(-2.0f, 2.0f));
+			transform = glm::rotate(transform, 6.2831853f * random.next(), glm::normalize(random.nextVec3(-1.0f, 1.0f) + glm::vec3(1e-3f)));
+			transform = glm::scale(transform, glm::vec3(0.02f + 0.04f * random.next()));
+			instances->addInstance(geometry, transform);
+		}
+		BVHBuildOptions buildOptions;
+		buildOptions.threadCount = aOptions.threadCount;
+		instances->build(buildOptions);
+
+		if (selected(aOptions, hitName))
+		{
+			std::vector<Ray> rays = makeRays(65536, 7, 2.0f);
+			benchmarkRays(aOptions, hitName, rays, passes, [&](const Ray &aRay)
+			{
+				HitRecord record;
+				return instances->hit(aRay, 0.001f, std::numeric_limits<float>::max(), record);
+			});
+		}
+
+		if (selected(aOptions, rebuildName))
+		{
+			glm::mat4 step = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.01f, 0.0f));
+			double seconds = fastestRun(aOptions.repetitions, [&]()
+			{
+				for (uint32_t i = 0; i < instanceCount; ++i)
+				{
+					instances->setTransform(i, step * instances->transform(i));
+				}
+				instances->build(buildOptions);
+			});
+			report(rebuildName, 1e3 * seconds, "ms");
+		}
+
+		if (selected(aOptions, refitName))
+		{
+			glm::mat4 step = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.01f, 0.0f));
+			double seconds = fastestRun(aOptions.repetitions, [&]()
+			{
+				for (uint32_t i = 0; i < instanceCount; ++i)
+				{
+					instances->setTransform(i, step * instances->transform(i));
+				}
+				instances->refit();
+			});
+			report(refitName, 1e3 * seconds, "ms");
+		}
+	}
+
+	void benchmarkMaterials(const BenchOptions &aOptions)
+	{
+		const uint32_t passes = aOptions.quick ? 10 : 200;
+		struct Case
+		{
+			const char *name;
+			MaterialRef material;
+		};
+		const Case cases[] = {
+			{ "micro/lambertian_scatter", std::make_shared<Lambertian>(glm::vec3(0.5f)) },
+			{ "micro/metallic_scatter", std::make_shared<Metallic>(glm::vec3(0.7f), 0.3f) },
+			{ "micro/dielectric_scatter", std::make_shared<Dieletric>(1.5f) }
+		};
+
+		// hits on a unit sphere, seen from the rays that produced them
+		std::vector<Ray> rays = makeRays(4096, 4, 0.5f);
+		std::vector<HitRecord> records;
+		std::vector<Ray> incoming;
+		Sphere sphere{ glm::vec3(0.0f), 1.0f, 0 };
+		for (const Ray &ray : rays)
+		{
+			HitRecord record;
+			if (sphere.hit(ray, 0.001f, std::numeric_limits<float>::max(), record))
+			{
+				records.push_back(record);
+				incoming.push_back(ray);
+			}
+		}
+
+		for (const Case &test : cases)
+		{
+			if (!selected(aOptions, test.name))
+			{
+				continue;
+			}
+			double seconds = fastestRun(aOptions.repetitions, [&]()
+			{
+				uint64_t scattered = 0;
+				for (uint32_t pass = 0; pass < passes; ++pass)
+				{
+					for (size_t i = 0; i < records.size(); ++i)
+					{
+						Sampler sampler{ static_cast<uint32_t>(i), pass };
+						glm::vec3 attenuation;
+						Ray ray;
+						ScatterType type;
+						scattered += test.material->scatter(incoming[i], records[i], sampler, attenuation, ray, type) ? 1 : 0;
+					}
+				}
+				gSink += scattered;
+			});
+			report(test.name, 1e9 * seconds / (static_cast<double>(records.size()) * passes), "ns/op");
+		}
+	}
+
+	void benchmarkBuilds(const BenchOptions &aOptions)
+	{
+		const uint32_t sphereCount = aOptions.quick ? 10000 : 1000000;
+		const char *methods[] = { "median", "sah", "lbvh" };
+		for (int method = 0; method < 3; ++method)
+		{
+			std::string name = std::string("macro/build_") + methods[method] + "_" + std::to_string(sphereCount / 1000) + "k";
+			if (!selected(aOptions, name))
+			{
+				continue;
+			}
+
+			SceneOptions sceneOptions;
+			sceneOptions.sphereCount = sphereCount;
+			BVHBuildOptions buildOptions;
+			buildOptions.splitMethod = static_cast<BVHSplitMethod>(method);
+			buildOptions.threadCount = aOptions.threadCount;
+			SceneRef scene = randomScene(sceneOptions, buildOptions);
+
+			double best = std::numeric_limits<double>::max();
+			for (uint32_t i = 0; i < aOptions.repetitions; ++i)
+			{
+				scene->build(0.0f, 1.0f, buildOptions);
+				best = std::min(best, scene->bvh().buildStats().milliseconds);
+			}
+			report(name, best, "ms");
+		}
+	}
+
+	void benchmarkRenders(const BenchOptions &aOptions)
+	{
+		const uint32_t width = aOptions.quick ? 80 : 320;
+		const uint32_t height = aOptions.quick ? 45 : 180;
+		const uint32_t samples = aOptions.quick ? 1 : 4;
+		const uint32_t sphereCounts[] = { 0, aOptions.quick ? 10000u : 100000u };
+
+		for (uint32_t sphereCount : sphereCounts)
+		{
+			for (int wavefront = 0; wavefront < 2; ++wavefront)
+			{
+				std::string name = std::string("macro/render_") + (wavefront ? "wavefront" : "path") + "_" + std::to_string(sphereCount / 1000) + "k";
+				if (!selected(aOptions, name))
+				{
+					continue;
+				}
+
+				// the scene and camera of RayTracer
+				SceneOptions sceneOptions;
+				sceneOptions.sphereCount = sphereCount;
+				BVHBuildOptions buildOptions;
+				buildOptions.threadCount = aOptions.threadCount;
+				SceneRef scene = randomScene(sceneOptions, buildOptions);
+				scene->build(0.0f, 0.0f, buildOptions);
+				Camera camera{ glm::vec3(13.0f, 2.0f, 3.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), float(width) / height, 10.0f, 20.0f, 0.0f, 0.0f, 1.0f };
+
+				RenderOptions renderOptions;
+				renderOptions.threadCount = aOptions.threadCount;
+				Renderer renderer{ renderOptions };
+				Integrator integrator;
+				WavefrontIntegrator wavefrontIntegrator;
+				Framebuffer framebuffer{ width, height };
+				std::atomic<uint64_t> rayCount{ 0 };
+
+				double seconds = fastestRun(aOptions.repetitions, [&]()
+				{
+					rayCount = 0;
+					renderer.render([&](const Tile &aTile, Framebuffer &aFramebuffer)
+					{
+						uint32_t tileRays = 0;
+						if (wavefront)
+						{
+							wavefrontIntegrator.render(aTile, aFramebuffer, camera, *scene, 0, samples, tileRays);
+						}
+						else
+						{
+							for (uint32_t j = aTile.y0; j < aTile.y1; ++j)
+							{
+								for (uint32_t i = aTile.x0; i < aTile.x1; ++i)
+								{
+									glm::vec3 color{ 0.0f };
+									for (uint32_t samp = 0; samp < samples; ++samp)
+									{
+										Sampler sampler{ j * width + i, samp };
+										glm::vec2 jitter = sampler.next2D();
+										Ray ray = camera.generateRay((i + jitter.x) / width, (j + jitter.y) / height, sampler);
+										color += integrator.radiance(ray, *scene, sampler, tileRays);
+									}
+									aFramebuffer.set(i, j, color / float(samples));
+								}
+							}
+						}
+						rayCount += tileRays;
+					}, framebuffer);
+				});
+				report(name, 1e-6 * rayCount / seconds, "Mrays/s");
+			}
+		}
+	}
+
+	//! parses "--filter TEXT", "--repetitions N", "--threads N" and "--quick 0|1"
+	BenchOptions parseOptions(int argc, char **argv)
+	{
+		BenchOptions options;
+		for (int i = 1; i + 1 < argc; i += 2)
+		{
+			const char *argument = argv[i + 1];
+			uint32_t value = static_cast<uint32_t>(std::strtoul(argument, nullptr, 10));
+			if (std::strcmp(argv[i], "--filter") == 0)
+			{
+				options.filter = argument;
+			}
+			else if (std::strcmp(argv[i], "--repetitions") == 0)
+			{
+				options.repetitions = std::max<uint32_t>(1, value);
+			}
+			else if (std::strcmp(argv[i], "--threads") == 0)
+			{
+				options.threadCount = value;
+			}
+			else if (std::strcmp(argv[i], "--quick") == 0)
+			{
+				options.quick = value != 0;
+			}
+			else
+			{
+				std::cerr << "Unknown option " << argv[i] << std::endl;
+			}
+		}
+		return options;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	BenchOptions options = parseOptions(argc, argv);
+
+	std::cerr << "micro benchmarks" << std::endl;
+	benchmarkPrimitives(options);
+	benchmarkHierarchies(options);
+	benchmarkMeshes(options);
+	benchmarkInstances(options);
+	benchmarkMaterials(options);
+
+	std::cerr << "macro benchmarks" << std::endl;
+	benchmarkBuilds(options);
+	benchmarkRenders(options);
+	return 0;
+}
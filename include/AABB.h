@@ -1,17 +1,80 @@
 #pragma once
 #include "Ray.h"
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 class AABB
 {
 public:
 	AABB() = default;
-	AABB(const glm::vec3 &aMin, const glm::vec3 &aMax);
+	AABB(const glm::vec3 &aMin, const glm::vec3 &aMax) :
+		mMin(aMin),
+		mMax(aMax)
+	{
+	}
 
 	glm::vec3 min() const { return mMin; };
 	glm::vec3 max() const { return mMax; };
+	glm::vec3 centroid() const { return 0.5f * (mMin + mMax); };
+	glm::vec3 extent() const { return mMax - mMin; };
 	bool hit(const Ray &aRay, float aTMin, float aTMax) const;
 
+	//! slab test for a ray whose reciprocal direction and signs were computed beforehand - the ray's sign bits select the
+	//! near and far plane of every slab, so there is neither a swap nor an early exit
+	//!
+	//! a ray parallel to a slab gets infinite distances, which the comparisons handle as they are; if it lies exactly in
+	//! one of the slab's planes the distance is 0 * inf = NaN, and since a comparison with NaN is false the interval
+	//! keeps its bound, so the ray counts as inside that slab - the exit distance gets a margin of kSlabExitScale
+	bool hit(const TraversalRay &aRay, float aTMin, float aTMax) const
+	{
+		// indexing the corners, rather than choosing one with a conditional, keeps the compiler from branching on the sign
+		const glm::vec3 *corners[2] = { &mMin, &mMax };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float t0 = ((*corners[aRay.dirIsNeg[axis]])[axis] - aRay.origin[axis]) * aRay.invDirection[axis];
+			float t1 = ((*corners[1 - aRay.dirIsNeg[axis]])[axis] - aRay.origin[axis]) * aRay.invDirection[axis];
+			aTMin = t0 > aTMin ? t0 : aTMin;
+			aTMax = t1 < aTMax ? t1 : aTMax;
+		}
+		return aTMin <= aTMax * kSlabExitScale;
+	}
+
+	//! returns the surface area of the box, or 0 for an empty box
+	float surfaceArea() const
+	{
+		glm::vec3 d = extent();
+		return (d.x < 0.0f || d.y < 0.0f || d.z < 0.0f) ? 0.0f : 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+	}
+
+	//! returns the index of the axis along which the box is longest
+	int maximumExtent() const
+	{
+		glm::vec3 d = extent();
+		return (d.x > d.y && d.x > d.z) ? 0 : (d.y > d.z ? 1 : 2);
+	}
+
+	//! grows the box to enclose another box
+	void extend(const AABB &aBox)
+	{
+		mMin = glm::min(mMin, aBox.mMin);
+		mMax = glm::max(mMax, aBox.mMax);
+	}
+
+	//! grows the box to enclose a point
+	void extend(const glm::vec3 &aPoint)
+	{
+		mMin = glm::min(mMin, aPoint);
+		mMax = glm::max(mMax, aPoint);
+	}
+
+	//! returns a box that contains nothing, for growing with extend() or enclosingBox()
+	static AABB empty()
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		return { glm::vec3(inf), glm::vec3(-inf) };
+	}
+
 	friend AABB enclosingBox(const AABB &lhs, const AABB &rhs)
 	{
 		glm::vec3 min{ std::fminf(lhs.mMin.x, rhs.mMin.x),
@@ -0,0 +1,73 @@
+#pragma once
+#include "Framebuffer.h"
+#include <memory>
+#include <vector>
+
+class AccumulationBuffer;
+using AccumulationBufferRef = std::shared_ptr<AccumulationBuffer>;
+
+//! sums the samples of every pixel over any number of render passes, along with how many samples each pixel has taken,
+//! so that an image can be resolved after every pass
+//!
+//! the variance of every pixel's luminance is tracked too, with Welford's running update, so that adaptive sampling can
+//! tell which pixels have converged
+class AccumulationBuffer
+{
+public:
+	AccumulationBuffer(uint32_t aWidth, uint32_t aHeight);
+
+	//! creates a shared pointer to an accumulation buffer object
+	static AccumulationBufferRef create(uint32_t aWidth, uint32_t aHeight);
+
+	uint32_t width() const { return mWidth; };
+	uint32_t height() const { return mHeight; };
+
+	//! adds aSamples samples of pixel (x, y), given their mean - distinct pixels may be added from different threads
+	void add(uint32_t aX, uint32_t aY, const glm::vec3 &aMean, uint32_t aSamples = 1)
+	{
+		addSamples(static_cast<size_t>(aY) * mWidth + aX, aMean, aSamples);
+	}
+
+	//! adds a pass in which every pixel took aSamples samples, whose means are stored in the framebuffer
+	void add(const Framebuffer &aPass, uint32_t aSamples = 1);
+
+	//! adds a pass in which only the pixels marked in aActive took a sample
+	void add(const Framebuffer &aPass, const std::vector<uint8_t> &aActive);
+
+	//! returns the number of samples pixel (x, y) has taken
+	uint32_t sampleCount(uint32_t aX, uint32_t aY) const { return mSampleCounts[static_cast<size_t>(aY) * mWidth + aX]; };
+
+	//! returns the mean of the samples of pixel (x, y), or black if it has not taken any
+	glm::vec3 mean(uint32_t aX, uint32_t aY) const;
+
+	//! returns the standard error of the mean luminance of pixel (x, y), relative to its mean luminance - pixels darker
+	//! than aLuminanceFloor are measured relative to the floor instead, so that noise in near-black pixels does not count
+	//! as a large error, and pixels with fewer than two samples have an infinite error
+	float relativeError(uint32_t aX, uint32_t aY, float aLuminanceFloor) const;
+
+	//! marks the pixels whose relative error exceeds aThreshold in aActive and returns how many there are
+	size_t findUnconverged(float aThreshold, float aLuminanceFloor, std::vector<uint8_t> &aActive) const;
+
+	//! writes the mean of every pixel into the framebuffer
+	void resolve(Framebuffer &aFramebuffer) const;
+
+	//! writes every pixel's sample count times aScale into the framebuffer as a gray level
+	void resolveSampleCounts(Framebuffer &aFramebuffer, float aScale = 1.0f) const;
+
+	//! returns the total number of samples taken by all pixels
+	uint64_t totalSamples() const;
+
+	//! discards all samples
+	void clear();
+private:
+	//! adds aSamples samples of the pixel with the given index, given their mean - several samples at once are counted as
+	//! that many samples of the mean luminance
+	void addSamples(size_t aIndex, const glm::vec3 &aMean, uint32_t aSamples);
+
+	uint32_t mWidth;
+	uint32_t mHeight;
+	std::vector<glm::vec3> mSums;
+	std::vector<uint32_t> mSampleCounts;
+	std::vector<float> mLuminanceMeans;
+	std::vector<float> mLuminanceM2s;	// sums of squared differences from the running mean
+};
@@ -0,0 +1,648 @@
+#pragma once
+#include "Buffer.h"
+#include "Hitable.h"
+#include "RayPacket.h"
+#include "Simd.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+class SceneCacheReader;
+class SceneCacheWriter;
+class ThreadPool;
+
+class BVHNode;
+using BVHNodeRef = std::shared_ptr<BVHNode>;
+
+//! a compact (32 byte) node of a flattened bounding volume hierarchy - nodes are stored in depth-first order,
+//! so the first child of an interior node always directly follows its parent
+struct BVHLinearNode
+{
+	AABB bounds;
+	union
+	{
+		uint32_t primitivesOffset;	// leaf: index of the first primitive of this leaf among the primitives of its type
+		uint32_t secondChildOffset;	// interior: index of the second child
+	};
+	uint16_t primitiveCount;		// 0 for interior nodes
+	uint8_t axis;					// interior: axis along which the children were split
+	uint8_t primitiveType;			// leaf: type tag shared by all primitives of the leaf
+};
+static_assert(sizeof(BVHLinearNode) == 32, "BVHLinearNode should fit two nodes per cache line");
+
+//! a node of a collapsed N-wide BVH - the bounds of all children are stored in structure-of-arrays form,
+//! so that a single SIMD instruction sequence can slab-test all of them at once
+//!
+//! the node is not declared over-aligned: its bounds are only ever loaded unaligned, and std::vector does not honour
+//! the alignment of its type before C++17
+template<int N>
+struct BVHWideNode
+{
+	float bounds[2][3][N];		// [min / max][axis][child], unused slots hold an empty box
+	uint32_t children[N];		// interior child: index of its wide node, leaf child: offset of its first primitive
+	uint16_t counts[N];			// number of primitives of a leaf child, 0 for an interior child
+	uint8_t types[N];			// type tag of a leaf child
+	uint32_t childCount;
+};
+
+//! the bounds of a binary node at the start and at the end of the shutter interval, kept for hierarchies over moving
+//! primitives - a primitive moving linearly stays within the box interpolated between them at any time in between, and so
+//! does every node, since interpolating the union of boxes never gives less than the union of the interpolated boxes
+struct BVHMotionBounds
+{
+	AABB start;
+	AABB end;
+
+	//! returns the box at aS, 0 at the start of the interval and 1 at its end
+	AABB at(float aS) const
+	{
+		return { (1.0f - aS) * start.min() + aS * end.min(), (1.0f - aS) * start.max() + aS * end.max() };
+	};
+};
+
+//! a node of a collapsed N-wide BVH over moving primitives - like BVHWideNode, but with the bounds of all children at the
+//! start and at the end of the shutter interval, next to each other so that a visit touches as few cache lines as it can
+template<int N>
+struct BVHWideMotionNode
+{
+	float bounds[2][3][N];		// [min / max][axis][child] at the start of the interval, unused slots hold an empty box
+	float endBounds[2][3][N];	// the same at the end of the interval
+	uint32_t children[N];
+	uint16_t counts[N];
+	uint8_t types[N];
+	uint32_t childCount;
+};
+
+//! the strategy used to partition primitives at every interior node
+enum class BVHSplitMethod
+{
+	Median,	// split at the median centroid along the longest axis
+	SAH,	// binned surface area heuristic over all three axes
+	LBVH	// sort by Morton code and split where the highest differing bit changes - fastest to build, lowest quality
+};
+
+//! settings for building a BVH
+struct BVHBuildOptions
+{
+	BVHSplitMethod splitMethod = BVHSplitMethod::SAH;
+	uint32_t binCount = 12;			// number of candidate split bins per axis (SAH only)
+	uint32_t maxLeafSize = 4;		// leaves are forced to split above this many primitives
+	float traversalCost = 1.0f;		// cost of visiting an interior node, relative to...
+	float intersectionCost = 1.0f;	// ...the cost of one ray-primitive test
+	uint32_t width = 4;				// branching factor of the traversed tree: 2 (binary), 4 (SSE) or 8 (AVX)
+	uint32_t threadCount = 0;		// 0 uses one thread per hardware thread, 1 builds serially
+	uint32_t parallelThreshold = 4096;	// ranges with fewer primitives than this are always built by a single task
+	float refitCostLimit = 1.5f;	// refit() rebuilds once the SAH cost has grown past this multiple of the built one
+};
+
+//! a summary of the most recent build
+struct BVHBuildStats
+{
+	double milliseconds = 0.0;
+	uint32_t primitiveCount = 0;
+	uint32_t nodeCount = 0;
+	uint32_t leafCount = 0;
+	uint32_t maxDepth = 0;
+	uint32_t threadCount = 1;
+	uint32_t width = 2;
+	uint32_t wideNodeCount = 0;
+	float sahCost = 0.0f;	// expected cost of tracing a ray through the tree, in units of one ray-primitive test
+};
+
+//! slab-tests a ray against the first aChildCount children of a wide node, whose bounds are laid out as in
+//! BVHWideNode::bounds, writing the distance at which the ray enters each child and returning a bitmask of the children it
+//! hits - the ray's sign bits select the near and far planes, so empty slots always miss, and as in AABB::hit a NaN
+//! distance never replaces a bound (SSE max/min return their second operand on NaN) and the exit distance gets a margin
+//! of kSlabExitScale
+template<int N>
+inline uint32_t intersectChildren(const float (&aBounds)[2][3][N], uint32_t aChildCount, const TraversalRay &aRay, float aTMin, float aTMax, float *aTNear)
+{
+	uint32_t mask = 0;
+	for (int i = 0; i < N; ++i)
+	{
+		float tNear = aTMin;
+		float tFar = aTMax;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float t0 = (aBounds[aRay.dirIsNeg[axis]][axis][i] - aRay.origin[axis]) * aRay.invDirection[axis];
+			float t1 = (aBounds[1 - aRay.dirIsNeg[axis]][axis][i] - aRay.origin[axis]) * aRay.invDirection[axis];
+			tNear = t0 > tNear ? t0 : tNear;
+			tFar = t1 < tFar ? t1 : tFar;
+		}
+		aTNear[i] = tNear;
+		mask |= (tNear <= tFar * kSlabExitScale ? 1u : 0u) << i;
+	}
+	return mask & ((1u << aChildCount) - 1);
+}
+
+#if defined(RT_SSE)
+template<>
+inline uint32_t intersectChildren<4>(const float (&aBounds)[2][3][4], uint32_t aChildCount, const TraversalRay &aRay, float aTMin, float aTMax, float *aTNear)
+{
+	__m128 tNear = _mm_set1_ps(aTMin);
+	__m128 tFar = _mm_set1_ps(aTMax);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		__m128 origin = _mm_set1_ps(aRay.origin[axis]);
+		__m128 invDirection = _mm_set1_ps(aRay.invDirection[axis]);
+		__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(aBounds[aRay.dirIsNeg[axis]][axis]), origin), invDirection);
+		__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(aBounds[1 - aRay.dirIsNeg[axis]][axis]), origin), invDirection);
+		tNear = _mm_max_ps(t0, tNear);
+		tFar = _mm_min_ps(t1, tFar);
+	}
+	_mm_storeu_ps(aTNear, tNear);
+	return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tNear, _mm_mul_ps(tFar, _mm_set1_ps(kSlabExitScale))))) & ((1u << aChildCount) - 1);
+}
+#endif
+
+#if defined(RT_AVX)
+template<>
+inline uint32_t intersectChildren<8>(const float (&aBounds)[2][3][8], uint32_t aChildCount, const TraversalRay &aRay, float aTMin, float aTMax, float *aTNear)
+{
+	__m256 tNear = _mm256_set1_ps(aTMin);
+	__m256 tFar = _mm256_set1_ps(aTMax);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		__m256 origin = _mm256_set1_ps(aRay.origin[axis]);
+		__m256 invDirection = _mm256_set1_ps(aRay.invDirection[axis]);
+		__m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(aBounds[aRay.dirIsNeg[axis]][axis]), origin), invDirection);
+		__m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(aBounds[1 - aRay.dirIsNeg[axis]][axis]), origin), invDirection);
+		tNear = _mm256_max_ps(t0, tNear);
+		tFar = _mm256_min_ps(t1, tFar);
+	}
+	_mm256_storeu_ps(aTNear, tNear);
+	return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, _mm256_mul_ps(tFar, _mm256_set1_ps(kSlabExitScale)), _CMP_LE_OQ))) & ((1u << aChildCount) - 1);
+}
+#endif
+
+//! interpolates the bounds of the children of a wide node to aS, 0 at the start of the shutter interval and 1 at its end
+//! - empty slots may become NaN, which intersectChildren() masks off by the child count
+//!
+//! like intersectChildren(), this only ever loads unaligned
+template<int N>
+inline void interpolateChildren(const float (&aStart)[2][3][N], const float (&aEnd)[2][3][N], float aS, float (&aBounds)[2][3][N])
+{
+	for (int side = 0; side < 2; ++side)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (int i = 0; i < N; ++i)
+			{
+				aBounds[side][axis][i] = (1.0f - aS) * aStart[side][axis][i] + aS * aEnd[side][axis][i];
+			}
+		}
+	}
+}
+
+#if defined(RT_SSE)
+template<>
+inline void interpolateChildren<4>(const float (&aStart)[2][3][4], const float (&aEnd)[2][3][4], float aS, float (&aBounds)[2][3][4])
+{
+	__m128 s = _mm_set1_ps(aS);
+	__m128 r = _mm_set1_ps(1.0f - aS);
+	for (int side = 0; side < 2; ++side)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m128 bounds = _mm_add_ps(_mm_mul_ps(r, _mm_loadu_ps(aStart[side][axis])), _mm_mul_ps(s, _mm_loadu_ps(aEnd[side][axis])));
+			_mm_storeu_ps(aBounds[side][axis], bounds);
+		}
+	}
+}
+#endif
+
+#if defined(RT_AVX)
+template<>
+inline void interpolateChildren<8>(const float (&aStart)[2][3][8], const float (&aEnd)[2][3][8], float aS, float (&aBounds)[2][3][8])
+{
+	__m256 s = _mm256_set1_ps(aS);
+	__m256 r = _mm256_set1_ps(1.0f - aS);
+	for (int side = 0; side < 2; ++side)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m256 bounds = _mm256_add_ps(_mm256_mul_ps(r, _mm256_loadu_ps(aStart[side][axis])), _mm256_mul_ps(s, _mm256_loadu_ps(aEnd[side][axis])));
+			_mm256_storeu_ps(aBounds[side][axis], bounds);
+		}
+	}
+}
+#endif
+
+//! slab-tests a ray against all children of a wide node - the position in the shutter interval only matters to moving nodes
+template<int N>
+inline uint32_t intersectNode(const BVHWideNode<N> &aNode, float, const TraversalRay &aRay, float aTMin, float aTMax, float *aTNear)
+{
+	return intersectChildren<N>(aNode.bounds, aNode.childCount, aRay, aTMin, aTMax, aTNear);
+}
+
+//! slab-tests a ray against all children of a moving wide node, at aS in the shutter interval
+template<int N>
+inline uint32_t intersectNode(const BVHWideMotionNode<N> &aNode, float aS, const TraversalRay &aRay, float aTMin, float aTMax, float *aTNear)
+{
+	float bounds[2][3][N];
+	interpolateChildren<N>(aNode.bounds, aNode.endBounds, aS, bounds);
+	return intersectChildren<N>(bounds, aNode.childCount, aRay, aTMin, aTMax, aTNear);
+}
+
+//! the bounds and centroid of one primitive, computed once before building
+struct BVHPrimitiveInfo
+{
+	AABB bounds;
+	glm::vec3 centroid;
+	uint32_t index;
+	uint8_t type;
+};
+
+//! a flattened, pointer-free bounding volume hierarchy over an arbitrary set of primitives - the owner of the
+//! primitives reorders them by primitiveIndices() after building, so that every leaf covers a contiguous range
+//!
+//! primitives may be tagged with a type: leaves then never mix types, and the offset of a leaf counts only the
+//! primitives of its own type, so an owner that keeps one array per type can index that array directly
+class BVH
+{
+public:
+	//! the maximum depth of the hierarchy, which bounds the traversal stack
+	static const uint32_t kMaxDepth = 64;
+
+	//! builds the hierarchy over primitives with the given bounding boxes and, optionally, type tags
+	void build(const std::vector<AABB> &aBounds, const BVHBuildOptions &aOptions = BVHBuildOptions(), const std::vector<uint8_t> &aTypes = std::vector<uint8_t>());
+
+	//! builds the hierarchy over primitives that move during the shutter interval [aTime0, aTime1], given their boxes at its
+	//! start and at its end - the tree is split by the boxes halfway through the interval, and every node keeps its bounds
+	//! at both ends, so that a ray is tested against the box at its own time rather than against the swept box of every
+	//! primitive below, which grows with the motion - rays are expected to carry a time within the interval
+	void build(const std::vector<AABB> &aStartBounds, const std::vector<AABB> &aEndBounds, float aTime0, float aTime1, const BVHBuildOptions &aOptions = BVHBuildOptions(), const std::vector<uint8_t> &aTypes = std::vector<uint8_t>());
+
+	//! updates the bounds of all nodes to new bounds of the primitives the hierarchy was built over, in the same order, and
+	//! returns true - the tree keeps its topology, so only its bounds are recomputed, bottom-up, with subtrees spread over
+	//! the threads of the build options. primitives that move apart leave nodes overlapping ever more, so once the SAH cost
+	//! has grown past refitCostLimit times the cost the tree was built with - or if the primitives no longer match it, in
+	//! number or in type tags - the hierarchy is rebuilt with the type tags instead, and false is returned
+	bool refit(const std::vector<AABB> &aBounds, const std::vector<uint8_t> &aTypes = std::vector<uint8_t>());
+
+	//! refits a hierarchy built over moving primitives to their new bounds at both ends of the shutter interval, like
+	//! refit() above
+	bool refit(const std::vector<AABB> &aStartBounds, const std::vector<AABB> &aEndBounds, float aTime0, float aTime1, const std::vector<uint8_t> &aTypes = std::vector<uint8_t>());
+
+	//! returns true if the hierarchy holds no primitives
+	bool empty() const { return mNodes.empty(); };
+
+	//! returns true if the hierarchy was built over moving primitives and keeps the bounds of its nodes at both ends of the
+	//! shutter interval
+	bool isMoving() const { return !mMotionBounds.empty(); };
+
+	//! returns the bounding box of the whole hierarchy, over the whole shutter interval if it moves
+	const AABB& bounds() const { return mNodes.front().bounds; };
+
+	//! returns the flattened nodes in depth-first order - the bounds of a moving node enclose it over the whole interval
+	const Buffer<BVHLinearNode>& nodes() const { return mNodes; };
+
+	//! returns, for every leaf-order slot, the index of the original primitive stored there
+	const Buffer<uint32_t>& primitiveIndices() const { return mPrimitiveIndices; };
+
+	//! replaces the index stored at every leaf-order slot - an owner that moves its primitives into leaf order after
+	//! building passes their new positions here, so that later refits read their bounds in the order they are stored in
+	void setPrimitiveIndices(std::vector<uint32_t> &&aIndices) { mPrimitiveIndices = std::move(aIndices); };
+
+	//! returns the timings and tree statistics of the most recent build
+	const BVHBuildStats& buildStats() const { return mBuildStats; };
+
+	//! returns the SAH cost of the nodes as they are now - the cost they were built with, or the cost after the latest refit
+	float sahCost() const { return mSAHCost; };
+
+	//! prints the build statistics
+	void printStats(std::ostream &aStream) const;
+
+	//! adds the nodes and primitive indices to a scene cache
+	void writeCache(SceneCacheWriter &aWriter) const;
+
+	//! replaces the hierarchy with the one stored in a scene cache, whose arrays are traversed in place, and returns true
+	//! if successful
+	bool readCache(const SceneCacheReader &aReader);
+
+	//! walks the hierarchy front to back with an explicit stack, calling aLeaf(first, count, type, tMax) for every leaf
+	//! the ray reaches - aLeaf returns true if it found a hit and shrinks tMax to that hit, so farther nodes get culled
+	template<typename LeafFunction>
+	bool intersect(const Ray &aRay, float aTMin, float aTMax, LeafFunction &&aLeaf) const;
+
+	//! walks the binary nodes with a whole packet of rays, calling aLeaf(first, count, type, mask) for every leaf that any
+	//! ray of the packet reaches - aLeaf intersects the rays of mask and shrinks their tMax in the packet
+	//!
+	//! whole nodes are culled by interval arithmetic on the packet's bounds when its rays share an octant, and subtrees
+	//! that at most a quarter of the rays enter are finished one ray at a time - the rays of a packet are spread over the
+	//! shutter interval, so only these single rays are tested against the boxes at their time
+	template<int N, typename LeafFunction>
+	void intersectPacket(RayPacket<N> &aPacket, float aTMin, LeafFunction &&aLeaf) const;
+private:
+	//! a subtree that a single thread refits - subtrees are stored contiguously in depth-first order, and so are the
+	//! primitives of their leaves
+	struct RefitTask
+	{
+		uint32_t node;
+		uint32_t end;		// one past the last node of the subtree
+		uint32_t firstSlot;	// first and one past the last primitive of its leaves, in leaf order
+		uint32_t endSlot;
+	};
+
+	//! splits the tree into refit tasks and records the binary node every child of the wide nodes stands for, which stay
+	//! the same for as long as the topology does
+	void prepareRefit(uint32_t aTaskSize);
+
+	//! returns the pool that builds and refits over this many primitives run on, or nullptr if they should run serially -
+	//! every hierarchy uses the program's shared pool for the thread count of its options, so neither rebuilding a
+	//! hierarchy every frame nor building many of them starts any threads of its own
+	ThreadPool* threadPool(size_t aPrimitiveCount);
+
+	//! returns where a time lies within the shutter interval, from 0 at its start to 1 at its end
+	float shutterPosition(float aTime) const
+	{
+		return std::min(std::max((aTime - mShutter.x) / (mShutter.y - mShutter.x), 0.0f), 1.0f);
+	};
+
+	//! traverses the binary nodes, starting at the given root - a moving hierarchy is tested at aS, the ray's position in
+	//! the shutter interval
+	template<typename LeafFunction>
+	bool intersectBinary(const TraversalRay &aRay, float aS, float aTMin, float aTMax, LeafFunction &&aLeaf, uint32_t aRoot = 0) const;
+
+	//! traverses the collapsed N-wide nodes - BVHWideNode or, tested at aS, BVHWideMotionNode - testing all children of a
+	//! node at once and visiting them nearest first
+	template<int N, template<int> class Node, typename LeafFunction>
+	bool intersectWide(const Node<N> *aNodes, float aS, const TraversalRay &aRay, float aTMin, float aTMax, LeafFunction &&aLeaf) const;
+
+	BVHBuildOptions mOptions;
+	BVHBuildStats mBuildStats;
+	bool mCached = false;	// read from a scene cache rather than built
+	Buffer<BVHLinearNode> mNodes;
+	Buffer<BVHWideNode<4>> mWideNodes4;
+	Buffer<BVHWideNode<8>> mWideNodes8;
+	Buffer<uint32_t> mPrimitiveIndices;
+	glm::vec2 mShutter{ 0.0f };	// the interval [open, close] a moving hierarchy was built for
+	Buffer<BVHMotionBounds> mMotionBounds;	// empty unless the hierarchy moves
+	Buffer<BVHWideMotionNode<4>> mWideMotionNodes4;	// replace the wide nodes of a moving hierarchy
+	Buffer<BVHWideMotionNode<8>> mWideMotionNodes8;
+	float mSAHCost = 0.0f;
+	std::vector<RefitTask> mRefitTasks;		// empty until the first refit after a build
+	std::vector<uint32_t> mRefitTopNodes;	// the interior nodes above the tasks' subtrees, in depth-first order
+	std::vector<uint32_t> mWideSources;		// the binary node of every child of a wide node, width entries per node
+};
+
+template<typename LeafFunction>
+bool BVH::intersect(const Ray &aRay, float aTMin, float aTMax, LeafFunction &&aLeaf) const
+{
+	if (mNodes.empty())
+	{
+		return false;
+	}
+
+	RT_STAT_INCREMENT(StatCounter::BVHTraversals);
+	const TraversalRay ray(aRay);
+	const bool moving = isMoving();
+	const float s = moving ? shutterPosition(aRay.time()) : 0.0f;
+	switch (mOptions.width)
+	{
+	case 4:
+		return moving ? intersectWide(mWideMotionNodes4.data(), s, ray, aTMin, aTMax, aLeaf) : intersectWide(mWideNodes4.data(), s, ray, aTMin, aTMax, aLeaf);
+	case 8:
+		return moving ? intersectWide(mWideMotionNodes8.data(), s, ray, aTMin, aTMax, aLeaf) : intersectWide(mWideNodes8.data(), s, ray, aTMin, aTMax, aLeaf);
+	default:
+		return intersectBinary(ray, s, aTMin, aTMax, aLeaf);
+	}
+}
+
+template<int N, template<int> class Node, typename LeafFunction>
+bool BVH::intersectWide(const Node<N> *aNodes, float aS, const TraversalRay &aRay, float aTMin, float aTMax, LeafFunction &&aLeaf) const
+{
+	struct Entry
+	{
+		uint32_t index;	// wide node index, or first primitive of a leaf
+		uint16_t count;	// 0 for a node, number of primitives for a leaf
+		uint8_t type;	// type tag of a leaf
+		float tNear;	// distance at which the ray enters the entry's box
+	};
+
+	TraversalCounter counter;
+
+	// every visited node replaces one entry with at most N
+	Entry stack[kMaxDepth * (N - 1) + 1];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { 0, 0, 0, aTMin };
+	bool hitAnything = false;
+
+	while (stackSize > 0)
+	{
+		const Entry entry = stack[--stackSize];
+
+		// a closer hit may have been found since this entry was pushed
+		if (entry.tNear > aTMax)
+		{
+			continue;
+		}
+
+		if (entry.count > 0)
+		{
+			counter.leaf(entry.count);
+			if (aLeaf(entry.index, entry.count, entry.type, aTMax))
+			{
+				hitAnything = true;
+			}
+			continue;
+		}
+
+		const Node<N> &node = aNodes[entry.index];
+		counter.node();
+		float tNear[N];
+		uint32_t mask = intersectNode(node, aS, aRay, aTMin, aTMax, tNear);
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		// order the children that were hit by entry distance, then push them far to near so the nearest is popped first
+		Entry hits[N];
+		uint32_t hitCount = 0;
+		while (mask)
+		{
+			uint32_t i = firstBit(mask);
+			mask &= mask - 1;
+
+			Entry child{ node.children[i], node.counts[i], node.types[i], tNear[i] };
+			uint32_t j = hitCount++;
+			while (j > 0 && hits[j - 1].tNear > child.tNear)
+			{
+				hits[j] = hits[j - 1];
+				--j;
+			}
+			hits[j] = child;
+		}
+		while (hitCount > 0)
+		{
+			stack[stackSize++] = hits[--hitCount];
+		}
+	}
+	return hitAnything;
+}
+
+template<typename LeafFunction>
+bool BVH::intersectBinary(const TraversalRay &aRay, float aS, float aTMin, float aTMax, LeafFunction &&aLeaf, uint32_t aRoot) const
+{
+	TraversalCounter counter;
+	const BVHMotionBounds *motion = isMoving() ? mMotionBounds.data() : nullptr;
+
+	uint32_t stack[kMaxDepth];
+	uint32_t stackSize = 0;
+	uint32_t current = aRoot;
+	bool hitAnything = false;
+
+	while (true)
+	{
+		const BVHLinearNode &node = mNodes[current];
+		counter.node();
+		if (motion ? motion[current].at(aS).hit(aRay, aTMin, aTMax) : node.bounds.hit(aRay, aTMin, aTMax))
+		{
+			if (node.primitiveCount > 0)
+			{
+				counter.leaf(node.primitiveCount);
+				if (aLeaf(node.primitivesOffset, node.primitiveCount, node.primitiveType, aTMax))
+				{
+					hitAnything = true;
+				}
+				if (stackSize == 0)
+				{
+					break;
+				}
+				current = stack[--stackSize];
+			}
+			else
+			{
+				// visit the child on the near side of the split first and defer the far one
+				if (aRay.dirIsNeg[node.axis])
+				{
+					stack[stackSize++] = current + 1;
+					current = node.secondChildOffset;
+				}
+				else
+				{
+					stack[stackSize++] = node.secondChildOffset;
+					current = current + 1;
+				}
+			}
+		}
+		else
+		{
+			if (stackSize == 0)
+			{
+				break;
+			}
+			current = stack[--stackSize];
+		}
+	}
+	return hitAnything;
+}
+
+template<int N, typename LeafFunction>
+void BVH::intersectPacket(RayPacket<N> &aPacket, float aTMin, LeafFunction &&aLeaf) const
+{
+	struct Entry
+	{
+		uint32_t node;
+		uint32_t mask;	// rays that entered the parent
+	};
+
+	if (mNodes.empty() || aPacket.activeMask == 0)
+	{
+		return;
+	}
+
+	// the interval keeps the packet's starting tMax - recomputing it after every hit costs more than it culls, and the
+	// per-ray box test below uses the shrunken tMax anyway
+	RayPacketInterval interval;
+	interval.compute(aPacket, aPacket.activeMask);
+
+	RT_STAT_ADD(StatCounter::BVHTraversals, bitCount(aPacket.activeMask));
+	TraversalCounter counter;
+
+	// every visited node replaces one entry with two
+	Entry stack[kMaxDepth + 1];
+	uint32_t stackSize = 0;
+	stack[stackSize++] = { 0, aPacket.activeMask };
+
+	while (stackSize > 0)
+	{
+		const Entry entry = stack[--stackSize];
+		const BVHLinearNode &node = mNodes[entry.node];
+		counter.node(bitCount(entry.mask));
+		if (interval.misses(node.bounds, aTMin))
+		{
+			continue;
+		}
+
+		uint32_t mask = intersectBox(node.bounds, aPacket, aTMin) & entry.mask;
+		if (mask == 0)
+		{
+			continue;
+		}
+
+		// too few rays are left for the packet to pay off, so trace them through this subtree one by one
+		if (bitCount(mask) <= N / 4)
+		{
+			while (mask)
+			{
+				uint32_t i = firstBit(mask);
+				mask &= mask - 1;
+				float s = isMoving() ? shutterPosition(aPacket.rays[i].time()) : 0.0f;
+				intersectBinary(aPacket.traversalRay(i), s, aTMin, aPacket.tMax[i], [&](uint32_t aFirst, uint32_t aCount, uint32_t aType, float &aClosest)
+				{
+					bool hit = aLeaf(aFirst, aCount, aType, 1u << i);
+					aClosest = aPacket.tMax[i];
+					return hit;
+				}, entry.node);
+			}
+			continue;
+		}
+
+		if (node.primitiveCount > 0)
+		{
+			counter.leaf(node.primitiveCount, bitCount(mask));
+			aLeaf(node.primitivesOffset, node.primitiveCount, node.primitiveType, mask);
+			continue;
+		}
+
+		// visit the child on the near side of the split first, as seen by the first ray that entered this node
+		uint32_t first = firstBit(mask);
+		if (aPacket.invDirection[node.axis][first] < 0.0f)
+		{
+			stack[stackSize++] = { entry.node + 1, mask };
+			stack[stackSize++] = { node.secondChildOffset, mask };
+		}
+		else
+		{
+			stack[stackSize++] = { node.secondChildOffset, mask };
+			stack[stackSize++] = { entry.node + 1, mask };
+		}
+	}
+}
+
+//! a hitable that accelerates intersections with a list of hitables using a flattened BVH
+class BVHNode : public Hitable
+{
+public:
+	BVHNode() = default;
+	BVHNode(const HitableListRef &aList, float aTime0, float aTime1, const BVHBuildOptions &aOptions = BVHBuildOptions());
+
+	//! creates a shared pointer to a BVH built over the given list
+	static BVHNodeRef create(const HitableListRef &aList, float aTime0, float aTime1, const BVHBuildOptions &aOptions = BVHBuildOptions());
+
+	//! finds the closest intersection by traversing the hierarchy
+	bool hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const override;
+
+	//! returns the bounding box of the root node
+	bool boundingBox(float aTime0, float aTime1, AABB &aBox) const override;
+
+	//! returns the underlying hierarchy
+	const BVH& bvh() const { return mBVH; };
+private:
+	BVH mBVH;
+	std::vector<HitableRef> mPrimitives;	// primitives in leaf order
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+//! a contiguous array that either owns its elements, like a std::vector, or views elements stored elsewhere - e.g. in a
+//! memory-mapped file, which the view keeps alive through a shared owner - so that the same code reads arrays built in
+//! memory and arrays loaded without a copy
+//!
+//! a view is read-only: modifying it first copies its elements into storage of the buffer's own
+template<typename T>
+class Buffer
+{
+public:
+	Buffer() = default;
+
+	//! takes over the elements of a vector
+	Buffer(std::vector<T> &&aElements) :
+		mStorage(std::move(aElements))
+	{
+		update();
+	}
+
+	//! views aSize elements at aData, which stay valid as long as aOwner is alive
+	Buffer(const T *aData, size_t aSize, std::shared_ptr<const void> aOwner) :
+		mOwner(std::move(aOwner)),
+		mData(aData),
+		mSize(aSize)
+	{
+	}
+
+	Buffer(const Buffer &aOther) :
+		mStorage(aOther.mStorage),
+		mOwner(aOther.mOwner),
+		mData(aOther.mData),
+		mSize(aOther.mSize)
+	{
+		if (!mOwner)
+		{
+			update();
+		}
+	}
+
+	Buffer(Buffer &&aOther) noexcept
+	{
+		swap(aOther);
+	}
+
+	Buffer& operator=(Buffer aOther)
+	{
+		swap(aOther);
+		return *this;
+	}
+
+	void swap(Buffer &aOther) noexcept
+	{
+		// moving a vector's storage keeps its address, so the cached pointers stay valid
+		mStorage.swap(aOther.mStorage);
+		mOwner.swap(aOther.mOwner);
+		std::swap(mData, aOther.mData);
+		std::swap(mSize, aOther.mSize);
+	}
+
+	//! returns true if the elements are viewed rather than owned
+	bool isView() const { return mOwner != nullptr; };
+
+	const T* data() const { return mData; };
+	size_t size() const { return mSize; };
+	bool empty() const { return mSize == 0; };
+	const T& operator[](size_t aIndex) const { return mData[aIndex]; };
+	const T& front() const { return mData[0]; };
+	const T* begin() const { return mData; };
+	const T* end() const { return mData + mSize; };
+
+	//! returns the owned elements for modification, copying the elements of a view first - any change through the
+	//! returned vector has to be followed by update()
+	std::vector<T>& storage()
+	{
+		if (mOwner)
+		{
+			mStorage.assign(mData, mData + mSize);
+			mOwner.reset();
+		}
+		return mStorage;
+	}
+
+	//! refreshes the cached pointer and size after the owned elements were modified through storage()
+	void update()
+	{
+		mData = mStorage.data();
+		mSize = mStorage.size();
+	}
+
+	void push_back(const T &aValue)
+	{
+		storage().push_back(aValue);
+		update();
+	}
+
+	void clear()
+	{
+		*this = Buffer();
+	}
+private:
+	std::vector<T> mStorage;
+	std::shared_ptr<const void> mOwner;
+	const T *mData = nullptr;
+	size_t mSize = 0;
+};
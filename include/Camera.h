@@ -1,7 +1,7 @@
 #pragma once
 #include "Utils.h"
 #include "Ray.h"
-#include "glm/gtc/random.hpp"
+#include "Sampler.h"
 
 #define _USE_MATH_DEFINES // for C++
 #include <math.h>
@@ -13,8 +13,8 @@ public:
 	//! constructs a camera object
 	Camera(const glm::vec3 &eye, const glm::vec3 &lookAt, const glm::vec3 &up, float aspectRatio, float focus, float fov = 45.0f, float aperature = 1.0f, float t0 = 0.0f, float t1 = 1.0f);
 	
-	//! constructs a new ray at position uv on the camera's view plane
-	Ray generateRay(float u, float v) const;
+	//! constructs a new ray at position uv on the camera's view plane, sampling the lens and shutter with the given sampler
+	Ray generateRay(float u, float v, Sampler &aSampler) const;
 private:
 	glm::vec3 mOrigin;
 	glm::vec3 mLowerLeftCorner;
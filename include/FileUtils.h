@@ -0,0 +1,12 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+
+//! writes a file through a temporary file next to it, which replaces the file only once aWrite has filled it in and
+//! returned true - so a reader, or a job killed mid-write, never sees a partial file. returns true if successful
+bool writeFileAtomically(const std::string &aPath, const std::function<bool(std::ostream &aStream)> &aWrite);
+
+//! writes aSize bytes at aData to a file the same way
+bool writeFileAtomically(const std::string &aPath, const char *aData, size_t aSize);
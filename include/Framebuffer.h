@@ -0,0 +1,33 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <memory>
+#include <vector>
+
+class Framebuffer;
+using FramebufferRef = std::shared_ptr<Framebuffer>;
+
+//! a floating point RGB image that rendering threads write into - row 0 is the bottom of the image, matching the camera's v coordinate
+class Framebuffer
+{
+public:
+	Framebuffer(uint32_t aWidth, uint32_t aHeight);
+
+	//! creates a shared pointer to a framebuffer object
+	static FramebufferRef create(uint32_t aWidth, uint32_t aHeight);
+
+	uint32_t width() const { return mWidth; };
+	uint32_t height() const { return mHeight; };
+
+	//! returns the color stored at pixel (x, y)
+	const glm::vec3& at(uint32_t aX, uint32_t aY) const { return mPixels[aY * mWidth + aX]; };
+
+	//! stores a color at pixel (x, y) - distinct pixels may be written from different threads
+	void set(uint32_t aX, uint32_t aY, const glm::vec3 &aColor) { mPixels[aY * mWidth + aX] = aColor; };
+
+	//! returns a const reference to the underlying pixel storage
+	const std::vector<glm::vec3>& pixels() const { return mPixels; };
+private:
+	uint32_t mWidth;
+	uint32_t mHeight;
+	std::vector<glm::vec3> mPixels;
+};
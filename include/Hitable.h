@@ -5,7 +5,6 @@
 #include <memory>
 #include <vector>
 #include <iostream>
-#include <functional>
 
 class Hitable;
 using HitableRef = std::shared_ptr<Hitable>;
@@ -19,9 +18,6 @@ using SphereRef = std::shared_ptr<Sphere>;
 class MovingSphere;
 using MovingSphereRef = std::shared_ptr<MovingSphere>;
 
-class BVHNode;
-using BVHNodeRef = std::shared_ptr<BVHNode>;
-
 class Hitable
 {
 public:
@@ -63,10 +59,10 @@ class Sphere : public Hitable
 {
 public:
 	Sphere();
-	Sphere(const glm::vec3 &aCenter, float aRadius, const MaterialRef &aMaterial);
+	Sphere(const glm::vec3 &aCenter, float aRadius, uint32_t aMaterialId);
 	
 	//! creates a shared pointer to a sphere object
-	static SphereRef create(const glm::vec3 &aCenter, float aRadius, const MaterialRef &aMaterial);
+	static SphereRef create(const glm::vec3 &aCenter, float aRadius, uint32_t aMaterialId);
 
 	//! sphere-ray intersection test
 	bool hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const override;
@@ -74,7 +70,7 @@ public:
 	//! computes the bounding box of the sphere and returns true if sucessful (not all objects have bounding boxes)
 	bool boundingBox(float aTime0, float aTime1, AABB &aBox) const override;
 private:
-	MaterialRef mMaterial;
+	uint32_t mMaterialId;
 	glm::vec3 mCenter;
 	float mRadius;
 };
@@ -82,10 +78,10 @@ private:
 class MovingSphere : public Hitable
 {
 public:
-	MovingSphere(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, const MaterialRef &aMaterial);
+	MovingSphere(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, uint32_t aMaterialId);
 
 	//! creates a shared pointer to a sphere object
-	static MovingSphereRef create(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, const MaterialRef &aMaterial);
+	static MovingSphereRef create(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, uint32_t aMaterialId);
 
 	//! sphere-ray intersection test
 	bool hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const override;
@@ -96,28 +92,10 @@ public:
 	//! computes the bounding box of the moving sphere and returns true if sucessful (not all objects have bounding boxes)
 	bool boundingBox(float aTime0, float aTime1, AABB &aBox) const override;
 private:
-	MaterialRef mMaterial;
+	uint32_t mMaterialId;
 	glm::vec3 mCenter0;
 	glm::vec3 mCenter1;
 	float mTime0;
 	float mTime1;
 	float mRadius;
-};
-
-class BVHNode : public Hitable
-{
-public:
-	BVHNode() = default;
-	BVHNode(const HitableListRef &aList, float aTime0, float aTime1);
-	static BVHNodeRef create(const HitableListRef &aList, float aTime0, float aTime1);
-
-	virtual bool hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const override;
-	virtual bool boundingBox(float aTime0, float aTime1, AABB &aBox) const override;
-private:
-	//! returns a lambda to compare two object's bounding boxes along a specified axis
-	std::function<bool(HitableRef, HitableRef)> comparator(size_t aAxis) const;
-
-	HitableRef mLeft;
-	HitableRef mRight;
-	AABB mBox;
-};
+};
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+#include "Framebuffer.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+class ImageWriter;
+using ImageWriterRef = std::shared_ptr<ImageWriter>;
+
+//! the file formats an image can be written in
+enum class ImageFormat
+{
+	Auto,	// chosen from the extension of the output path
+	PPM,	// binary 8-bit RGB (P6), gamma corrected
+	PFM,	// 32-bit float RGB, linear
+	EXR		// OpenEXR with 16-bit half float RGB channels, uncompressed scanlines, linear
+};
+
+//! settings for writing images
+struct ImageOptions
+{
+	ImageFormat format = ImageFormat::Auto;
+	float gamma = 2.2f;		// applied to 8-bit formats only, float formats keep the linear values
+};
+
+//! encodes a float framebuffer into an image file - every format is assembled in memory and written with a single call
+class ImageWriter
+{
+public:
+	ImageWriter(const ImageOptions &aOptions = ImageOptions());
+
+	//! creates a shared pointer to an image writer object
+	static ImageWriterRef create(const ImageOptions &aOptions = ImageOptions());
+
+	//! returns the format implied by a file extension (.ppm, .pfm or .exr), or Auto if the extension is unknown
+	static ImageFormat formatFromPath(const std::string &aPath);
+
+	//! writes the framebuffer to the given path and returns true if successful - an existing file is replaced only once
+	//! the new one is complete, so images can be rewritten while a render progresses
+	bool write(const std::string &aPath, const Framebuffer &aFramebuffer) const;
+private:
+	//! encodes the framebuffer as a binary PPM
+	void encodePPM(const Framebuffer &aFramebuffer, std::vector<char> &aData) const;
+
+	//! encodes the framebuffer as a PFM
+	void encodePFM(const Framebuffer &aFramebuffer, std::vector<char> &aData) const;
+
+	//! encodes the framebuffer as a scanline OpenEXR file
+	void encodeEXR(const Framebuffer &aFramebuffer, std::vector<char> &aData) const;
+
+	ImageOptions mOptions;
+};
@@ -0,0 +1,80 @@
+#pragma once
+#include "BVH.h"
+#include <vector>
+
+class InstanceSet;
+using InstanceSetRef = std::shared_ptr<InstanceSet>;
+
+//! the top level of a two-level acceleration structure: every geometry - a mesh, a sphere set or any other hitable with
+//! a hierarchy of its own - is stored once, and instances place it into the world with an affine transform, so memory
+//! grows with the unique geometry and only a transform and an index per instance
+//!
+//! the set's own BVH is built over the world-space boxes of the instances, and rays that reach an instance are moved
+//! into its object space instead of the geometry into the world - the direction is transformed without normalizing, so
+//! distances along the ray stay the same in both spaces
+class InstanceSet : public Hitable
+{
+public:
+	InstanceSet() = default;
+
+	//! creates a shared pointer to an empty instance set
+	static InstanceSetRef create();
+
+	//! adds a geometry and returns its index - its own hierarchy must be built before the set is
+	uint32_t addGeometry(const HitableRef &aGeometry);
+
+	//! adds an instance of a geometry, placed into the world by the given object-to-world transform, and returns its index
+	uint32_t addInstance(uint32_t aGeometry, const glm::mat4 &aTransform);
+
+	//! replaces the object-to-world transform of an instance - takes effect with the next build() or refit()
+	void setTransform(uint32_t aInstance, const glm::mat4 &aTransform);
+
+	//! returns the object-to-world transform of an instance
+	const glm::mat4& transform(uint32_t aInstance) const { return mTransforms[aInstance]; };
+
+	//! returns the number of unique geometries
+	size_t geometryCount() const { return mGeometries.size(); };
+
+	//! returns the number of instances
+	size_t instanceCount() const { return mTransforms.size(); };
+
+	//! builds the BVH over the instances - only the boxes of the geometries are queried, so after changing transforms this
+	//! costs as much as building a BVH over as many boxes as there are instances, however large the geometries are
+	void build(const BVHBuildOptions &aOptions = BVHBuildOptions());
+
+	//! moves the built set to the current transforms of its instances by refitting its hierarchy, which is cheaper still
+	//! than build() as long as the instances keep near their neighbours - the hierarchy rebuilds itself, with the options
+	//! of the last build, once they have drifted too far apart (see BVH::refit())
+	void refit();
+
+	//! returns the set's hierarchy over its instances
+	const BVH& bvh() const { return mBVH; };
+
+	//! finds the closest intersection with any instance
+	bool hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const override;
+
+	//! computes the bounding box of all instances and returns true if the set is not empty
+	bool boundingBox(float aTime0, float aTime1, AABB &aBox) const override;
+private:
+	//! what traversal needs of an instance, stored in the leaf order of the BVH
+	struct LeafInstance
+	{
+		glm::vec4 worldToObject[3];	// the rows of the affine world-to-object transform
+		uint32_t geometry;
+	};
+
+	//! returns the world-space box of an instance of a geometry with the given object-space box
+	static AABB transformBox(const glm::mat4 &aTransform, const AABB &aBox);
+
+	//! computes the world-space box of every instance
+	std::vector<AABB> instanceBounds() const;
+
+	//! stores the inverse transforms of the instances in the leaf order of the BVH
+	void updateLeafInstances();
+
+	std::vector<HitableRef> mGeometries;
+	std::vector<glm::mat4> mTransforms;	// object-to-world, one per instance, in the order they were added
+	std::vector<uint32_t> mInstanceGeometries;
+	std::vector<LeafInstance> mLeafInstances;
+	BVH mBVH;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "Scene.h"
+#include "Sampler.h"
+#include <memory>
+
+class Integrator;
+using IntegratorRef = std::shared_ptr<Integrator>;
+
+//! how the wavefront integrator reorders secondary rays before tracing them, so that rays which visit the same nodes
+//! of the BVH are traced one after another
+enum class RaySortMode
+{
+	None,
+	Octant,	// by direction octant, then along a Morton curve over the origins of the batch
+	Morton	// along a 6D Morton curve over origin and direction
+};
+
+//! settings for tracing paths
+struct IntegratorOptions
+{
+	uint32_t maxDepth = 50;				// bounces of any kind after which a path is cut off
+	uint32_t maxDiffuseDepth = 50;		// diffuse bounces after which a path is cut off
+	uint32_t maxSpecularDepth = 50;		// specular (and glossy) bounces after which a path is cut off
+	uint32_t maxTransmissionDepth = 50;	// refractions after which a path is cut off
+	uint32_t rouletteDepth = 3;			// bounces after which Russian roulette may terminate a path
+	float tMin = 0.001f;				// offset that keeps scattered rays from hitting the surface they leave
+	uint32_t wavefrontSize = 1 << 16;	// paths in flight at once in the wavefront integrator
+	RaySortMode raySort = RaySortMode::None;	// reordering of secondary rays in the wavefront integrator
+	float raySortFraction = 0.25f;		// batches that have shrunk below this share of the paths they started with are traced unsorted
+};
+
+//! traces paths iteratively, carrying the product of all attenuations along the path as its throughput - once a path is
+//! deep enough, Russian roulette terminates it with a probability that grows as its throughput drops, and the survivors
+//! are weighted up to keep the estimate unbiased
+class Integrator
+{
+public:
+	Integrator(const IntegratorOptions &aOptions = IntegratorOptions());
+
+	//! creates a shared pointer to an integrator object
+	static IntegratorRef create(const IntegratorOptions &aOptions = IntegratorOptions());
+
+	//! returns the radiance arriving along the given camera ray and adds the number of rays traced to aRayCount
+	glm::vec3 radiance(const Ray &aRay, const Scene &aScene, Sampler &aSampler, uint32_t &aRayCount) const;
+
+	//! computes the radiance along every active camera ray of a packet (N = 4, 8 or 16) - the camera rays are traced
+	//! together, the rest of each path on its own
+	template<int N>
+	void radiance(RayPacket<N> &aPacket, const Scene &aScene, Sampler *aSamplers, glm::vec3 *aRadiance, uint32_t &aRayCount) const;
+
+	//! returns the color of the sky in the given direction
+	static glm::vec3 sky(const glm::vec3 &aDirection);
+
+	//! returns the integrator's settings
+	const IntegratorOptions& options() const { return mOptions; };
+private:
+	//! follows a path from the first hit of its camera ray, given whether and where the camera ray hit the scene
+	glm::vec3 continuePath(const Ray &aRay, bool aHit, const HitRecord &aRecord, const Scene &aScene, Sampler &aSampler, uint32_t &aRayCount) const;
+
+	IntegratorOptions mOptions;
+};
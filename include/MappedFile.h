@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+//! a read-only memory mapping of a whole file - the operating system pages the contents in on demand, so large files
+//! can be parsed in place, by several threads at once, without being copied into memory first
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile& operator=(const MappedFile &) = delete;
+
+	//! maps the file at the given path, replacing any previous mapping, and returns true if successful
+	bool open(const std::string &aPath);
+
+	//! unmaps the file
+	void close();
+
+	//! returns the first byte of the file, or nullptr if no file (or an empty one) is mapped
+	const char* data() const { return mData; };
+
+	//! returns the size of the file in bytes
+	size_t size() const { return mSize; };
+private:
+	const char *mData = nullptr;
+	size_t mSize = 0;
+#if defined(_WIN32)
+	void *mFile = nullptr;
+	void *mMapping = nullptr;
+#else
+	int mFile = -1;
+#endif
+};
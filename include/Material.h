@@ -1,7 +1,7 @@
 #pragma once
 #include "Utils.h"
 #include "Ray.h"
-#include "glm/gtc/random.hpp"
+#include "Sampler.h"
 #include <memory>
 
 class Material;
@@ -13,14 +13,45 @@ struct HitRecord
 	float t;
 	glm::vec3 position;
 	glm::vec3 normal;
-	MaterialRef material;
+	uint32_t materialId;	// index into the material table of the scene
+};
+
+//! the kind of interaction that produced a scattered ray - the integrator limits path depth separately for each
+enum class ScatterType
+{
+	Diffuse,
+	Specular,		// mirror and glossy reflection
+	Transmission	// refraction into or out of a surface
+};
+
+//! the kinds of material
+enum class MaterialType : uint32_t
+{
+	Lambertian,
+	Metallic,
+	Dieletric
+};
+
+//! the parameters of a material in plain form, which scene caches store in place of the material objects
+struct MaterialDesc
+{
+	MaterialType type;
+	glm::vec3 albedo;	// Lambertian and Metallic
+	float roughness;	// Metallic
+	float ior;			// Dieletric
 };
 
 class Material
 {
 public:
-	//! produces a scattered ray
-	virtual bool scatter(const Ray &aRay, const HitRecord &aRecord, glm::vec3 &aAttenuation, Ray &aScattered) const = 0;
+	//! creates the material a description stands for
+	static MaterialRef create(const MaterialDesc &aDesc);
+
+	//! produces a scattered ray, drawing any random numbers from the given sampler
+	virtual bool scatter(const Ray &aRay, const HitRecord &aRecord, Sampler &aSampler, glm::vec3 &aAttenuation, Ray &aScattered, ScatterType &aType) const = 0;
+
+	//! returns the type and parameters of the material
+	virtual MaterialDesc desc() const = 0;
 };
 
 class Lambertian : public Material
@@ -29,7 +60,9 @@ public:
 	Lambertian(const glm::vec3 &aAlbedo);
 
 	//! produces a scattered ray
-	bool scatter(const Ray &aRay, const HitRecord &aRecord, glm::vec3 &aAttenuation, Ray &aScattered) const override;
+	bool scatter(const Ray &aRay, const HitRecord &aRecord, Sampler &aSampler, glm::vec3 &aAttenuation, Ray &aScattered, ScatterType &aType) const override;
+
+	MaterialDesc desc() const override { return { MaterialType::Lambertian, mAlbedo, 0.0f, 0.0f }; };
 private:
 	glm::vec3 mAlbedo;
 };
@@ -40,7 +73,9 @@ public:
 	Metallic(const glm::vec3 &aAlbedo, float aRoughness = 0.0f);
 
 	//! produces a scattered ray
-	bool scatter(const Ray &aRay, const HitRecord &aRecord, glm::vec3 &aAttenuation, Ray &aScattered) const override;
+	bool scatter(const Ray &aRay, const HitRecord &aRecord, Sampler &aSampler, glm::vec3 &aAttenuation, Ray &aScattered, ScatterType &aType) const override;
+
+	MaterialDesc desc() const override { return { MaterialType::Metallic, mAlbedo, mRoughness, 0.0f }; };
 private:
 	glm::vec3 mAlbedo;
 	float mRoughness;
@@ -52,7 +87,9 @@ public:
 	Dieletric(float aIOR);
 
 	//! produces a scattered ray
-	bool scatter(const Ray &aRay, const HitRecord &aRecord, glm::vec3 &aAttenuation, Ray &aScattered) const override;
+	bool scatter(const Ray &aRay, const HitRecord &aRecord, Sampler &aSampler, glm::vec3 &aAttenuation, Ray &aScattered, ScatterType &aType) const override;
+
+	MaterialDesc desc() const override { return { MaterialType::Dieletric, glm::vec3(1.0f), 0.0f, mIOR }; };
 private:
 	float mIOR; // index of refraction
 
@@ -0,0 +1,71 @@
+#pragma once
+#include "ThreadPool.h"
+#include "TriangleMesh.h"
+#include <iostream>
+#include <string>
+
+class MeshLoader;
+using MeshLoaderRef = std::shared_ptr<MeshLoader>;
+
+//! the file formats a mesh can be loaded from
+enum class MeshFormat
+{
+	Auto,	// chosen from the extension of the path
+	OBJ,	// Wavefront OBJ - vertex positions and polygonal faces, everything else is ignored
+	PLY		// binary little-endian PLY - vertex positions, optional vertex normals and polygonal faces
+};
+
+//! settings for loading meshes
+struct MeshLoadOptions
+{
+	MeshFormat format = MeshFormat::Auto;
+	float scale = 1.0f;					// uniform scale applied to every vertex position
+	glm::vec3 translation{ 0.0f };		// added to every vertex position after scaling
+	uint32_t material = 0;				// scene material of every triangle
+	uint32_t threadCount = 0;			// 0 picks one per hardware thread
+};
+
+//! loads triangle meshes from OBJ and PLY files - the file is memory-mapped and split into chunks that are parsed in
+//! parallel, in two passes for text formats: the first counts the vertices and triangles of every chunk, so that the
+//! second can write them straight into the mesh's buffers at the offsets the counts imply, with no intermediate copies
+//!
+//! polygons are split into fans of triangles, and every index is checked against the vertex count - a file with an
+//! invalid index or number fails to load rather than producing a broken mesh
+class MeshLoader
+{
+public:
+	MeshLoader(const MeshLoadOptions &aOptions = MeshLoadOptions());
+
+	//! creates a shared pointer to a mesh loader object
+	static MeshLoaderRef create(const MeshLoadOptions &aOptions = MeshLoadOptions());
+
+	//! returns the format implied by a file extension (.obj or .ply), or Auto if the extension is unknown
+	static MeshFormat formatFromPath(const std::string &aPath);
+
+	//! replaces the vertices and triangles of the mesh with those of the file at the given path and returns true if
+	//! successful - the mesh's BVH still has to be built
+	bool load(const std::string &aPath, TriangleMesh &aMesh);
+
+	//! returns the size of the last file loaded in bytes
+	size_t loadedBytes() const { return mBytes; };
+
+	//! returns the wall-clock time the last load took, from opening the file to the last vertex written
+	double loadSeconds() const { return mSeconds; };
+
+	//! prints the size, time and throughput of the last load
+	void printStats(std::ostream &aStream) const;
+private:
+	//! parses an OBJ file in chunks of whole lines
+	bool loadOBJ(const char *aData, size_t aSize, TriangleMesh &aMesh);
+
+	//! parses a binary PLY file, splitting its vertex and face elements into ranges of items
+	bool loadPLY(const char *aData, size_t aSize, TriangleMesh &aMesh);
+
+	MeshLoadOptions mOptions;
+	ThreadPoolRef mPool;
+	std::string mPath;
+	size_t mBytes = 0;
+	double mSeconds = 0.0;
+	size_t mVertexCount = 0;
+	size_t mTriangleCount = 0;
+};
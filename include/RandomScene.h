@@ -0,0 +1,16 @@
+#pragma once
+#include "Scene.h"
+#include <random>
+
+//! settings for the generated scene
+struct SceneOptions
+{
+	uint32_t sphereCount = 0;	// number of small random spheres scattered around the large ones
+	bool sphereSet = false;		// keep the small spheres in their own sphere set instead of in the scene's BVH
+	bool motionBlur = false;	// the small diffuse spheres bounce up during the shutter interval [0, 1], as in images/Motion Blur.jpg
+	uint32_t seed = std::default_random_engine::default_seed;	// the same seed always generates the same scene
+};
+
+//! generates the scene of three large spheres on a ground plane, surrounded by small random spheres - the primitives are
+//! added but the scene's BVH is not built yet
+SceneRef randomScene(const SceneOptions &aOptions, const BVHBuildOptions &aBuildOptions = BVHBuildOptions());
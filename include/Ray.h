@@ -18,3 +18,31 @@ private:
 	float mTime;			// the time at which this ray was fired
 };
 
+
+//! slab tests compare the distance at which a ray enters a box with the distance at which it leaves it, scaled by this
+//! factor - each distance carries up to three rounding errors (reciprocal, difference and product), so without the margin
+//! a ray through an edge or a corner of a box may miss it, and a closed mesh would leak between its leaves (1 + 2 gamma(3))
+const float kSlabExitScale = 1.0000004f;
+
+//! a ray prepared for traversing a hierarchy of boxes - the reciprocal of its direction and the sign of each component
+//! are computed once per ray instead of once for every box it visits
+struct TraversalRay
+{
+	glm::vec3 origin;
+	glm::vec3 invDirection;	// a zero direction component gives an infinite reciprocal, with the sign of the zero
+	int dirIsNeg[3];		// 1 where invDirection is negative - selects the near plane of every slab
+
+	explicit TraversalRay(const Ray &aRay) :
+		TraversalRay(aRay.origin(), 1.0f / aRay.direction())
+	{
+	}
+
+	TraversalRay(const glm::vec3 &aOrigin, const glm::vec3 &aInvDirection) :
+		origin(aOrigin),
+		invDirection(aInvDirection)
+	{
+		dirIsNeg[0] = invDirection.x < 0.0f;
+		dirIsNeg[1] = invDirection.y < 0.0f;
+		dirIsNeg[2] = invDirection.z < 0.0f;
+	}
+};
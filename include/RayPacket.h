@@ -0,0 +1,169 @@
+#pragma once
+#include "AABB.h"
+#include "Ray.h"
+#include "Simd.h"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+//! a packet of N coherent rays, stored in structure-of-arrays form so that SIMD instructions can slab-test four of them
+//! against a box at once - lanes whose bit is clear in the active mask are ignored
+template<int N>
+struct RayPacket
+{
+	static_assert(N % 4 == 0 && N <= 32, "packets hold a multiple of four rays and at most 32");
+
+	Ray rays[N];
+	float origin[3][N];
+	float invDirection[3][N];
+	float tMax[N];				// distance to the closest hit found so far, per ray
+	uint32_t activeMask = 0;
+
+	//! fills lane aLane with the given ray and marks it active
+	void set(int aLane, const Ray &aRay, float aTMax = std::numeric_limits<float>::max())
+	{
+		rays[aLane] = aRay;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			origin[axis][aLane] = aRay.origin()[axis];
+			invDirection[axis][aLane] = 1.0f / aRay.direction()[axis];
+		}
+		tMax[aLane] = aTMax;
+		activeMask |= 1u << aLane;
+	}
+
+	//! returns the ray of lane aLane with the reciprocal direction already computed by set()
+	TraversalRay traversalRay(int aLane) const
+	{
+		return TraversalRay(glm::vec3(origin[0][aLane], origin[1][aLane], origin[2][aLane]),
+							glm::vec3(invDirection[0][aLane], invDirection[1][aLane], invDirection[2][aLane]));
+	}
+
+	//! fills lane aLane with a ray that never hits anything and marks it inactive, so that all lanes hold valid numbers
+	void clear(int aLane)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			origin[axis][aLane] = 0.0f;
+			invDirection[axis][aLane] = 1.0f;
+		}
+		tMax[aLane] = -1.0f;
+		activeMask &= ~(1u << aLane);
+	}
+};
+
+//! the bounding intervals of the origins and inverse directions of the rays of a packet - if every ray points to the
+//! same octant, interval arithmetic on these bounds culls a box for the whole packet with a single test
+struct RayPacketInterval
+{
+	glm::vec3 originMin;
+	glm::vec3 originMax;
+	glm::vec3 invDirectionMin;
+	glm::vec3 invDirectionMax;
+	float tMax;
+	bool coherent;
+
+	//! computes the intervals over the rays of aMask and returns true if they all point to the same octant
+	template<int N>
+	bool compute(const RayPacket<N> &aPacket, uint32_t aMask)
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		originMin = invDirectionMin = glm::vec3(inf);
+		originMax = invDirectionMax = glm::vec3(-inf);
+		tMax = -inf;
+		while (aMask)
+		{
+			uint32_t i = firstBit(aMask);
+			aMask &= aMask - 1;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				originMin[axis] = std::min(originMin[axis], aPacket.origin[axis][i]);
+				originMax[axis] = std::max(originMax[axis], aPacket.origin[axis][i]);
+				invDirectionMin[axis] = std::min(invDirectionMin[axis], aPacket.invDirection[axis][i]);
+				invDirectionMax[axis] = std::max(invDirectionMax[axis], aPacket.invDirection[axis][i]);
+			}
+			tMax = std::max(tMax, aPacket.tMax[i]);
+		}
+
+		// rays on both sides of an axis turn the inverse direction interval into (-inf, inf), which culls nothing
+		coherent = true;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			coherent = coherent && (invDirectionMin[axis] > 0.0f || invDirectionMax[axis] < 0.0f);
+		}
+		return coherent;
+	}
+
+	//! returns true if no ray of the packet can hit the box within [tMin, tMax] - conservative, so false may still mean
+	//! that all of them miss
+	bool misses(const AABB &aBox, float aTMin) const
+	{
+		if (!coherent)
+		{
+			return false;
+		}
+
+		float tNear = aTMin;
+		float tFar = tMax;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			// the near plane is the min plane for rays going in the positive direction, the max plane otherwise
+			bool negative = invDirectionMax[axis] < 0.0f;
+			float nearPlane = negative ? aBox.max()[axis] : aBox.min()[axis];
+			float farPlane = negative ? aBox.min()[axis] : aBox.max()[axis];
+
+			// the smallest possible entry and the largest possible exit distance over all rays
+			float n0 = (nearPlane - originMin[axis]) * invDirectionMin[axis];
+			float n1 = (nearPlane - originMin[axis]) * invDirectionMax[axis];
+			float n2 = (nearPlane - originMax[axis]) * invDirectionMin[axis];
+			float n3 = (nearPlane - originMax[axis]) * invDirectionMax[axis];
+			float f0 = (farPlane - originMin[axis]) * invDirectionMin[axis];
+			float f1 = (farPlane - originMin[axis]) * invDirectionMax[axis];
+			float f2 = (farPlane - originMax[axis]) * invDirectionMin[axis];
+			float f3 = (farPlane - originMax[axis]) * invDirectionMax[axis];
+			tNear = std::max(tNear, std::min(std::min(n0, n1), std::min(n2, n3)));
+			tFar = std::min(tFar, std::max(std::max(f0, f1), std::max(f2, f3)));
+		}
+		return tNear > tFar * kSlabExitScale;
+	}
+};
+
+//! slab-tests every ray of a packet against a box and returns the mask of rays that enter it within [tMin, tMax]
+template<int N>
+inline uint32_t intersectBox(const AABB &aBox, const RayPacket<N> &aPacket, float aTMin)
+{
+	uint32_t mask = 0;
+#if defined(RT_SSE)
+	const __m128 tMin = _mm_set1_ps(aTMin);
+	for (int group = 0; group < N; group += 4)
+	{
+		__m128 tNear = tMin;
+		__m128 tFar = _mm_loadu_ps(&aPacket.tMax[group]);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			__m128 origin = _mm_loadu_ps(&aPacket.origin[axis][group]);
+			__m128 invDirection = _mm_loadu_ps(&aPacket.invDirection[axis][group]);
+			__m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aBox.min()[axis]), origin), invDirection);
+			__m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(aBox.max()[axis]), origin), invDirection);
+			tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+			tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+		}
+		mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tNear, _mm_mul_ps(tFar, _mm_set1_ps(kSlabExitScale))))) << group;
+	}
+#else
+	for (int i = 0; i < N; ++i)
+	{
+		float tNear = aTMin;
+		float tFar = aPacket.tMax[i];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float t0 = (aBox.min()[axis] - aPacket.origin[axis][i]) * aPacket.invDirection[axis][i];
+			float t1 = (aBox.max()[axis] - aPacket.origin[axis][i]) * aPacket.invDirection[axis][i];
+			tNear = std::max(tNear, std::min(t0, t1));
+			tFar = std::min(tFar, std::max(t0, t1));
+		}
+		mask |= (tNear <= tFar * kSlabExitScale ? 1u : 0u) << i;
+	}
+#endif
+	return mask;
+}
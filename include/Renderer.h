@@ -0,0 +1,69 @@
+#pragma once
+#include "Framebuffer.h"
+#include "ThreadPool.h"
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+class Renderer;
+using RendererRef = std::shared_ptr<Renderer>;
+
+//! runtime settings for the tile scheduler
+struct RenderOptions
+{
+	uint32_t threadCount = 0;	// 0 uses one thread per hardware thread
+	uint32_t tileSize = 16;		// width and height of a square tile, in pixels
+};
+
+//! a rectangular block of pixels [x0, x1) x [y0, y1)
+struct Tile
+{
+	uint32_t x0;
+	uint32_t y0;
+	uint32_t x1;
+	uint32_t y1;
+};
+
+//! cuts the image into tiles and renders them on the shared work-stealing thread pool of its thread count (see
+//! ThreadPool::shared())
+class Renderer
+{
+public:
+	//! computes the final color of pixel (x, y) - called concurrently from many threads
+	using PixelFunction = std::function<glm::vec3(uint32_t aX, uint32_t aY)>;
+
+	//! fills in all pixels of a tile - called concurrently from many threads, for distinct tiles
+	using TileFunction = std::function<void(const Tile &aTile, Framebuffer &aFramebuffer)>;
+
+	Renderer(const RenderOptions &aOptions = RenderOptions());
+
+	//! creates a shared pointer to a renderer object
+	static RendererRef create(const RenderOptions &aOptions = RenderOptions());
+
+	//! evaluates the pixel function for every pixel of the framebuffer
+	void render(const PixelFunction &aPixelFunction, Framebuffer &aFramebuffer);
+
+	//! evaluates the tile function for every tile of the framebuffer, for callers that render blocks of pixels at once
+	void render(const TileFunction &aTileFunction, Framebuffer &aFramebuffer);
+
+	//! returns the tiles used by the most recent call to render()
+	const std::vector<Tile>& tiles() const { return mTiles; };
+
+	//! returns the number of threads that render tiles
+	size_t threadCount() const { return mPool->threadCount(); };
+
+	//! clears the utilization counters, so that the next report covers all calls to render() from here on - a run that
+	//! renders in several passes resets them once, before the first
+	void resetStats();
+
+	//! prints per-thread utilization of all calls to render() since the last resetStats()
+	void printStats(std::ostream &aStream) const;
+private:
+	//! splits an image into square tiles in scanline order, starting at the top of the image
+	void buildTiles(uint32_t aWidth, uint32_t aHeight);
+
+	RenderOptions mOptions;
+	ThreadPoolRef mPool;
+	std::vector<Tile> mTiles;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include "glm/glm.hpp"
+#include <cstdint>
+
+//! PCG-RXS-M-XS hash of a 32-bit value (Jarzynski and Olano, "Hash Functions for GPU Rendering")
+inline uint32_t pcgHash(uint32_t aValue)
+{
+	uint32_t state = aValue * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+	return (word >> 22u) ^ word;
+}
+
+//! a counter-based random number generator: every value is a pure function of (seed, pixel, sample, bounce, dimension),
+//! so a sampler can be created on the stack by whichever thread renders the pixel and images are identical regardless of
+//! thread count or tile order
+class Sampler
+{
+public:
+	//! creates the sampler of sample 0 of pixel 0, so that arrays of samplers can be declared before they are filled in
+	Sampler() : Sampler(0, 0) {}
+
+	Sampler(uint32_t aPixelIndex, uint32_t aSampleIndex, uint32_t aSeed = 0) :
+		mKey(pcgHash(pcgHash(pcgHash(aSeed) ^ aPixelIndex) ^ aSampleIndex)),
+		mStream(mKey),
+		mDimension(0)
+	{
+	}
+
+	//! restarts the sequence for the given path vertex (0 is the camera ray)
+	void startBounce(uint32_t aBounce)
+	{
+		mStream = pcgHash(mKey ^ (aBounce * 0x9e3779b9u));
+		mDimension = 0;
+	}
+
+	//! returns the next 32 random bits of the current bounce
+	uint32_t nextBits() { return pcgHash(mStream + mDimension++); };
+
+	//! returns a floating point number in [0, 1)
+	float next1D() { return static_cast<float>(nextBits() >> 8) * (1.0f / 16777216.0f); };
+
+	//! returns two floating point numbers in [0, 1)
+	glm::vec2 next2D()
+	{
+		float x = next1D();
+		return { x, next1D() };
+	};
+
+	//! returns a point uniformly distributed on the circle of the given radius
+	glm::vec2 circularRand(float aRadius)
+	{
+		float a = next1D() * 6.283185307179586f;
+		return glm::vec2(cosf(a), sinf(a)) * aRadius;
+	}
+
+	//! returns a point uniformly distributed on the sphere of the given radius
+	glm::vec3 sphericalRand(float aRadius)
+	{
+		float z = 2.0f * next1D() - 1.0f;
+		float a = next1D() * 6.283185307179586f;
+		float r = sqrtf(1.0f - z * z);
+		return glm::vec3(r * cosf(a), r * sinf(a), z) * aRadius;
+	}
+private:
+	uint32_t mKey;			// hash of seed, pixel and sample
+	uint32_t mStream;		// hash of key and bounce
+	uint32_t mDimension;	// number of values drawn during this bounce
+};
@@ -0,0 +1,151 @@
+#pragma once
+#include "BVH.h"
+#include <string>
+#include <vector>
+
+class Scene;
+using SceneRef = std::shared_ptr<Scene>;
+
+//! the primitive types a scene stores natively - every BVH leaf holds primitives of a single type and carries it as a tag
+enum class PrimitiveType : uint8_t
+{
+	Sphere,
+	MovingSphere,
+	Custom	// any other hitable, intersected through its virtual interface
+};
+
+//! a scene that keeps its primitives grouped by type in contiguous structure-of-arrays storage, so that intersecting a
+//! leaf is a direct, inlined loop over one array instead of a virtual call and a pointer chase per primitive
+class Scene : public Hitable
+{
+public:
+	Scene() = default;
+
+	//! creates a shared pointer to an empty scene
+	static SceneRef create();
+
+	//! adds a material to the scene's material table and returns its index
+	uint32_t addMaterial(const MaterialRef &aMaterial);
+
+	//! returns the material with the given index - hit records refer to materials by this index, so finding and copying
+	//! hits never touches a reference count
+	const Material& material(uint32_t aIndex) const { return *mMaterials[aIndex]; };
+
+	//! returns the number of materials in the scene's material table
+	size_t materialCount() const { return mMaterials.size(); };
+
+	//! adds a static sphere and returns its index among the static spheres
+	uint32_t addSphere(const glm::vec3 &aCenter, float aRadius, uint32_t aMaterial);
+
+	//! adds a sphere that moves linearly from aCenter0 at aTime0 to aCenter1 at aTime1 and returns its index among the
+	//! moving spheres
+	uint32_t addMovingSphere(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, uint32_t aMaterial);
+
+	//! moves the static sphere with the given index - takes effect with the next build() or refit()
+	void setSphereCenter(uint32_t aIndex, const glm::vec3 &aCenter);
+
+	//! replaces both ends of the motion of the moving sphere with the given index - takes effect with the next build() or
+	//! refit()
+	void setMovingSphereCenters(uint32_t aIndex, const glm::vec3 &aCenter0, const glm::vec3 &aCenter1);
+
+	//! adds any other hitable - it is intersected through its virtual interface, like in a hitable list
+	void add(const HitableRef &aHitable);
+
+	//! returns the total number of primitives
+	size_t size() const { return mSpheres.size() + mMovingSpheres.size() + mCustom.size(); };
+
+	//! builds the BVH over all primitives and reorders them into leaf order - must be called after adding primitives, with
+	//! the shutter interval of the camera: if any spheres move during it, the BVH keeps the bounds of its nodes at both
+	//! ends and tests rays against the boxes at their time
+	void build(float aTime0, float aTime1, const BVHBuildOptions &aOptions = BVHBuildOptions());
+
+	//! moves the built scene to the current positions of its primitives, custom ones included, by refitting its hierarchy,
+	//! which is cheaper than build() as long as the primitives keep near their neighbours - the hierarchy rebuilds itself,
+	//! with the options of the last build, once they have drifted too far apart or the primitives have changed, and they
+	//! are then reordered into the new leaf order
+	void refit(float aTime0, float aTime1);
+
+	//! returns the scene's hierarchy
+	const BVH& bvh() const { return mBVH; };
+
+	//! finds the closest intersection with any primitive of the scene
+	bool hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const override;
+
+	//! finds the closest intersection of every active ray of a packet (N = 4, 8 or 16), filling in aRecords for the rays
+	//! that hit something - returns the mask of those rays
+	template<int N>
+	uint32_t hitPacket(RayPacket<N> &aPacket, float aTMin, HitRecord *aRecords) const;
+
+	//! computes the bounding box of all primitives and returns true if the scene is not empty
+	bool boundingBox(float aTime0, float aTime1, AABB &aBox) const override;
+
+	//! returns true if the scene can be written to a scene cache, which takes a scene without custom primitives
+	bool cacheable() const { return mCustom.empty(); };
+
+	//! writes the built scene - its BVH, primitive arrays and material table - to a scene cache tagged with aKey and
+	//! returns true if successful - scenes with custom primitives cannot be cached
+	bool saveCache(const std::string &aPath, uint64_t aKey) const;
+
+	//! returns the scene stored in the cache at the given path, ready to render, or nullptr if there is no valid cache for
+	//! aKey - the BVH and primitive arrays are traversed in the mapped file, without being copied or rebuilt
+	static SceneRef loadCache(const std::string &aPath, uint64_t aKey);
+private:
+	//! static spheres in structure-of-arrays form
+	struct Spheres
+	{
+		Buffer<float> centerX;
+		Buffer<float> centerY;
+		Buffer<float> centerZ;
+		Buffer<float> radius;
+		Buffer<uint32_t> materials;
+		Buffer<uint32_t> slots;	// the position every sphere is stored at, by the order they were added in
+
+		size_t size() const { return radius.size(); };
+	};
+
+	//! moving spheres in structure-of-arrays form
+	struct MovingSpheres
+	{
+		Buffer<float> center0X;
+		Buffer<float> center0Y;
+		Buffer<float> center0Z;
+		Buffer<float> center1X;
+		Buffer<float> center1Y;
+		Buffer<float> center1Z;
+		Buffer<float> time0;
+		Buffer<float> time1;
+		Buffer<float> radius;
+		Buffer<uint32_t> materials;
+		Buffer<uint32_t> slots;	// the position every sphere is stored at, by the order they were added in
+
+		size_t size() const { return radius.size(); };
+	};
+
+	//! the closest hit found so far, resolved into a full record only once traversal is done
+	struct PrimitiveHit
+	{
+		PrimitiveType type;
+		uint32_t index;
+		float t;
+	};
+
+	//! computes the bounding box of every primitive at the start and at the end of an interval along with its type, in the
+	//! order spheres, moving spheres, custom
+	void primitiveBounds(float aTime0, float aTime1, std::vector<AABB> &aStartBounds, std::vector<AABB> &aEndBounds, std::vector<uint8_t> &aTypes) const;
+
+	//! reorders the primitives of every type into the leaf order of a newly built hierarchy, and points its leaves at their
+	//! new positions
+	void storeInLeafOrder();
+
+	//! intersects a range of primitives of one type, shrinking aTMax and updating aHit if any of them is hit closer
+	bool intersectLeaf(PrimitiveType aType, uint32_t aFirst, uint32_t aCount, const Ray &aRay, float aTMin, float &aTMax, PrimitiveHit &aHit, HitRecord &aRecord) const;
+
+	//! fills in a hit record for the closest hit, on a sphere or moving sphere
+	void fillRecord(const PrimitiveHit &aHit, const Ray &aRay, HitRecord &aRecord) const;
+
+	std::vector<MaterialRef> mMaterials;
+	Spheres mSpheres;
+	MovingSpheres mMovingSpheres;
+	std::vector<HitableRef> mCustom;
+	BVH mBVH;
+};
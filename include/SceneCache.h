@@ -0,0 +1,146 @@
+#pragma once
+#include "Buffer.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! the arrays a scene cache holds, each in a section of its own
+enum class SceneCacheSection : uint32_t
+{
+	BVHOptions,				// build options of the scene's BVH, which select its traversal
+	BVHStats,				// statistics of the build that produced it
+	BVHNodes,
+	BVHWideNodes4,
+	BVHWideNodes8,
+	BVHPrimitiveIndices,
+	BVHShutter,				// the shutter interval of a moving BVH
+	BVHMotionBounds,		// empty for a BVH that does not move
+	BVHWideMotionNodes4,	// replace the wide nodes of a moving BVH
+	BVHWideMotionNodes8,
+	Materials,
+	SphereCenterX,
+	SphereCenterY,
+	SphereCenterZ,
+	SphereRadius,
+	SphereMaterials,
+	SphereSlots,			// where each sphere is stored, in the order the spheres were added in
+	MovingSphereCenter0X,
+	MovingSphereCenter0Y,
+	MovingSphereCenter0Z,
+	MovingSphereCenter1X,
+	MovingSphereCenter1Y,
+	MovingSphereCenter1Z,
+	MovingSphereTime0,
+	MovingSphereTime1,
+	MovingSphereRadius,
+	MovingSphereMaterials,
+	MovingSphereSlots,
+	Count
+};
+
+//! a scene cache starts with this header, followed by one SceneCacheEntry per section and the sections themselves, each
+//! aligned to kSceneCacheAlignment bytes from the start of the file
+struct SceneCacheHeader
+{
+	char magic[8];			// "RTSCACHE"
+	uint32_t version;		// kSceneCacheVersion of the program that wrote the file
+	uint32_t byteOrder;		// 0x01020304 as stored by the host that wrote the file
+	uint64_t key;			// identifies what the scene was generated from, see SceneCacheReader::open()
+	uint32_t sectionCount;
+	uint32_t reserved;
+};
+
+struct SceneCacheEntry
+{
+	uint32_t section;		// a SceneCacheSection
+	uint32_t elementSize;	// sizeof one element, so that a change in the layout of a struct is caught on loading
+	uint64_t offset;		// in bytes from the start of the file
+	uint64_t size;			// in bytes
+};
+
+//! the version of the file format - bump it whenever the meaning of a section changes without changing its element size
+const uint32_t kSceneCacheVersion = 4;
+
+//! alignment of every section, which starts each array on a cache line of its own
+const uint64_t kSceneCacheAlignment = 64;
+
+//! collects the arrays of a scene and writes them as one cache file, in the layout in which they are traversed
+class SceneCacheWriter
+{
+public:
+	//! adds a section of aCount elements at aData, which have to stay valid until write() returns
+	template<typename T>
+	void add(SceneCacheSection aSection, const T *aData, size_t aCount)
+	{
+		mSections.push_back({ aSection, static_cast<uint32_t>(sizeof(T)), aData, aCount * sizeof(T) });
+	};
+
+	template<typename T>
+	void add(SceneCacheSection aSection, const Buffer<T> &aBuffer) { add(aSection, aBuffer.data(), aBuffer.size()); };
+
+	template<typename T>
+	void add(SceneCacheSection aSection, const std::vector<T> &aVector) { add(aSection, aVector.data(), aVector.size()); };
+
+	//! writes all sections to the given path, tagged with aKey, and returns true if successful - like images, the file is
+	//! written next to the target and renamed, so that another process never maps a partial cache
+	bool write(const std::string &aPath, uint64_t aKey) const;
+private:
+	struct Section
+	{
+		SceneCacheSection section;
+		uint32_t elementSize;
+		const void *data;
+		size_t size;
+	};
+
+	std::vector<Section> mSections;
+};
+
+//! maps a scene cache read-only and hands out its sections as buffers that view the mapping - nothing is copied, so
+//! loading costs only the page faults of the data actually touched, and processes that map the same file share its
+//! pages in memory
+//!
+//! the file is checked for its format, version, byte order, key and element sizes, but the contents of the sections
+//! are trusted to be what this program wrote
+class SceneCacheReader
+{
+public:
+	//! combines the bytes of a value into a running 64-bit FNV-1a hash, for computing keys - meant for scalars, as the
+	//! padding bytes of a struct are undefined
+	template<typename T>
+	static uint64_t hash(const T &aValue, uint64_t aHash = 14695981039346656037ull)
+	{
+		const unsigned char *bytes = reinterpret_cast<const unsigned char*>(&aValue);
+		for (size_t i = 0; i < sizeof(T); ++i)
+		{
+			aHash = (aHash ^ bytes[i]) * 1099511628211ull;
+		}
+		return aHash;
+	};
+
+	//! maps the file and returns true if it is a valid cache written with the given key - the key is whatever the caller
+	//! uses to tell scenes apart, e.g. a hash of the settings they were generated and built with, and a mismatch means
+	//! the cache is stale
+	bool open(const std::string &aPath, uint64_t aKey);
+
+	//! points aBuffer at the elements of a section and returns true, or returns false if the file has no such section or
+	//! it does not hold elements of type T
+	template<typename T>
+	bool read(SceneCacheSection aSection, Buffer<T> &aBuffer) const
+	{
+		const SceneCacheEntry *entry = find(aSection, sizeof(T));
+		if (!entry)
+		{
+			return false;
+		}
+		aBuffer = Buffer<T>(reinterpret_cast<const T*>(mFile->data() + entry->offset), static_cast<size_t>(entry->size / sizeof(T)), mFile);
+		return true;
+	};
+private:
+	//! returns the entry of a section with the given element size, or nullptr
+	const SceneCacheEntry* find(SceneCacheSection aSection, size_t aElementSize) const;
+
+	std::shared_ptr<MappedFile> mFile;
+	std::vector<SceneCacheEntry> mEntries;
+};
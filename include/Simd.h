@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+
+// the instruction sets used by the vectorized kernels are picked at compile time: SSE is part of every x86-64
+// target, AVX has to be enabled explicitly (-mavx or /arch:AVX) - everything else falls back to scalar loops
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RT_SSE 1
+#endif
+
+#if defined(__AVX__)
+#define RT_AVX 1
+#endif
+
+#if defined(RT_SSE) || defined(RT_AVX)
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//! returns the index of the lowest set bit of a non-zero mask
+inline uint32_t firstBit(uint32_t aMask)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, aMask);
+	return static_cast<uint32_t>(index);
+#else
+	return static_cast<uint32_t>(__builtin_ctz(aMask));
+#endif
+}
+
+//! returns the number of set bits in a mask
+inline uint32_t bitCount(uint32_t aMask)
+{
+#if defined(_MSC_VER)
+	return static_cast<uint32_t>(__popcnt(aMask));
+#else
+	return static_cast<uint32_t>(__builtin_popcount(aMask));
+#endif
+}
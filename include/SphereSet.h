@@ -0,0 +1,80 @@
+#pragma once
+#include "BVH.h"
+#include <vector>
+
+class SphereSet;
+using SphereSetRef = std::shared_ptr<SphereSet>;
+
+//! a large set of static spheres stored in structure-of-arrays form - the spheres are kept in the leaf order of their own
+//! BVH, so every leaf is a contiguous run that one SIMD kernel call intersects at once
+class SphereSet : public Hitable
+{
+public:
+	//! the number of spheres intersected by one kernel call, which is also the leaf size of the set's BVH
+	static const uint32_t kBatchSize = 8;
+
+	SphereSet() = default;
+
+	//! creates a shared pointer to an empty sphere set
+	static SphereSetRef create();
+
+	//! reserves storage for the given number of spheres
+	void reserve(size_t aCount);
+
+	//! appends a sphere that uses the scene material with the given index and returns its index
+	uint32_t push_back(const glm::vec3 &aCenter, float aRadius, uint32_t aMaterial);
+
+	//! moves the sphere with the given index, as returned by push_back() - takes effect with the next build() or refit()
+	void setCenter(uint32_t aIndex, const glm::vec3 &aCenter);
+
+	//! returns the center of the sphere with the given index
+	glm::vec3 center(uint32_t aIndex) const;
+
+	//! returns the number of spheres in the set
+	size_t size() const { return mCount; };
+
+	//! builds the BVH over the spheres and reorders them into leaf order - must be called after adding spheres
+	void build(const BVHBuildOptions &aOptions = BVHBuildOptions());
+
+	//! moves the built set to the current centers of its spheres by refitting its hierarchy, which is cheaper than build()
+	//! as long as the spheres keep near their neighbours - the hierarchy rebuilds itself, with the options of the last
+	//! build, once they have drifted too far apart, and the spheres are then reordered into the new leaf order
+	void refit();
+
+	//! returns the set's hierarchy
+	const BVH& bvh() const { return mBVH; };
+
+	//! finds the closest intersection with any sphere of the set
+	bool hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const override;
+
+	//! computes the bounding box of all spheres and returns true if the set is not empty
+	bool boundingBox(float aTime0, float aTime1, AABB &aBox) const override;
+
+	//! intersects spheres [first, first + count) with the ray, in batches of kBatchSize - returns true and updates aTMax
+	//! and aIndex if any of them is hit closer than aTMax
+	bool intersectRange(uint32_t aFirst, uint32_t aCount, const Ray &aRay, float aTMin, float &aTMax, uint32_t &aIndex) const;
+
+	//! fills in a hit record for a hit at distance aT on the sphere with the given index
+	void fillRecord(uint32_t aIndex, const Ray &aRay, float aT, HitRecord &aRecord) const;
+private:
+	//! intersects up to kBatchSize spheres starting at aFirst and returns the lane of the closest hit, or -1
+	int intersectBatch(uint32_t aFirst, uint32_t aCount, const Ray &aRay, float aTMin, float &aTMax) const;
+
+	//! resizes the arrays to hold aCount spheres plus one batch of padding, so that batches can always be loaded whole
+	void resize(size_t aCount);
+
+	//! computes the bounding box of every sphere in the order they are stored in
+	std::vector<AABB> sphereBounds() const;
+
+	//! reorders the spheres into the leaf order of a newly built hierarchy, and points its leaves at their new positions
+	void storeInLeafOrder();
+
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mRadius;
+	std::vector<uint32_t> mMaterialIds;
+	std::vector<uint32_t> mSlots;	// the position every sphere is stored at, by the order they were added in
+	size_t mCount = 0;
+	BVH mBVH;
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// the counters are compiled in unless RT_STATS is defined as 0 - compiled out, every RT_STAT_ macro expands to nothing
+// and its arguments are never evaluated
+#if !defined(RT_STATS)
+#define RT_STATS 1
+#endif
+
+//! the events counted while rendering
+enum class StatCounter
+{
+	BVHTraversals,		// rays traced through a BVH, whether from the scene, a sphere set or a BVHNode
+	BVHNodesVisited,	// binary nodes whose box was tested, or wide nodes whose children were tested
+	BVHLeavesVisited,
+	BVHPrimitiveTests,	// primitives in all leaves reached
+	ListTraversals,		// calls of HitableList::hit
+	ListObjectTests,	// objects tested by those calls
+	ScatterDiffuse,		// calls of Material::scatter, by the kind of interaction they produced
+	ScatterSpecular,
+	ScatterTransmission,
+	ScatterAbsorbed,	// calls of Material::scatter that produced no ray
+	PathsEscaped,		// paths that ended in the sky
+	PathsAbsorbed,		// paths that ended at a surface that scattered no ray
+	PathsDepthLimited,	// paths cut off by one of the depth limits
+	PathsRouletted,		// paths terminated by Russian roulette
+	Count
+};
+
+//! number of bins of the path length histogram: bin n counts the paths that traced n rays, the last bin every longer path
+const uint32_t kPathLengthBins = 17;
+
+//! the counters of one thread - padded, so that the counters of different threads never share a cache line
+struct StatCounters
+{
+	uint64_t counts[static_cast<size_t>(StatCounter::Count)] = {};
+	uint64_t pathLengths[kPathLengthBins] = {};
+	char padding[64];
+
+	uint64_t operator[](StatCounter aCounter) const { return counts[static_cast<size_t>(aCounter)]; };
+};
+
+//! the counters of all threads summed, together with the wall-clock phases of the run, ready to be reported
+struct StatsReport
+{
+	StatCounters counters;
+	std::vector<std::pair<std::string, double>> phases;	// name and seconds, in the order they ran
+	uint64_t rayCount = 0;		// rays traced, as counted by the integrators
+	uint64_t sampleCount = 0;	// camera samples taken
+	std::string renderPhase = "render";	// the phase over which rays per second are measured
+
+	//! prints a human-readable summary
+	void print(std::ostream &aStream) const;
+
+	//! writes the report as a single JSON object
+	void writeJson(std::ostream &aStream) const;
+};
+
+//! per-thread event counters, which each thread increments without synchronization - the counters of a thread are
+//! allocated the first time it counts something and kept until the program ends, so the counts of threads that have
+//! exited are not lost
+class Stats
+{
+public:
+	//! returns the counters of the calling thread
+	static StatCounters& local()
+	{
+		static thread_local StatCounters *tCounters = nullptr;
+		if (!tCounters)
+		{
+			tCounters = registerThread();
+		}
+		return *tCounters;
+	}
+
+	//! sums the counters of all threads - only meaningful while no other thread is counting, e.g. between renders
+	static StatCounters gather();
+
+	//! sets the counters of all threads to zero - only while no other thread is counting
+	static void reset();
+private:
+	//! allocates the counters of a new thread
+	static StatCounters* registerThread();
+};
+
+#if RT_STATS
+#define RT_STAT_ADD(aCounter, aValue) (Stats::local().counts[static_cast<size_t>(aCounter)] += (aValue))
+#define RT_STAT_INCREMENT(aCounter) RT_STAT_ADD(aCounter, 1)
+#define RT_STAT_PATH(aCounter, aLength) (RT_STAT_INCREMENT(aCounter), ++Stats::local().pathLengths[std::min<uint32_t>((aLength), kPathLengthBins - 1)])
+#else
+#define RT_STAT_ADD(aCounter, aValue) ((void)0)
+#define RT_STAT_INCREMENT(aCounter) ((void)0)
+#define RT_STAT_PATH(aCounter, aLength) ((void)0)
+#endif
+
+//! counts the nodes and leaves one traversal of a BVH visits in locals and adds them to the thread's counters once, when
+//! it goes out of scope - they are counted per ray, so a node tested by a packet of k rays counts k times
+#if RT_STATS
+struct TraversalCounter
+{
+	uint64_t nodes = 0;
+	uint64_t leaves = 0;
+	uint64_t primitives = 0;
+
+	~TraversalCounter()
+	{
+		StatCounters &counters = Stats::local();
+		counters.counts[static_cast<size_t>(StatCounter::BVHNodesVisited)] += nodes;
+		counters.counts[static_cast<size_t>(StatCounter::BVHLeavesVisited)] += leaves;
+		counters.counts[static_cast<size_t>(StatCounter::BVHPrimitiveTests)] += primitives;
+	}
+
+	void node(uint32_t aRays = 1) { nodes += aRays; };
+	void leaf(uint32_t aPrimitives, uint32_t aRays = 1) { leaves += aRays; primitives += static_cast<uint64_t>(aPrimitives) * aRays; };
+};
+#else
+struct TraversalCounter
+{
+	void node(uint32_t = 1) {};
+	void leaf(uint32_t, uint32_t = 1) {};
+};
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+using ThreadPoolRef = std::shared_ptr<ThreadPool>;
+
+//! counters gathered by each thread of a pool
+struct ThreadStats
+{
+	double busySeconds = 0.0;	// time spent inside tasks
+	uint64_t tasksExecuted = 0;	// total tasks run by this thread
+	uint64_t tasksStolen = 0;	// tasks taken from another thread's queue
+};
+
+//! a fixed-size pool of threads where every thread owns a queue of task indices: a thread
+//! works through its own queue front to back and, once empty, steals from the back of the others
+class ThreadPool
+{
+public:
+	using Task = std::function<void(size_t aTaskIndex, size_t aThreadIndex)>;
+
+	//! constructs a pool with the given number of threads (0 picks one per hardware thread) - the thread calling dispatch() acts as thread 0
+	ThreadPool(size_t aThreadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool& operator=(const ThreadPool &) = delete;
+
+	//! creates a shared pointer to a thread pool object
+	static ThreadPoolRef create(size_t aThreadCount = 0);
+
+	//! returns the pool of the given number of threads (0 for one per hardware thread) that the whole program shares -
+	//! the renderer, the mesh loader and every hierarchy dispatch to it, so only one set of threads per thread count is
+	//! ever started - it lives until the program ends, and must not be dispatched to from inside one of its own tasks
+	static ThreadPoolRef shared(size_t aThreadCount = 0);
+
+	//! returns the number of threads (including the dispatching thread) that execute tasks
+	size_t threadCount() const { return mWorkers.size(); };
+
+	//! runs the task once for every index in [0, aTaskCount) and blocks until all of them have finished
+	void dispatch(size_t aTaskCount, const Task &aTask);
+
+	//! returns a snapshot of the per-thread counters
+	std::vector<ThreadStats> stats() const;
+
+	//! returns the total wall-clock time spent inside dispatch()
+	double dispatchSeconds() const { return mDispatchSeconds; };
+
+	//! clears all per-thread counters
+	void resetStats();
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<size_t> queue;
+		ThreadStats stats;
+	};
+
+	//! the loop run by the background threads
+	void workerLoop(size_t aThreadIndex);
+
+	//! executes tasks until no queue has any work left
+	void drain(size_t aThreadIndex);
+
+	//! takes the next task from this thread's queue or steals one from another thread
+	bool acquire(size_t aThreadIndex, size_t &aTaskIndex, bool &aStolen);
+
+	std::vector<std::unique_ptr<Worker>> mWorkers;
+	std::vector<std::thread> mThreads;
+
+	std::mutex mDispatchMutex;
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	std::condition_variable mDone;
+	const Task *mTask = nullptr;
+	std::atomic<size_t> mRemaining{ 0 };
+	uint64_t mGeneration = 0;
+	bool mStop = false;
+	double mDispatchSeconds = 0.0;
+};
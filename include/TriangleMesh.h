@@ -0,0 +1,128 @@
+#pragma once
+#include "BVH.h"
+#include <vector>
+
+class TriangleMesh;
+using TriangleMeshRef = std::shared_ptr<TriangleMesh>;
+
+//! an indexed triangle mesh - vertices are shared between triangles and stored in structure-of-arrays form, and every
+//! triangle carries the index of its scene material
+//!
+//! the triangles are kept in the leaf order of the mesh's own BVH, with a copy of their corners in structure-of-arrays
+//! form next to the indices, so that every leaf is a contiguous run that one SIMD kernel call intersects at once -
+//! the normal of a hit faces the side from which the triangle's corners appear counter-clockwise, so closed meshes
+//! should be wound that way when seen from outside, like the outward normal of a sphere
+class TriangleMesh : public Hitable
+{
+public:
+	//! the number of triangles intersected by one kernel call, which is also the leaf size of the mesh's BVH
+	static const uint32_t kBatchSize = 4;
+
+	TriangleMesh() = default;
+
+	//! creates a shared pointer to an empty mesh
+	static TriangleMeshRef create();
+
+	//! reserves storage for the given number of vertices and triangles
+	void reserve(size_t aVertexCount, size_t aTriangleCount);
+
+	//! appends a vertex and returns its index
+	uint32_t addVertex(const glm::vec3 &aPosition);
+
+	//! appends a vertex with a shading normal and returns its index - the normals are only used if every vertex has one
+	uint32_t addVertex(const glm::vec3 &aPosition, const glm::vec3 &aNormal);
+
+	//! appends a triangle over three vertices that uses the scene material with the given index
+	void addTriangle(uint32_t aIndex0, uint32_t aIndex1, uint32_t aIndex2, uint32_t aMaterial);
+
+	//! resizes the vertex and triangle buffers, with or without shading normals, so that a loader can fill them in place
+	//! through the pointers below instead of adding vertices and triangles one by one
+	void resize(size_t aVertexCount, size_t aTriangleCount, bool aNormals);
+
+	//! returns the coordinates of all vertex positions along one axis
+	float* positions(int aAxis) { return aAxis == 0 ? mPositionX.data() : (aAxis == 1 ? mPositionY.data() : mPositionZ.data()); };
+
+	//! returns the components of all shading normals along one axis, or nullptr if the mesh has none
+	float* normals(int aAxis) { return mNormalX.empty() ? nullptr : (aAxis == 0 ? mNormalX.data() : (aAxis == 1 ? mNormalY.data() : mNormalZ.data())); };
+
+	//! returns the vertex indices of all triangles, three per triangle
+	uint32_t* indices() { return mIndices.data(); };
+
+	//! returns the material indices of all triangles
+	uint32_t* materialIds() { return mMaterialIds.data(); };
+
+	//! returns the number of vertices of the mesh
+	size_t vertexCount() const { return mPositionX.size(); };
+
+	//! returns the number of triangles of the mesh
+	size_t triangleCount() const { return mMaterialIds.size(); };
+
+	//! returns the position of the vertex with the given index
+	glm::vec3 position(uint32_t aIndex) const { return { mPositionX[aIndex], mPositionY[aIndex], mPositionZ[aIndex] }; };
+
+	//! moves the vertex with the given index - takes effect with the next build() or refit(), like any change made
+	//! through positions()
+	void setPosition(uint32_t aIndex, const glm::vec3 &aPosition);
+
+	//! builds the BVH over the triangles and reorders them into leaf order - must be called after adding triangles
+	void build(const BVHBuildOptions &aOptions = BVHBuildOptions());
+
+	//! moves the built mesh to the current positions of its vertices by refitting its hierarchy, which is cheaper than
+	//! build() as long as the mesh deforms without tearing apart - the hierarchy rebuilds itself, with the options of the
+	//! last build, once the triangles have drifted too far apart, and they are then reordered into the new leaf order
+	void refit();
+
+	//! returns the mesh's hierarchy
+	const BVH& bvh() const { return mBVH; };
+
+	//! finds the closest intersection with any triangle of the mesh
+	bool hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const override;
+
+	//! computes the bounding box of all triangles and returns true if the mesh is not empty
+	bool boundingBox(float aTime0, float aTime1, AABB &aBox) const override;
+private:
+	//! a ray transformed for the watertight test: the axis along which the ray is longest becomes z, and a shear maps
+	//! the direction onto (0, 0, 1), so that every triangle can be tested in 2D - computed once per ray
+	struct WatertightRay
+	{
+		glm::vec3 origin;
+		int kx;
+		int ky;
+		int kz;
+		float sx;
+		float sy;
+		float sz;
+
+		explicit WatertightRay(const Ray &aRay);
+	};
+
+	//! intersects triangles [first, first + count) with the ray, in batches of kBatchSize - returns true and updates
+	//! aTMax and aIndex if any of them is hit closer than aTMax
+	bool intersectRange(uint32_t aFirst, uint32_t aCount, const WatertightRay &aRay, float aTMin, float &aTMax, uint32_t &aIndex) const;
+
+	//! intersects up to kBatchSize triangles starting at aFirst and returns the lane of the closest hit, or -1
+	int intersectBatch(uint32_t aFirst, uint32_t aCount, const WatertightRay &aRay, float aTMin, float &aTMax) const;
+
+	//! fills in a hit record for a hit at distance aT on the triangle with the given index
+	void fillRecord(uint32_t aIndex, const Ray &aRay, float aT, HitRecord &aRecord) const;
+
+	//! computes the bounding box of every triangle in the order they are stored in
+	std::vector<AABB> triangleBounds() const;
+
+	//! reorders the triangles into the leaf order of a newly built hierarchy, and points its leaves at their new positions
+	void storeInLeafOrder();
+
+	//! copies the corners of every triangle into mCorners, padded with one batch of degenerate triangles
+	void updateCorners();
+
+	std::vector<float> mPositionX;
+	std::vector<float> mPositionY;
+	std::vector<float> mPositionZ;
+	std::vector<float> mNormalX;
+	std::vector<float> mNormalY;
+	std::vector<float> mNormalZ;
+	std::vector<uint32_t> mIndices;		// three vertex indices per triangle
+	std::vector<uint32_t> mMaterialIds;	// one per triangle
+	std::vector<float> mCorners[3][3];	// [corner][axis], one entry per triangle in leaf order
+	BVH mBVH;
+};
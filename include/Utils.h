@@ -1,10 +1,12 @@
 #pragma once
+#include "glm/glm.hpp"
+#include <cstdint>
 #include <random>
 
-//! returns a floating point number between 0 and 1
+//! returns a floating point number between 0 and 1 - meant for scene setup, rendering code draws from a Sampler instead
 inline float randFloat()
 {
-	static std::default_random_engine e;
+	static thread_local std::default_random_engine e;
 	static std::uniform_real_distribution<float> d;
 	return d(e);
 }
@@ -14,4 +16,21 @@ template<typename T>
 inline T lerp(const T &lhs, const T &rhs, float aT)
 {
 	return (1.0f - aT) * lhs + aT * rhs;
+}
+
+//! spreads the lower 10 bits of a value apart so that two zero bits separate each of them
+inline uint32_t expandBits(uint32_t aValue)
+{
+	aValue = (aValue * 0x00010001u) & 0xFF0000FFu;
+	aValue = (aValue * 0x00000101u) & 0x0F00F00Fu;
+	aValue = (aValue * 0x00000011u) & 0xC30C30C3u;
+	aValue = (aValue * 0x00000005u) & 0x49249249u;
+	return aValue;
+}
+
+//! returns the 30-bit Morton code of a point inside the unit cube
+inline uint32_t mortonCode(const glm::vec3 &aPoint)
+{
+	glm::vec3 p = glm::clamp(aPoint * 1024.0f, glm::vec3(0.0f), glm::vec3(1023.0f));
+	return (expandBits(static_cast<uint32_t>(p.x)) << 2) | (expandBits(static_cast<uint32_t>(p.y)) << 1) | expandBits(static_cast<uint32_t>(p.z));
 }
\ No newline at end of file
@@ -0,0 +1,108 @@
+#pragma once
+#include "Camera.h"
+#include "Framebuffer.h"
+#include "Integrator.h"
+#include "Renderer.h"
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+class WavefrontIntegrator;
+using WavefrontIntegratorRef = std::shared_ptr<WavefrontIntegrator>;
+
+//! the state of a batch of paths in structure-of-arrays form - path i is described by element i of every array
+struct PathQueue
+{
+	std::vector<Ray> rays;					// the ray each path is about to trace
+	std::vector<glm::vec3> throughputs;
+	std::vector<Sampler> samplers;
+	std::vector<uint32_t> slots;			// index of the path's radiance in the batch, in generation order
+	std::vector<uint32_t> typeDepths[3];	// bounces of each scatter type so far
+	std::vector<HitRecord> records;			// closest hit of the ray, written by the extend stage
+	std::vector<uint8_t> hits;				// 1 if the ray hit the scene
+	std::vector<uint8_t> alive;				// 1 if the path continues, written by the shade stage
+	std::vector<uint32_t> order;			// order in which the extend stage traces the rays, empty for queue order
+
+	size_t size() const { return rays.size(); };
+
+	//! resizes every array to hold the given number of paths and clears the trace order
+	void resize(size_t aSize);
+};
+
+//! time spent in the stages of the wavefront integrator, summed over all threads
+struct WavefrontStats
+{
+	uint64_t primaryRays = 0;
+	uint64_t secondaryRays = 0;
+	double primarySeconds = 0.0;	// extend stage, camera rays
+	double secondarySeconds = 0.0;	// extend stage, all later bounces
+	double sortSeconds = 0.0;
+	uint64_t sortedBatches = 0;
+};
+
+//! traces whole batches of paths one bounce at a time, instead of one path at a time from start to finish
+//!
+//! each bounce runs four stages over the entire queue: extend finds the closest hit of every ray, shade scatters the
+//! paths grouped by material (so each material's code and data stay hot while it runs) and applies Russian roulette,
+//! and compact moves the surviving paths to the front of the queue - new paths only enter the queue in the generate
+//! stage, so a batch drains before the next one starts
+//!
+//! secondary rays point in all directions, so an optional sort stage reorders them by a key built from their origin
+//! and direction before extend, letting rays that visit the same nodes of the BVH follow each other
+//!
+//! the random numbers, the order of operations on each path and the order in which the samples of a pixel are summed
+//! all match Integrator, so both produce the same image
+class WavefrontIntegrator
+{
+public:
+	WavefrontIntegrator(const IntegratorOptions &aOptions = IntegratorOptions());
+
+	//! creates a shared pointer to a wavefront integrator object
+	static WavefrontIntegratorRef create(const IntegratorOptions &aOptions = IntegratorOptions());
+
+	//! renders samples [aFirstSample, aFirstSample + aSamples) of every pixel of a tile, writes their mean into the
+	//! framebuffer and adds the number of rays traced to aRayCount - the paths of a tile are traced in batches of at most
+	//! wavefrontSize paths, and if aActive is given, only the pixels with a nonzero entry are rendered
+	void render(const Tile &aTile, Framebuffer &aFramebuffer, const Camera &aCamera, const Scene &aScene, uint32_t aFirstSample, uint32_t aSamples, uint32_t &aRayCount, const uint8_t *aActive = nullptr) const;
+
+	//! returns the integrator's settings
+	const IntegratorOptions& options() const { return mOptions; };
+
+	//! returns the stage timings accumulated since construction or the last call to resetStats()
+	WavefrontStats stats() const;
+
+	//! clears the stage timings
+	void resetStats();
+
+	//! prints the stage timings, so that ray sort modes can be compared by their effect on traversal time
+	void printStats(std::ostream &aStream) const;
+private:
+	//! fills the queue with the camera rays of paths [aFirst, aFirst + aCount), where path p is sample
+	//! aFirstSample + p % aSamples of the pixel with index aPixels[p / aSamples] in the framebuffer
+	void generate(const std::vector<uint32_t> &aPixels, uint32_t aFirst, uint32_t aCount, const Framebuffer &aFramebuffer, const Camera &aCamera, uint32_t aFirstSample, uint32_t aSamples, PathQueue &aQueue) const;
+
+	//! computes the order in which the extend stage traces the rays of the queue, by sorting the rays by their key -
+	//! only the order is sorted, since moving the path state costs more than the sorted traversal saves
+	void sort(PathQueue &aQueue) const;
+
+	//! finds the closest hit of every ray in the queue
+	void extend(const Scene &aScene, PathQueue &aQueue, uint32_t &aRayCount) const;
+
+	//! records the sky seen by paths that missed, and scatters the others material by material - aRadiance is indexed
+	//! by the paths' slots
+	void shade(const Scene &aScene, uint32_t aDepth, PathQueue &aQueue, glm::vec3 *aRadiance) const;
+
+	//! moves the paths that are still alive to the front of the queue, keeping their order, and drops the rest
+	void compact(PathQueue &aQueue) const;
+
+	IntegratorOptions mOptions;
+
+	// ray counts and stage timings in nanoseconds, added to by every thread
+	mutable std::atomic<uint64_t> mPrimaryRays{ 0 };
+	mutable std::atomic<uint64_t> mSecondaryRays{ 0 };
+	mutable std::atomic<uint64_t> mPrimaryNanoseconds{ 0 };
+	mutable std::atomic<uint64_t> mSecondaryNanoseconds{ 0 };
+	mutable std::atomic<uint64_t> mSortNanoseconds{ 0 };
+	mutable std::atomic<uint64_t> mSortedBatches{ 0 };
+};
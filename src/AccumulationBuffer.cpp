@@ -0,0 +1,139 @@
+#include "../include/AccumulationBuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	//! returns the Rec. 709 luminance of a linear color
+	inline float luminance(const glm::vec3 &aColor)
+	{
+		return 0.2126f * aColor.r + 0.7152f * aColor.g + 0.0722f * aColor.b;
+	}
+}
+
+AccumulationBuffer::AccumulationBuffer(uint32_t aWidth, uint32_t aHeight) :
+	mWidth(aWidth),
+	mHeight(aHeight),
+	mSums(static_cast<size_t>(aWidth) * aHeight, glm::vec3(0.0f)),
+	mSampleCounts(static_cast<size_t>(aWidth) * aHeight, 0),
+	mLuminanceMeans(static_cast<size_t>(aWidth) * aHeight, 0.0f),
+	mLuminanceM2s(static_cast<size_t>(aWidth) * aHeight, 0.0f)
+{
+}
+
+AccumulationBufferRef AccumulationBuffer::create(uint32_t aWidth, uint32_t aHeight)
+{
+	return AccumulationBufferRef(new AccumulationBuffer(aWidth, aHeight));
+}
+
+void AccumulationBuffer::add(const Framebuffer &aPass, uint32_t aSamples)
+{
+	const auto &pixels = aPass.pixels();
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		addSamples(i, pixels[i], aSamples);
+	}
+}
+
+void AccumulationBuffer::add(const Framebuffer &aPass, const std::vector<uint8_t> &aActive)
+{
+	const auto &pixels = aPass.pixels();
+	for (size_t i = 0; i < pixels.size(); ++i)
+	{
+		if (aActive[i])
+		{
+			addSamples(i, pixels[i], 1);
+		}
+	}
+}
+
+glm::vec3 AccumulationBuffer::mean(uint32_t aX, uint32_t aY) const
+{
+	size_t index = static_cast<size_t>(aY) * mWidth + aX;
+	return mSampleCounts[index] > 0 ? mSums[index] / float(mSampleCounts[index]) : glm::vec3(0.0f);
+}
+
+float AccumulationBuffer::relativeError(uint32_t aX, uint32_t aY, float aLuminanceFloor) const
+{
+	size_t index = static_cast<size_t>(aY) * mWidth + aX;
+	uint32_t count = mSampleCounts[index];
+	if (count < 2)
+	{
+		return std::numeric_limits<float>::infinity();
+	}
+
+	float variance = mLuminanceM2s[index] / float(count - 1);
+	float standardError = std::sqrt(variance / float(count));
+	return standardError / std::max(mLuminanceMeans[index], aLuminanceFloor);
+}
+
+size_t AccumulationBuffer::findUnconverged(float aThreshold, float aLuminanceFloor, std::vector<uint8_t> &aActive) const
+{
+	aActive.resize(mSums.size());
+	size_t count = 0;
+	for (uint32_t y = 0; y < mHeight; ++y)
+	{
+		for (uint32_t x = 0; x < mWidth; ++x)
+		{
+			bool active = relativeError(x, y, aLuminanceFloor) > aThreshold;
+			aActive[static_cast<size_t>(y) * mWidth + x] = active ? 1 : 0;
+			count += active ? 1 : 0;
+		}
+	}
+	return count;
+}
+
+void AccumulationBuffer::resolve(Framebuffer &aFramebuffer) const
+{
+	for (uint32_t y = 0; y < mHeight; ++y)
+	{
+		for (uint32_t x = 0; x < mWidth; ++x)
+		{
+			aFramebuffer.set(x, y, mean(x, y));
+		}
+	}
+}
+
+void AccumulationBuffer::resolveSampleCounts(Framebuffer &aFramebuffer, float aScale) const
+{
+	for (uint32_t y = 0; y < mHeight; ++y)
+	{
+		for (uint32_t x = 0; x < mWidth; ++x)
+		{
+			aFramebuffer.set(x, y, glm::vec3(float(sampleCount(x, y)) * aScale));
+		}
+	}
+}
+
+uint64_t AccumulationBuffer::totalSamples() const
+{
+	uint64_t total = 0;
+	for (uint32_t count : mSampleCounts)
+	{
+		total += count;
+	}
+	return total;
+}
+
+void AccumulationBuffer::clear()
+{
+	std::fill(mSums.begin(), mSums.end(), glm::vec3(0.0f));
+	std::fill(mSampleCounts.begin(), mSampleCounts.end(), 0);
+	std::fill(mLuminanceMeans.begin(), mLuminanceMeans.end(), 0.0f);
+	std::fill(mLuminanceM2s.begin(), mLuminanceM2s.end(), 0.0f);
+}
+
+void AccumulationBuffer::addSamples(size_t aIndex, const glm::vec3 &aMean, uint32_t aSamples)
+{
+	mSums[aIndex] += aMean * float(aSamples);
+
+	// Welford's update, weighted by the number of samples
+	float value = luminance(aMean);
+	uint32_t count = mSampleCounts[aIndex] + aSamples;
+	float delta = value - mLuminanceMeans[aIndex];
+	mLuminanceMeans[aIndex] += delta * float(aSamples) / float(count);
+	mLuminanceM2s[aIndex] += float(aSamples) * delta * (value - mLuminanceMeans[aIndex]);
+	mSampleCounts[aIndex] = count;
+}
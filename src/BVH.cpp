@@ -0,0 +1,1154 @@
+#include "../include/BVH.h"
+#include "../include/SceneCache.h"
+#include "../include/ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+//----------------------------------------------------------------------------------
+// BVH builder
+namespace
+{
+	//! a node of the intermediate tree produced by the builder, before it is flattened into depth-first order
+	struct BVHBuildNode
+	{
+		AABB bounds;
+		uint32_t children[2];
+		uint32_t start;
+		uint32_t count;	// 0 for interior nodes
+		uint8_t axis;
+	};
+
+	//! a subtree whose construction has been handed to the thread pool
+	struct BVHBuildTask
+	{
+		uint32_t node;
+		uint32_t start;
+		uint32_t end;
+		uint32_t depth;
+	};
+
+	//! a candidate split bin of the SAH
+	struct BVHBin
+	{
+		AABB bounds = AABB::empty();
+		uint32_t count = 0;
+	};
+
+	//! ranges at least this large have their bounds and bins computed by several threads
+	const uint32_t kParallelChunkSize = 1 << 16;
+
+	//! builds the intermediate tree - every subtree below the parallel threshold becomes a task, and splitting only ever
+	//! reorders the primitive array in place
+	class BVHBuilder
+	{
+	public:
+		BVHBuilder(const BVHBuildOptions &aOptions, std::vector<BVHPrimitiveInfo> &aPrimitives, ThreadPool *aPool) :
+			mOptions(aOptions),
+			mPrimitives(aPrimitives),
+			mPool(aPool),
+			mNodes(2 * aPrimitives.size() - 1),
+			mNextNode(1)
+		{
+		}
+
+		//! builds the whole tree and returns its nodes - the root is node 0
+		const std::vector<BVHBuildNode>& build()
+		{
+			uint32_t n = static_cast<uint32_t>(mPrimitives.size());
+			if (mOptions.splitMethod == BVHSplitMethod::LBVH)
+			{
+				sortByMortonCode();
+			}
+
+			if (!mPool)
+			{
+				buildRecursive(0, 0, n, 0, nullptr);
+				return mNodes;
+			}
+
+			// split the top of the tree on this thread until the pieces are small enough to balance well across the pool,
+			// then let the pool build the pieces - the top-level passes over the primitives are themselves run in parallel
+			mTaskSize = std::max<uint32_t>(mOptions.parallelThreshold, n / static_cast<uint32_t>(8 * mPool->threadCount()));
+			std::vector<BVHBuildTask> tasks;
+			buildRecursive(0, 0, n, 0, &tasks);
+
+			mPool->dispatch(tasks.size(), [&](size_t aTaskIndex, size_t)
+			{
+				const BVHBuildTask &task = tasks[aTaskIndex];
+				buildRecursive(task.node, task.start, task.end, task.depth, nullptr);
+			});
+			return mNodes;
+		}
+	private:
+		//! fills in node aNode with the subtree over mPrimitives[aStart, aEnd) - if aTasks is given, subtrees smaller than
+		//! the task size are deferred to it instead of being built
+		void buildRecursive(uint32_t aNode, uint32_t aStart, uint32_t aEnd, uint32_t aDepth, std::vector<BVHBuildTask> *aTasks)
+		{
+			uint32_t n = aEnd - aStart;
+			if (aTasks && n < mTaskSize)
+			{
+				aTasks->push_back({ aNode, aStart, aEnd, aDepth });
+				return;
+			}
+
+			bool parallel = aTasks && n >= 2 * kParallelChunkSize;
+			AABB box;
+			AABB centroidBox;
+			computeBounds(aStart, aEnd, parallel, box, centroidBox);
+
+			uint32_t mid = aStart;
+			int axis = centroidBox.maximumExtent();
+			if (n > 1)
+			{
+				// past this depth only median splits are used, which halve the range and so keep the tree within kMaxDepth
+				if (mOptions.splitMethod == BVHSplitMethod::LBVH)
+				{
+					mid = partitionMorton(aStart, aEnd, axis);
+				}
+				else if (mOptions.splitMethod == BVHSplitMethod::SAH && aDepth < BVH::kMaxDepth - 32)
+				{
+					mid = partitionSAH(aStart, aEnd, box, centroidBox, parallel, axis);
+				}
+				else if (n > mOptions.maxLeafSize)
+				{
+					mid = partitionMedian(aStart, aEnd, centroidBox, axis);
+				}
+			}
+
+			// a leaf may only hold primitives of one type, so a mixed leaf is split by type instead
+			if (mid == aStart && !isHomogeneous(aStart, aEnd))
+			{
+				uint8_t type = mPrimitives[aStart].type;
+				auto middle = std::partition(mPrimitives.begin() + aStart, mPrimitives.begin() + aEnd, [&](const BVHPrimitiveInfo &aPrimitive)
+				{
+					return aPrimitive.type == type;
+				});
+				mid = static_cast<uint32_t>(middle - mPrimitives.begin());
+			}
+
+			BVHBuildNode &node = mNodes[aNode];
+			node.bounds = box;
+			node.axis = static_cast<uint8_t>(axis);
+			if (mid == aStart)
+			{
+				node.start = aStart;
+				node.count = n;
+				return;
+			}
+
+			uint32_t children = mNextNode.fetch_add(2);
+			node.children[0] = children;
+			node.children[1] = children + 1;
+			node.count = 0;
+
+			buildRecursive(children, aStart, mid, aDepth + 1, aTasks);
+			buildRecursive(children + 1, mid, aEnd, aDepth + 1, aTasks);
+		}
+
+		//! returns true if all primitives of a range have the same type
+		bool isHomogeneous(uint32_t aStart, uint32_t aEnd) const
+		{
+			for (uint32_t i = aStart + 1; i < aEnd; ++i)
+			{
+				if (mPrimitives[i].type != mPrimitives[aStart].type)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		//! computes the bounds of the primitives and of their centroids over a range
+		void computeBounds(uint32_t aStart, uint32_t aEnd, bool aParallel, AABB &aBounds, AABB &aCentroidBounds) const
+		{
+			auto accumulate = [&](uint32_t aFirst, uint32_t aLast, AABB &aBox, AABB &aCentroidBox)
+			{
+				aBox = AABB::empty();
+				aCentroidBox = AABB::empty();
+				for (uint32_t i = aFirst; i < aLast; ++i)
+				{
+					aBox.extend(mPrimitives[i].bounds);
+					aCentroidBox.extend(mPrimitives[i].centroid);
+				}
+			};
+
+			if (!aParallel)
+			{
+				accumulate(aStart, aEnd, aBounds, aCentroidBounds);
+				return;
+			}
+
+			uint32_t chunks = (aEnd - aStart + kParallelChunkSize - 1) / kParallelChunkSize;
+			std::vector<AABB> boxes(chunks);
+			std::vector<AABB> centroidBoxes(chunks);
+			mPool->dispatch(chunks, [&](size_t aChunk, size_t)
+			{
+				uint32_t first = aStart + static_cast<uint32_t>(aChunk) * kParallelChunkSize;
+				accumulate(first, std::min(first + kParallelChunkSize, aEnd), boxes[aChunk], centroidBoxes[aChunk]);
+			});
+
+			aBounds = AABB::empty();
+			aCentroidBounds = AABB::empty();
+			for (uint32_t i = 0; i < chunks; ++i)
+			{
+				aBounds.extend(boxes[i]);
+				aCentroidBounds.extend(centroidBoxes[i]);
+			}
+		}
+
+		//! partitions a range with the binned SAH and returns the split point (and its axis), or aStart if a leaf is cheaper
+		uint32_t partitionSAH(uint32_t aStart, uint32_t aEnd, const AABB &aBounds, const AABB &aCentroidBounds, bool aParallel, int &aAxis) const
+		{
+			const uint32_t n = aEnd - aStart;
+			const uint32_t binCount = mOptions.binCount;
+			const glm::vec3 centroidMin = aCentroidBounds.min();
+			const glm::vec3 centroidExtent = aCentroidBounds.extent();
+
+			auto binIndex = [&](const BVHPrimitiveInfo &aPrimitive, int aAxis)
+			{
+				uint32_t b = static_cast<uint32_t>(binCount * ((aPrimitive.centroid[aAxis] - centroidMin[aAxis]) / centroidExtent[aAxis]));
+				return std::min(b, binCount - 1);
+			};
+
+			// bin all three axes in a single pass over the range, one set of bins per chunk when running in parallel
+			auto binRange = [&](uint32_t aFirst, uint32_t aLast, BVHBin *aBins)
+			{
+				for (uint32_t i = aFirst; i < aLast; ++i)
+				{
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						if (centroidExtent[axis] > 0.0f)
+						{
+							BVHBin &bin = aBins[axis * binCount + binIndex(mPrimitives[i], axis)];
+							bin.bounds.extend(mPrimitives[i].bounds);
+							bin.count++;
+						}
+					}
+				}
+			};
+
+			std::vector<BVHBin> bins(3 * binCount);
+			if (aParallel)
+			{
+				uint32_t chunks = (n + kParallelChunkSize - 1) / kParallelChunkSize;
+				std::vector<BVHBin> chunkBins(chunks * 3 * binCount);
+				mPool->dispatch(chunks, [&](size_t aChunk, size_t)
+				{
+					uint32_t first = aStart + static_cast<uint32_t>(aChunk) * kParallelChunkSize;
+					binRange(first, std::min(first + kParallelChunkSize, aEnd), &chunkBins[aChunk * 3 * binCount]);
+				});
+				for (size_t i = 0; i < chunkBins.size(); ++i)
+				{
+					BVHBin &bin = bins[i % bins.size()];
+					bin.bounds.extend(chunkBins[i].bounds);
+					bin.count += chunkBins[i].count;
+				}
+			}
+			else
+			{
+				binRange(aStart, aEnd, bins.data());
+			}
+
+			// find the cheapest split plane across all axes
+			float bestCost = std::numeric_limits<float>::infinity();
+			int bestAxis = -1;
+			uint32_t bestBin = 0;
+
+			std::vector<float> rightArea(binCount);
+			std::vector<uint32_t> rightCount(binCount);
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				if (centroidExtent[axis] <= 0.0f)
+				{
+					continue;
+				}
+				const BVHBin *axisBins = &bins[axis * binCount];
+
+				// sweep from the right to get the area and count above every plane, then from the left to evaluate each plane
+				AABB accumulated = AABB::empty();
+				uint32_t count = 0;
+				for (uint32_t b = binCount - 1; b > 0; --b)
+				{
+					accumulated.extend(axisBins[b].bounds);
+					count += axisBins[b].count;
+					rightArea[b] = accumulated.surfaceArea();
+					rightCount[b] = count;
+				}
+
+				accumulated = AABB::empty();
+				count = 0;
+				for (uint32_t b = 0; b < binCount - 1; ++b)
+				{
+					accumulated.extend(axisBins[b].bounds);
+					count += axisBins[b].count;
+
+					float cost = count * accumulated.surfaceArea() + rightCount[b + 1] * rightArea[b + 1];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = b;
+					}
+				}
+			}
+
+			// all centroids coincide: there is no plane to split at, so only an arbitrary halving can shrink the leaf
+			if (bestAxis < 0)
+			{
+				return n > mOptions.maxLeafSize ? aStart + n / 2 : aStart;
+			}
+
+			float parentArea = aBounds.surfaceArea();
+			float splitCost = mOptions.traversalCost + mOptions.intersectionCost * (parentArea > 0.0f ? bestCost / parentArea : n);
+			float leafCost = mOptions.intersectionCost * n;
+			if (n <= mOptions.maxLeafSize && leafCost <= splitCost)
+			{
+				return aStart;
+			}
+
+			auto middle = std::partition(mPrimitives.begin() + aStart, mPrimitives.begin() + aEnd, [&](const BVHPrimitiveInfo &aPrimitive)
+			{
+				return binIndex(aPrimitive, bestAxis) <= bestBin;
+			});
+			uint32_t mid = static_cast<uint32_t>(middle - mPrimitives.begin());
+
+			// float rounding can, very rarely, leave one side empty
+			if (mid == aStart || mid == aEnd)
+			{
+				return partitionMedian(aStart, aEnd, aCentroidBounds, aAxis);
+			}
+			aAxis = bestAxis;
+			return mid;
+		}
+
+		//! partitions a range at the median centroid along the longest axis and returns the split point (and its axis)
+		uint32_t partitionMedian(uint32_t aStart, uint32_t aEnd, const AABB &aCentroidBounds, int &aAxis) const
+		{
+			int axis = aAxis = aCentroidBounds.maximumExtent();
+			uint32_t mid = aStart + (aEnd - aStart) / 2;
+			std::nth_element(mPrimitives.begin() + aStart, mPrimitives.begin() + mid, mPrimitives.begin() + aEnd, [&](const BVHPrimitiveInfo &lhs, const BVHPrimitiveInfo &rhs)
+			{
+				return lhs.centroid[axis] < rhs.centroid[axis];
+			});
+			return mid;
+		}
+
+		//! splits a range of Morton-sorted primitives where the highest bit that differs across the range flips
+		uint32_t partitionMorton(uint32_t aStart, uint32_t aEnd, int &aAxis) const
+		{
+			uint32_t n = aEnd - aStart;
+			if (n <= mOptions.maxLeafSize)
+			{
+				return aStart;
+			}
+
+			uint32_t first = mMortonCodes[aStart];
+			uint32_t last = mMortonCodes[aEnd - 1];
+			if (first == last)
+			{
+				return aStart + n / 2;
+			}
+
+			int bit = 31;
+			while (((first ^ last) >> bit) == 0)
+			{
+				--bit;
+			}
+
+			// x, y and z are interleaved from the most significant bit down
+			aAxis = 2 - bit % 3;
+
+			// the codes are sorted, so the ones with the bit set form the upper part of the range
+			uint32_t mask = 1u << bit;
+			auto middle = std::partition_point(mMortonCodes.begin() + aStart, mMortonCodes.begin() + aEnd, [&](uint32_t aCode)
+			{
+				return (aCode & mask) == 0;
+			});
+			return static_cast<uint32_t>(middle - mMortonCodes.begin());
+		}
+
+		//! computes a Morton code for every centroid and sorts the primitives by it with a radix sort
+		void sortByMortonCode()
+		{
+			uint32_t n = static_cast<uint32_t>(mPrimitives.size());
+			AABB box;
+			AABB centroidBox;
+			computeBounds(0, n, mPool != nullptr && n >= 2 * kParallelChunkSize, box, centroidBox);
+
+			glm::vec3 extent = centroidBox.extent();
+			glm::vec3 scale{ extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+							 extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+							 extent.z > 0.0f ? 1.0f / extent.z : 0.0f };
+
+			std::vector<uint64_t> keys(n);
+			auto encode = [&](uint32_t aFirst, uint32_t aLast)
+			{
+				for (uint32_t i = aFirst; i < aLast; ++i)
+				{
+					uint64_t code = mortonCode((mPrimitives[i].centroid - centroidBox.min()) * scale);
+					keys[i] = (code << 32) | i;
+				}
+			};
+
+			if (mPool && n >= 2 * kParallelChunkSize)
+			{
+				uint32_t chunks = (n + kParallelChunkSize - 1) / kParallelChunkSize;
+				mPool->dispatch(chunks, [&](size_t aChunk, size_t)
+				{
+					uint32_t first = static_cast<uint32_t>(aChunk) * kParallelChunkSize;
+					encode(first, std::min(first + kParallelChunkSize, n));
+				});
+			}
+			else
+			{
+				encode(0, n);
+			}
+
+			// least significant digit radix sort on the 30 code bits, 8 bits per pass
+			std::vector<uint64_t> scratch(n);
+			for (uint32_t shift = 32; shift < 64; shift += 8)
+			{
+				uint32_t offsets[257] = {};
+				for (uint64_t key : keys)
+				{
+					offsets[((key >> shift) & 0xFF) + 1]++;
+				}
+				for (uint32_t i = 1; i < 257; ++i)
+				{
+					offsets[i] += offsets[i - 1];
+				}
+				for (uint64_t key : keys)
+				{
+					scratch[offsets[(key >> shift) & 0xFF]++] = key;
+				}
+				keys.swap(scratch);
+			}
+
+			std::vector<BVHPrimitiveInfo> sorted(n);
+			mMortonCodes.resize(n);
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				sorted[i] = mPrimitives[static_cast<uint32_t>(keys[i])];
+				mMortonCodes[i] = static_cast<uint32_t>(keys[i] >> 32);
+			}
+			mPrimitives.swap(sorted);
+		}
+
+		const BVHBuildOptions &mOptions;
+		std::vector<BVHPrimitiveInfo> &mPrimitives;
+		ThreadPool *mPool;
+		std::vector<BVHBuildNode> mNodes;
+		std::atomic<uint32_t> mNextNode;
+		std::vector<uint32_t> mMortonCodes;
+		uint32_t mTaskSize = 0;
+	};
+
+	//! writes the subtree rooted at aNode into aNodes in depth-first order and returns the index of its root - leaves are
+	//! visited in the order of the primitive array, so aTypeOffsets counts how many primitives of each type precede a leaf
+	uint32_t flatten(const std::vector<BVHBuildNode> &aBuildNodes, const std::vector<BVHPrimitiveInfo> &aPrimitives, uint32_t aNode, uint32_t aDepth, std::vector<uint32_t> &aTypeOffsets, std::vector<BVHLinearNode> &aNodes, BVHBuildStats &aStats)
+	{
+		const BVHBuildNode &buildNode = aBuildNodes[aNode];
+		uint32_t linearIndex = static_cast<uint32_t>(aNodes.size());
+		aNodes.emplace_back();
+		aNodes[linearIndex].bounds = buildNode.bounds;
+		aNodes[linearIndex].axis = buildNode.axis;
+		aStats.maxDepth = std::max(aStats.maxDepth, aDepth);
+
+		if (buildNode.count > 0)
+		{
+			uint8_t type = aPrimitives[buildNode.start].type;
+			aNodes[linearIndex].primitivesOffset = aTypeOffsets[type];
+			aNodes[linearIndex].primitiveCount = static_cast<uint16_t>(buildNode.count);
+			aNodes[linearIndex].primitiveType = type;
+			aTypeOffsets[type] += buildNode.count;
+			aStats.leafCount++;
+			return linearIndex;
+		}
+
+		flatten(aBuildNodes, aPrimitives, buildNode.children[0], aDepth + 1, aTypeOffsets, aNodes, aStats);
+		aNodes[linearIndex].secondChildOffset = flatten(aBuildNodes, aPrimitives, buildNode.children[1], aDepth + 1, aTypeOffsets, aNodes, aStats);
+		aNodes[linearIndex].primitiveCount = 0;
+		aNodes[linearIndex].primitiveType = 0;
+		return linearIndex;
+	}
+
+	//! computes the bounds of every node at both ends of the shutter interval from the boxes of its primitives, and widens
+	//! the node's own bounds to enclose both - children are stored after their parents, so walking the nodes backwards
+	//! visits every child before its parent
+	void computeMotionBounds(const std::vector<BVHPrimitiveInfo> &aPrimitives, const std::vector<AABB> &aStartBounds, const std::vector<AABB> &aEndBounds, std::vector<BVHLinearNode> &aNodes, std::vector<BVHMotionBounds> &aMotion)
+	{
+		// leaves are stored in the order of the primitive array, so counting the primitives of the leaves before a node
+		// gives the slot of its first primitive
+		std::vector<uint32_t> firstSlots(aNodes.size());
+		uint32_t slot = 0;
+		for (size_t i = 0; i < aNodes.size(); ++i)
+		{
+			firstSlots[i] = slot;
+			slot += aNodes[i].primitiveCount;
+		}
+
+		aMotion.resize(aNodes.size());
+		for (size_t i = aNodes.size(); i-- > 0;)
+		{
+			BVHLinearNode &node = aNodes[i];
+			BVHMotionBounds &motion = aMotion[i];
+			motion.start = AABB::empty();
+			motion.end = AABB::empty();
+			if (node.primitiveCount > 0)
+			{
+				for (uint32_t j = firstSlots[i]; j < firstSlots[i] + node.primitiveCount; ++j)
+				{
+					motion.start.extend(aStartBounds[aPrimitives[j].index]);
+					motion.end.extend(aEndBounds[aPrimitives[j].index]);
+				}
+			}
+			else
+			{
+				const BVHMotionBounds &first = aMotion[i + 1];
+				const BVHMotionBounds &second = aMotion[node.secondChildOffset];
+				motion.start = enclosingBox(first.start, second.start);
+				motion.end = enclosingBox(first.end, second.end);
+			}
+			node.bounds = enclosingBox(motion.start, motion.end);
+		}
+	}
+
+	//! stores a box in slot aSlot of the bounds of a wide node
+	template<int N>
+	void setChildBounds(float (&aBounds)[2][3][N], int aSlot, const AABB &aBox)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			aBounds[0][axis][aSlot] = aBox.min()[axis];
+			aBounds[1][axis][aSlot] = aBox.max()[axis];
+		}
+	}
+
+	//! stores a child's bounds in slot aSlot of a wide node
+	template<int N>
+	void setChildBounds(BVHWideNode<N> &aNode, int aSlot, const BVHMotionBounds &aBounds)
+	{
+		setChildBounds(aNode.bounds, aSlot, aBounds.start);
+	}
+
+	//! stores a child's bounds at both ends of the shutter interval in slot aSlot of a moving wide node
+	template<int N>
+	void setChildBounds(BVHWideMotionNode<N> &aNode, int aSlot, const BVHMotionBounds &aBounds)
+	{
+		setChildBounds(aNode.bounds, aSlot, aBounds.start);
+		setChildBounds(aNode.endBounds, aSlot, aBounds.end);
+	}
+
+	//! returns the bounds a wide node stores for a binary node - its bounds at both ends of the shutter interval if the
+	//! hierarchy moves, its bounds over the whole interval otherwise
+	BVHMotionBounds childBounds(const std::vector<BVHLinearNode> &aNodes, const BVHMotionBounds *aMotion, uint32_t aNode)
+	{
+		return aMotion ? aMotion[aNode] : BVHMotionBounds{ aNodes[aNode].bounds, aNodes[aNode].bounds };
+	}
+
+	//! collapses the binary subtree rooted at interior node aNode into N-wide nodes - BVHWideNode, or BVHWideMotionNode
+	//! with the binary nodes' motion bounds - and returns the index of the first one. if aSources is given, it receives
+	//! the binary node of every child, N per wide node
+	template<int N, template<int> class Node>
+	uint32_t collapse(const std::vector<BVHLinearNode> &aNodes, const BVHMotionBounds *aMotion, uint32_t aNode, std::vector<Node<N>> &aWideNodes, std::vector<uint32_t> *aSources)
+	{
+		uint32_t wideIndex = static_cast<uint32_t>(aWideNodes.size());
+		aWideNodes.emplace_back();
+		if (aSources)
+		{
+			aSources->resize(aWideNodes.size() * N, 0);
+		}
+
+		// open up the binary subtree, always expanding the interior child with the largest surface area, until the
+		// wide node is full or only leaves remain
+		uint32_t children[N] = { aNode + 1, aNodes[aNode].secondChildOffset };
+		int childCount = 2;
+		while (childCount < N)
+		{
+			int largest = -1;
+			float largestArea = -1.0f;
+			for (int i = 0; i < childCount; ++i)
+			{
+				const BVHLinearNode &child = aNodes[children[i]];
+				if (child.primitiveCount == 0 && child.bounds.surfaceArea() > largestArea)
+				{
+					largest = i;
+					largestArea = child.bounds.surfaceArea();
+				}
+			}
+			if (largest < 0)
+			{
+				break;
+			}
+
+			uint32_t expanded = children[largest];
+			children[largest] = expanded + 1;
+			children[childCount++] = aNodes[expanded].secondChildOffset;
+		}
+
+		for (int i = 0; i < N; ++i)
+		{
+			uint32_t target = 0;
+			uint16_t count = 0;
+			uint8_t type = 0;
+			BVHMotionBounds bounds{ AABB::empty(), AABB::empty() };
+			if (i < childCount)
+			{
+				const BVHLinearNode &child = aNodes[children[i]];
+				bounds = childBounds(aNodes, aMotion, children[i]);
+				count = child.primitiveCount;
+				type = child.primitiveType;
+				target = count > 0 ? child.primitivesOffset : collapse(aNodes, aMotion, children[i], aWideNodes, aSources);
+				if (aSources)
+				{
+					(*aSources)[wideIndex * N + i] = children[i];
+				}
+			}
+
+			// collapsing children may have reallocated the array, so look the node up again
+			Node<N> &wide = aWideNodes[wideIndex];
+			setChildBounds(wide, i, bounds);
+			wide.children[i] = target;
+			wide.counts[i] = count;
+			wide.types[i] = type;
+		}
+		aWideNodes[wideIndex].childCount = static_cast<uint32_t>(childCount);
+		return wideIndex;
+	}
+
+	//! collapses a whole binary BVH into N-wide nodes - a root leaf becomes a wide node with a single child
+	template<int N, template<int> class Node>
+	void collapse(const std::vector<BVHLinearNode> &aNodes, const BVHMotionBounds *aMotion, std::vector<Node<N>> &aWideNodes, std::vector<uint32_t> *aSources)
+	{
+		aWideNodes.clear();
+		aWideNodes.reserve(aNodes.size() / 2 + 1);
+		if (aSources)
+		{
+			aSources->clear();
+		}
+		if (aNodes.front().primitiveCount == 0)
+		{
+			collapse(aNodes, aMotion, 0, aWideNodes, aSources);
+		}
+		else
+		{
+			aWideNodes.emplace_back();
+			if (aSources)
+			{
+				aSources->assign(N, 0);
+			}
+			Node<N> &root = aWideNodes.front();
+			const BVHMotionBounds empty{ AABB::empty(), AABB::empty() };
+			for (int i = 0; i < N; ++i)
+			{
+				setChildBounds(root, i, i == 0 ? childBounds(aNodes, aMotion, 0) : empty);
+				root.children[i] = i == 0 ? aNodes.front().primitivesOffset : 0;
+				root.counts[i] = i == 0 ? aNodes.front().primitiveCount : 0;
+				root.types[i] = i == 0 ? aNodes.front().primitiveType : 0;
+			}
+			root.childCount = 1;
+		}
+		aWideNodes.shrink_to_fit();
+	}
+
+	//! collapses a whole binary BVH into the kind of wide nodes its traversal reads - motion nodes if it has motion bounds
+	template<int N>
+	void collapseInto(const std::vector<BVHLinearNode> &aNodes, const std::vector<BVHMotionBounds> &aMotion, Buffer<BVHWideNode<N>> &aWideNodes, Buffer<BVHWideMotionNode<N>> &aWideMotionNodes, std::vector<uint32_t> *aSources = nullptr)
+	{
+		if (aMotion.empty())
+		{
+			std::vector<BVHWideNode<N>> wideNodes;
+			collapse(aNodes, nullptr, wideNodes, aSources);
+			aWideNodes = std::move(wideNodes);
+		}
+		else
+		{
+			std::vector<BVHWideMotionNode<N>> wideNodes;
+			collapse(aNodes, aMotion.data(), wideNodes, aSources);
+			aWideMotionNodes = std::move(wideNodes);
+		}
+	}
+
+	//! returns the SAH cost of a node, before it is divided by the surface area of the root
+	float nodeCost(const BVHLinearNode &aNode, const BVHBuildOptions &aOptions)
+	{
+		float cost = aNode.primitiveCount > 0 ? aOptions.intersectionCost * aNode.primitiveCount : aOptions.traversalCost;
+		return cost * aNode.bounds.surfaceArea();
+	}
+
+	//! returns the SAH cost of a whole tree from the summed costs of all its nodes
+	float treeCost(const std::vector<BVHLinearNode> &aNodes, double aNodeCosts)
+	{
+		float rootArea = aNodes.front().bounds.surfaceArea();
+		return rootArea > 0.0f ? static_cast<float>(aNodeCosts / rootArea) : 0.0f;
+	}
+
+	//! recomputes the bounds of node aNode - from the primitives in leaf slots [aFirstSlot, ...) for a leaf, from its children
+	//! for an interior node - and, if the hierarchy moves, its bounds at both ends of the shutter interval. returns false
+	//! if a primitive of a leaf no longer has the leaf's type
+	bool refitNode(BVHLinearNode *aNodes, BVHMotionBounds *aMotion, uint32_t aNode, uint32_t aFirstSlot, const uint32_t *aPrimitiveIndices, const std::vector<AABB> &aStartBounds, const std::vector<AABB> &aEndBounds, const std::vector<uint8_t> &aTypes)
+	{
+		BVHLinearNode &node = aNodes[aNode];
+		bool typesMatch = true;
+		if (node.primitiveCount > 0)
+		{
+			AABB start = AABB::empty();
+			AABB end = AABB::empty();
+			for (uint32_t j = aFirstSlot; j < aFirstSlot + node.primitiveCount; ++j)
+			{
+				uint32_t index = aPrimitiveIndices[j];
+				typesMatch &= (aTypes.empty() ? 0 : aTypes[index]) == node.primitiveType;
+				start.extend(aStartBounds[index]);
+				if (aMotion)
+				{
+					end.extend(aEndBounds[index]);
+				}
+			}
+			node.bounds = start;
+			if (aMotion)
+			{
+				aMotion[aNode] = { start, end };
+				node.bounds = enclosingBox(start, end);
+			}
+		}
+		else
+		{
+			node.bounds = enclosingBox(aNodes[aNode + 1].bounds, aNodes[node.secondChildOffset].bounds);
+			if (aMotion)
+			{
+				const BVHMotionBounds &first = aMotion[aNode + 1];
+				const BVHMotionBounds &second = aMotion[node.secondChildOffset];
+				aMotion[aNode] = { enclosingBox(first.start, second.start), enclosingBox(first.end, second.end) };
+			}
+		}
+		return typesMatch;
+	}
+
+	//! splits the subtree of node aNode, which ends before node aEnd, into subtrees of at most aTaskSize nodes and collects
+	//! the interior nodes above them in depth-first order
+	template<typename Task>
+	void splitSubtree(const BVHLinearNode *aNodes, uint32_t aNode, uint32_t aEnd, uint32_t aTaskSize, std::vector<Task> &aTasks, std::vector<uint32_t> &aTopNodes)
+	{
+		if (aEnd - aNode <= aTaskSize || aNodes[aNode].primitiveCount > 0)
+		{
+			aTasks.push_back({ aNode, aEnd, 0, 0 });
+			return;
+		}
+		aTopNodes.push_back(aNode);
+		splitSubtree(aNodes, aNode + 1, aNodes[aNode].secondChildOffset, aTaskSize, aTasks, aTopNodes);
+		splitSubtree(aNodes, aNodes[aNode].secondChildOffset, aEnd, aTaskSize, aTasks, aTopNodes);
+	}
+
+	//! copies the refit bounds of the binary nodes into the children of the wide nodes they were collapsed into, a chunk of
+	//! wide nodes per task - every wide node only reads binary nodes, so they can be updated in any order
+	template<int N, template<int> class Node>
+	void refitWide(Buffer<Node<N>> &aWideNodes, const std::vector<uint32_t> &aSources, const std::vector<BVHLinearNode> &aNodes, const BVHMotionBounds *aMotion, ThreadPool *aPool)
+	{
+		const uint32_t kChunkSize = 1024;
+		std::vector<Node<N>> &wideNodes = aWideNodes.storage();
+		auto refitChunk = [&](size_t aChunk, size_t)
+		{
+			size_t last = std::min((aChunk + 1) * kChunkSize, wideNodes.size());
+			for (size_t i = aChunk * kChunkSize; i < last; ++i)
+			{
+				for (uint32_t j = 0; j < wideNodes[i].childCount; ++j)
+				{
+					setChildBounds(wideNodes[i], j, childBounds(aNodes, aMotion, aSources[i * N + j]));
+				}
+			}
+		};
+
+		size_t chunks = (wideNodes.size() + kChunkSize - 1) / kChunkSize;
+		if (aPool)
+		{
+			aPool->dispatch(chunks, refitChunk);
+		}
+		else
+		{
+			for (size_t i = 0; i < chunks; ++i)
+			{
+				refitChunk(i, 0);
+			}
+		}
+		aWideNodes.update();
+	}
+}
+
+//----------------------------------------------------------------------------------
+// BVH
+void BVH::build(const std::vector<AABB> &aBounds, const BVHBuildOptions &aOptions, const std::vector<uint8_t> &aTypes)
+{
+	build(aBounds, std::vector<AABB>(), 0.0f, 0.0f, aOptions, aTypes);
+}
+
+void BVH::build(const std::vector<AABB> &aStartBounds, const std::vector<AABB> &aEndBounds, float aTime0, float aTime1, const BVHBuildOptions &aOptions, const std::vector<uint8_t> &aTypes)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	mOptions = aOptions;
+	mOptions.binCount = std::max<uint32_t>(2, mOptions.binCount);
+	mOptions.maxLeafSize = std::min<uint32_t>(std::max<uint32_t>(1, mOptions.maxLeafSize), std::numeric_limits<uint16_t>::max());
+	mOptions.width = mOptions.width >= 8 ? 8 : (mOptions.width >= 4 ? 4 : 2);
+
+	mNodes.clear();
+	mWideNodes4.clear();
+	mWideNodes8.clear();
+	mPrimitiveIndices.clear();
+	mMotionBounds.clear();
+	mWideMotionNodes4.clear();
+	mWideMotionNodes8.clear();
+	mRefitTasks.clear();
+	mRefitTopNodes.clear();
+	mWideSources.clear();
+	mSAHCost = 0.0f;
+	mShutter = glm::vec2(aTime0, aTime1);
+	mCached = false;
+	mBuildStats = BVHBuildStats();
+	mBuildStats.primitiveCount = static_cast<uint32_t>(aStartBounds.size());
+	if (aStartBounds.empty())
+	{
+		return;
+	}
+
+	// compute the bounds and centroid of every primitive once - the builder never calls back into the primitives - where
+	// a moving primitive is represented by its box halfway through the interval, the average of the boxes rays will see
+	const bool moving = !aEndBounds.empty();
+	std::vector<BVHPrimitiveInfo> primitives(aStartBounds.size());
+	for (uint32_t i = 0; i < aStartBounds.size(); ++i)
+	{
+		AABB box = moving ? BVHMotionBounds{ aStartBounds[i], aEndBounds[i] }.at(0.5f) : aStartBounds[i];
+		primitives[i] = { box, box.centroid(), i, aTypes.empty() ? uint8_t(0) : aTypes[i] };
+	}
+
+	ThreadPool *pool = threadPool(aStartBounds.size());
+	if (pool)
+	{
+		mBuildStats.threadCount = static_cast<uint32_t>(pool->threadCount());
+	}
+
+	BVHBuilder builder{ mOptions, primitives, pool };
+	const std::vector<BVHBuildNode> &buildNodes = builder.build();
+
+	// a binary tree has at most 2n - 1 nodes
+	std::vector<BVHLinearNode> nodes;
+	nodes.reserve(2 * aStartBounds.size() - 1);
+	std::vector<uint32_t> typeOffsets(std::numeric_limits<uint8_t>::max() + 1, 0);
+	flatten(buildNodes, primitives, 0, 0, typeOffsets, nodes, mBuildStats);
+	nodes.shrink_to_fit();
+
+	std::vector<BVHMotionBounds> motion;
+	if (moving)
+	{
+		computeMotionBounds(primitives, aStartBounds, aEndBounds, nodes, motion);
+	}
+
+	// the cost is kept to tell how far later refits have let the tree degrade
+	double nodeCosts = 0.0;
+	for (const BVHLinearNode &node : nodes)
+	{
+		nodeCosts += nodeCost(node, mOptions);
+	}
+	mBuildStats.sahCost = mSAHCost = treeCost(nodes, nodeCosts);
+
+	std::vector<uint32_t> primitiveIndices(primitives.size());
+	for (size_t i = 0; i < primitives.size(); ++i)
+	{
+		primitiveIndices[i] = primitives[i].index;
+	}
+	mPrimitiveIndices = std::move(primitiveIndices);
+
+	// the binary nodes are kept as well, since they are cheap and other passes work on them
+	if (mOptions.width == 4)
+	{
+		collapseInto(nodes, motion, mWideNodes4, mWideMotionNodes4);
+	}
+	else if (mOptions.width == 8)
+	{
+		collapseInto(nodes, motion, mWideNodes8, mWideMotionNodes8);
+	}
+	mNodes = std::move(nodes);
+	mMotionBounds = std::move(motion);
+
+	mBuildStats.nodeCount = static_cast<uint32_t>(mNodes.size());
+	mBuildStats.width = mOptions.width;
+	mBuildStats.wideNodeCount = static_cast<uint32_t>(mOptions.width == 4 ? std::max(mWideNodes4.size(), mWideMotionNodes4.size()) : std::max(mWideNodes8.size(), mWideMotionNodes8.size()));
+	mBuildStats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool BVH::refit(const std::vector<AABB> &aBounds, const std::vector<uint8_t> &aTypes)
+{
+	return refit(aBounds, std::vector<AABB>(), 0.0f, 0.0f, aTypes);
+}
+
+bool BVH::refit(const std::vector<AABB> &aStartBounds, const std::vector<AABB> &aEndBounds, float aTime0, float aTime1, const std::vector<uint8_t> &aTypes)
+{
+	// a tree over other primitives, or over primitives that started or stopped moving or changed their types, has to be
+	// built anew
+	const bool moving = !aEndBounds.empty();
+	const BVHBuildOptions options = mOptions;
+	if (mNodes.empty() || aStartBounds.size() != mBuildStats.primitiveCount || moving != isMoving() || (moving && mShutter != glm::vec2(aTime0, aTime1)))
+	{
+		build(aStartBounds, aEndBounds, aTime0, aTime1, options, aTypes);
+		return false;
+	}
+
+	ThreadPool *pool = threadPool(aStartBounds.size());
+	if (mRefitTasks.empty())
+	{
+		uint32_t nodeCount = static_cast<uint32_t>(mNodes.size());
+		prepareRefit(pool ? std::max<uint32_t>(mOptions.parallelThreshold, nodeCount / static_cast<uint32_t>(8 * pool->threadCount())) : nodeCount);
+	}
+
+	// every task walks its subtree backwards, which visits children before their parents and leaves in reverse slot order
+	std::vector<BVHLinearNode> &nodes = mNodes.storage();
+	BVHMotionBounds *motion = moving ? mMotionBounds.storage().data() : nullptr;
+	std::vector<double> taskCosts(mRefitTasks.size());
+	std::vector<uint8_t> taskTypesMatch(mRefitTasks.size());
+	auto refitTask = [&](size_t aTaskIndex, size_t)
+	{
+		const RefitTask &task = mRefitTasks[aTaskIndex];
+		uint32_t slot = task.endSlot;
+		double cost = 0.0;
+		bool typesMatch = true;
+		for (uint32_t i = task.end; i-- > task.node;)
+		{
+			slot -= nodes[i].primitiveCount;
+			typesMatch &= refitNode(nodes.data(), motion, i, slot, mPrimitiveIndices.data(), aStartBounds, aEndBounds, aTypes);
+			cost += nodeCost(nodes[i], mOptions);
+		}
+		taskCosts[aTaskIndex] = cost;
+		taskTypesMatch[aTaskIndex] = typesMatch;
+	};
+	if (pool)
+	{
+		pool->dispatch(mRefitTasks.size(), refitTask);
+	}
+	else
+	{
+		for (size_t i = 0; i < mRefitTasks.size(); ++i)
+		{
+			refitTask(i, 0);
+		}
+	}
+
+	// the few nodes above the tasks are interior, and refit once both their children are
+	double nodeCosts = 0.0;
+	for (size_t i = mRefitTopNodes.size(); i-- > 0;)
+	{
+		refitNode(nodes.data(), motion, mRefitTopNodes[i], 0, mPrimitiveIndices.data(), aStartBounds, aEndBounds, aTypes);
+		nodeCosts += nodeCost(nodes[mRefitTopNodes[i]], mOptions);
+	}
+	for (double cost : taskCosts)
+	{
+		nodeCosts += cost;
+	}
+	mNodes.update();
+	if (moving)
+	{
+		mMotionBounds.update();
+	}
+
+	mSAHCost = treeCost(nodes, nodeCosts);
+	bool typesMatch = std::all_of(taskTypesMatch.begin(), taskTypesMatch.end(), [](uint8_t aMatch) { return aMatch != 0; });
+	if (!typesMatch || mSAHCost > mOptions.refitCostLimit * mBuildStats.sahCost)
+	{
+		build(aStartBounds, aEndBounds, aTime0, aTime1, options, aTypes);
+		return false;
+	}
+
+	if (mOptions.width == 4 && moving)
+	{
+		refitWide(mWideMotionNodes4, mWideSources, nodes, motion, pool);
+	}
+	else if (mOptions.width == 4)
+	{
+		refitWide(mWideNodes4, mWideSources, nodes, motion, pool);
+	}
+	else if (mOptions.width == 8 && moving)
+	{
+		refitWide(mWideMotionNodes8, mWideSources, nodes, motion, pool);
+	}
+	else if (mOptions.width == 8)
+	{
+		refitWide(mWideNodes8, mWideSources, nodes, motion, pool);
+	}
+	return true;
+}
+
+void BVH::prepareRefit(uint32_t aTaskSize)
+{
+	splitSubtree(mNodes.data(), 0, static_cast<uint32_t>(mNodes.size()), aTaskSize, mRefitTasks, mRefitTopNodes);
+
+	// the leaves of the tasks follow each other in slot order
+	uint32_t slot = 0;
+	for (RefitTask &task : mRefitTasks)
+	{
+		task.firstSlot = slot;
+		for (uint32_t i = task.node; i < task.end; ++i)
+		{
+			slot += mNodes[i].primitiveCount;
+		}
+		task.endSlot = slot;
+	}
+
+	// collapsing the binary nodes again, before their bounds change, gives the same wide nodes and which binary node each
+	// child came from
+	if (mOptions.width == 4)
+	{
+		collapseInto(mNodes.storage(), mMotionBounds.storage(), mWideNodes4, mWideMotionNodes4, &mWideSources);
+	}
+	else if (mOptions.width == 8)
+	{
+		collapseInto(mNodes.storage(), mMotionBounds.storage(), mWideNodes8, mWideMotionNodes8, &mWideSources);
+	}
+	mNodes.update();
+	mMotionBounds.update();
+}
+
+ThreadPool* BVH::threadPool(size_t aPrimitiveCount)
+{
+	// small inputs are not worth waking up any threads for
+	if (mOptions.threadCount == 1 || aPrimitiveCount < mOptions.parallelThreshold)
+	{
+		return nullptr;
+	}
+	return ThreadPool::shared(mOptions.threadCount).get();
+}
+
+void BVH::printStats(std::ostream &aStream) const
+{
+	static const char *methods[] = { "median", "SAH", "LBVH" };
+	aStream << (mCached ? "cached " : "built ") << methods[static_cast<int>(mOptions.splitMethod)] << " BVH over " << mBuildStats.primitiveCount
+			<< " primitives" << (mCached ? ", originally built in " : " in ") << mBuildStats.milliseconds << " ms on " << mBuildStats.threadCount << " threads: "
+			<< mBuildStats.nodeCount << " nodes, " << mBuildStats.leafCount << " leaves, depth " << mBuildStats.maxDepth << ", SAH cost " << mBuildStats.sahCost;
+	if (mBuildStats.width > 2)
+	{
+		aStream << ", collapsed to " << mBuildStats.wideNodeCount << " " << mBuildStats.width << "-wide nodes";
+	}
+	if (isMoving())
+	{
+		aStream << ", with bounds at times " << mShutter.x << " and " << mShutter.y;
+	}
+	aStream << std::endl;
+}
+
+void BVH::writeCache(SceneCacheWriter &aWriter) const
+{
+	aWriter.add(SceneCacheSection::BVHOptions, &mOptions, 1);
+	aWriter.add(SceneCacheSection::BVHStats, &mBuildStats, 1);
+	aWriter.add(SceneCacheSection::BVHNodes, mNodes);
+	aWriter.add(SceneCacheSection::BVHWideNodes4, mWideNodes4);
+	aWriter.add(SceneCacheSection::BVHWideNodes8, mWideNodes8);
+	aWriter.add(SceneCacheSection::BVHPrimitiveIndices, mPrimitiveIndices);
+	aWriter.add(SceneCacheSection::BVHShutter, &mShutter, 1);
+	aWriter.add(SceneCacheSection::BVHMotionBounds, mMotionBounds);
+	aWriter.add(SceneCacheSection::BVHWideMotionNodes4, mWideMotionNodes4);
+	aWriter.add(SceneCacheSection::BVHWideMotionNodes8, mWideMotionNodes8);
+}
+
+bool BVH::readCache(const SceneCacheReader &aReader)
+{
+	Buffer<BVHBuildOptions> options;
+	Buffer<BVHBuildStats> stats;
+	Buffer<glm::vec2> shutter;
+	BVH bvh;
+	bool valid = aReader.read(SceneCacheSection::BVHOptions, options) && options.size() == 1
+		&& aReader.read(SceneCacheSection::BVHStats, stats) && stats.size() == 1
+		&& aReader.read(SceneCacheSection::BVHNodes, bvh.mNodes)
+		&& aReader.read(SceneCacheSection::BVHWideNodes4, bvh.mWideNodes4)
+		&& aReader.read(SceneCacheSection::BVHWideNodes8, bvh.mWideNodes8)
+		&& aReader.read(SceneCacheSection::BVHPrimitiveIndices, bvh.mPrimitiveIndices)
+		&& aReader.read(SceneCacheSection::BVHShutter, shutter) && shutter.size() == 1
+		&& aReader.read(SceneCacheSection::BVHMotionBounds, bvh.mMotionBounds)
+		&& aReader.read(SceneCacheSection::BVHWideMotionNodes4, bvh.mWideMotionNodes4)
+		&& aReader.read(SceneCacheSection::BVHWideMotionNodes8, bvh.mWideMotionNodes8);
+	if (!valid)
+	{
+		return false;
+	}
+
+	// an empty hierarchy has no nodes at all, a built one the wide nodes its width traverses - and if it moves, motion
+	// bounds for every binary node and wide motion nodes instead
+	bvh.mOptions = options[0];
+	bvh.mBuildStats = stats[0];
+	bvh.mShutter = shutter[0];
+	bvh.mSAHCost = bvh.mBuildStats.sahCost;
+	bvh.mCached = true;
+	bool moving = bvh.isMoving();
+	size_t wideNodes = 1;
+	if (bvh.mOptions.width == 4)
+	{
+		wideNodes = moving ? bvh.mWideMotionNodes4.size() : bvh.mWideNodes4.size();
+	}
+	else if (bvh.mOptions.width == 8)
+	{
+		wideNodes = moving ? bvh.mWideMotionNodes8.size() : bvh.mWideNodes8.size();
+	}
+	if (!bvh.mNodes.empty() && (wideNodes == 0 || (moving && bvh.mMotionBounds.size() != bvh.mNodes.size())))
+	{
+		return false;
+	}
+	*this = std::move(bvh);
+	return true;
+}
+
+//----------------------------------------------------------------------------------
+// BVH node
+BVHNode::BVHNode(const HitableListRef &aList, float aTime0, float aTime1, const BVHBuildOptions &aOptions)
+{
+	const auto &list = aList->list();
+
+	// gather the bounding boxes once, up front
+	std::vector<AABB> bounds(list.size());
+	for (size_t i = 0; i < list.size(); ++i)
+	{
+		if (!list[i]->boundingBox(aTime0, aTime1, bounds[i]))
+		{
+			std::cerr << "No bounding box in BVH node constructor." << std::endl;
+		}
+	}
+
+	mBVH.build(bounds, aOptions);
+
+	// store the primitives in leaf order so that every leaf refers to a contiguous range
+	mPrimitives.reserve(list.size());
+	for (uint32_t index : mBVH.primitiveIndices())
+	{
+		mPrimitives.push_back(list[index]);
+	}
+}
+
+BVHNodeRef BVHNode::create(const HitableListRef &aList, float aTime0, float aTime1, const BVHBuildOptions &aOptions)
+{
+	return BVHNodeRef(new BVHNode(aList, aTime0, aTime1, aOptions));
+}
+
+bool BVHNode::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
+{
+	return mBVH.intersect(aRay, aTMin, aTMax, [&](uint32_t aFirst, uint32_t aCount, uint32_t, float &aClosest)
+	{
+		bool hitAnything = false;
+		for (uint32_t i = aFirst; i < aFirst + aCount; ++i)
+		{
+			if (mPrimitives[i]->hit(aRay, aTMin, aClosest, aRecord))
+			{
+				hitAnything = true;
+				aClosest = aRecord.t;
+			}
+		}
+		return hitAnything;
+	});
+}
+
+bool BVHNode::boundingBox(float aTime0, float aTime1, AABB &aBox) const
+{
+	if (mBVH.empty())
+	{
+		return false;
+	}
+	aBox = mBVH.bounds();
+	return true;
+}
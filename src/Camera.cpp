@@ -24,11 +24,11 @@ Camera::Camera(const glm::vec3 &eye, const glm::vec3 &lookAt, const glm::vec3 &u
 	mVertical = 2.0f * halfHeight * focus * mV;
 }
 
-Ray Camera::generateRay(float u, float v) const
+Ray Camera::generateRay(float u, float v, Sampler &aSampler) const
 {
-	glm::vec3 rd = mLensRadius * glm::vec3(glm::circularRand(1.0f), 0.0f);
+	glm::vec3 rd = mLensRadius * glm::vec3(aSampler.circularRand(1.0f), 0.0f);
 	glm::vec3 offset = mU * rd.x + mV * rd.y;
-	float randTime = mTime0 + randFloat() * (mTime1 - mTime0);
+	float randTime = mTime0 + aSampler.next1D() * (mTime1 - mTime0);
 
 	// construct a ray that originates from somewhere on the circular lens at a random time interval
 	return Ray{ mOrigin + offset, mLowerLeftCorner + u * mHorizontal + v * mVertical - mOrigin - offset, randTime };
@@ -0,0 +1,37 @@
+#include "../include/FileUtils.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+bool writeFileAtomically(const std::string &aPath, const std::function<bool(std::ostream &aStream)> &aWrite)
+{
+	std::string temporaryPath = aPath + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary);
+		if (!file || !aWrite(file) || !file.flush())
+		{
+			std::cerr << "Failed to write " << temporaryPath << std::endl;
+			file.close();
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+	}
+
+	// rename() does not replace an existing file everywhere
+	if (std::rename(temporaryPath.c_str(), aPath.c_str()) != 0 && (std::remove(aPath.c_str()) != 0 || std::rename(temporaryPath.c_str(), aPath.c_str()) != 0))
+	{
+		std::cerr << "Failed to replace " << aPath << std::endl;
+		std::remove(temporaryPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool writeFileAtomically(const std::string &aPath, const char *aData, size_t aSize)
+{
+	return writeFileAtomically(aPath, [&](std::ostream &aStream)
+	{
+		return static_cast<bool>(aStream.write(aData, aSize));
+	});
+}
@@ -0,0 +1,13 @@
+#include "../include/Framebuffer.h"
+
+Framebuffer::Framebuffer(uint32_t aWidth, uint32_t aHeight) :
+	mWidth(aWidth),
+	mHeight(aHeight),
+	mPixels(static_cast<size_t>(aWidth) * aHeight, glm::vec3(0.0f))
+{
+}
+
+FramebufferRef Framebuffer::create(uint32_t aWidth, uint32_t aHeight)
+{
+	return FramebufferRef(new Framebuffer(aWidth, aHeight));
+}
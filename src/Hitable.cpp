@@ -1,4 +1,5 @@
 #include "../include/Hitable.h"
+#include "../include/Stats.h"
 
 //----------------------------------------------------------------------------------
 // hitable list
@@ -19,6 +20,9 @@ HitableListRef HitableList::create(const std::vector<HitableRef> &aList)
 
 bool HitableList::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
 {
+	RT_STAT_INCREMENT(StatCounter::ListTraversals);
+	RT_STAT_ADD(StatCounter::ListObjectTests, mList.size());
+
 	HitRecord tempRecord;
 	bool hitAnything = false;
 	float closest = aTMax;
@@ -69,21 +73,22 @@ bool HitableList::boundingBox(float aTime0, float aTime1, AABB &aBox) const
 //----------------------------------------------------------------------------------
 // sphere
 Sphere::Sphere() :
+	mMaterialId(0),
 	mCenter(0.0f),
 	mRadius(1.0f)
 {
 }
 
-Sphere::Sphere(const glm::vec3 &aCenter, float aRadius, const MaterialRef &aMaterial) :
+Sphere::Sphere(const glm::vec3 &aCenter, float aRadius, uint32_t aMaterialId) :
+	mMaterialId(aMaterialId),
 	mCenter(aCenter),
-	mRadius(aRadius),
-	mMaterial(aMaterial)
+	mRadius(aRadius)
 {
 }
 
-SphereRef Sphere::create(const glm::vec3 &aCenter, float aRadius, const MaterialRef &aMaterial)
+SphereRef Sphere::create(const glm::vec3 &aCenter, float aRadius, uint32_t aMaterialId)
 {
-	return SphereRef(new Sphere(aCenter, aRadius, aMaterial));
+	return SphereRef(new Sphere(aCenter, aRadius, aMaterialId));
 }
 
 bool Sphere::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
@@ -105,7 +110,7 @@ bool Sphere::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord)
 			aRecord.t = temp;
 			aRecord.position = aRay.pointAtTime(aRecord.t);
 			aRecord.normal = (aRecord.position - mCenter) / mRadius;
-			aRecord.material = mMaterial;
+			aRecord.materialId = mMaterialId;
 			return true;
 		}
 
@@ -116,7 +121,7 @@ bool Sphere::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord)
 			aRecord.t = temp;
 			aRecord.position = aRay.pointAtTime(aRecord.t);
 			aRecord.normal = (aRecord.position - mCenter) / mRadius;
-			aRecord.material = mMaterial;
+			aRecord.materialId = mMaterialId;
 			return true;
 		}
 	}
@@ -132,19 +137,19 @@ bool Sphere::boundingBox(float aTime0, float aTime1, AABB &aBox) const
 
 //----------------------------------------------------------------------------------
 // moving sphere
-MovingSphere::MovingSphere(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, const MaterialRef &aMaterial) :
+MovingSphere::MovingSphere(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, uint32_t aMaterialId) :
+	mMaterialId(aMaterialId),
 	mCenter0(aCenter0),
 	mCenter1(aCenter1),
 	mTime0(aTime0),
 	mTime1(aTime1),
-	mRadius(aRadius),
-	mMaterial(aMaterial)
+	mRadius(aRadius)
 {
 }
 
-MovingSphereRef MovingSphere::create(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, const MaterialRef &aMaterial)
+MovingSphereRef MovingSphere::create(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, uint32_t aMaterialId)
 {
-	return MovingSphereRef(new MovingSphere(aCenter0, aCenter1, aTime0, aTime1, aRadius, aMaterial));
+	return MovingSphereRef(new MovingSphere(aCenter0, aCenter1, aTime0, aTime1, aRadius, aMaterialId));
 }
 
 bool MovingSphere::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
@@ -166,7 +171,7 @@ bool MovingSphere::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRe
 			aRecord.t = temp;
 			aRecord.position = aRay.pointAtTime(aRecord.t);
 			aRecord.normal = (aRecord.position - currCenter) / mRadius;
-			aRecord.material = mMaterial;
+			aRecord.materialId = mMaterialId;
 			return true;
 		}
 
@@ -177,7 +182,7 @@ bool MovingSphere::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRe
 			aRecord.t = temp;
 			aRecord.position = aRay.pointAtTime(aRecord.t);
 			aRecord.normal = (aRecord.position - currCenter) / mRadius;
-			aRecord.material = mMaterial;
+			aRecord.materialId = mMaterialId;
 			return true;
 		}
 	}
@@ -200,118 +205,4 @@ bool MovingSphere::boundingBox(float aTime0, float aTime1, AABB &aBox) const
 					 mCenter1 + glm::vec3(mRadius));// max
 	aBox = enclosingBox(box0, box1);
 	return true;
-}
-
-//----------------------------------------------------------------------------------
-// BVH node
-BVHNode::BVHNode(const HitableListRef &aList, float aTime0, float aTime1)
-{
-	size_t n = aList->list().size();
-	
-	// pick an axis to sort along
-	int axis = static_cast<int>(3.0f * randFloat());
-
-	// sort along the chosen axis
-	switch (axis)
-	{
-	case 0:	// x
-		std::sort(aList->list().begin(), aList->list().end(), comparator(0));
-		break;
-	case 1: // y
-		std::sort(aList->list().begin(), aList->list().end(), comparator(1));
-		break;
-	case 2: // z
-		std::sort(aList->list().begin(), aList->list().end(), comparator(2));
-		break;
-	default:
-		break;
-	}
-
-	if (n == 1) // one element
-	{
-		mLeft = mRight = aList->list().at(0);
-	}
-	if (n == 2) // two elements
-	{
-		mLeft = aList->list().at(0);
-		mRight = aList->list().at(1);
-	}
-	else // split in half
-	{
-		size_t half_size = aList->list().size() / 2;
-		std::vector<HitableRef> lowerHalf(aList->list().begin(), aList->list().begin() + half_size);
-		std::vector<HitableRef> upperHalf(aList->list().begin() + half_size, aList->list().end());
-
-		HitableListRef low = HitableList::create(lowerHalf);
-		HitableListRef high = HitableList::create(upperHalf);
-
-		mLeft = create(low, aTime0, aTime1);
-		mRight = create(high, aTime0, aTime1);
-	}
-
-	AABB boxLeft;
-	AABB boxRight;
-	if (!mLeft->boundingBox(aTime0, aTime1, boxLeft) || !mRight->boundingBox(aTime0, aTime1, boxRight))
-	{
-		std::cerr << "No bounding box in BVH node constructor." << std::endl;
-	}
-	mBox = enclosingBox(boxLeft, boxRight);
-}
-
-BVHNodeRef BVHNode::create(const HitableListRef &aList, float aTime0, float aTime1)
-{
-	return BVHNodeRef(new BVHNode(aList, aTime0, aTime1));
-}
-
-bool BVHNode::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
-{
-	if (mBox.hit(aRay, aTMin, aTMax))
-	{
-		// check child nodes for a hit
-		HitRecord leftRecord, rightRecord;
-		bool hitLeft = mLeft->hit(aRay, aTMin, aTMax, leftRecord);
-		bool hitRight = mRight->hit(aRay, aTMin, aTMax, leftRecord);
-		if (hitLeft && hitRight) // pick the node with the closer t
-		{
-			aRecord = leftRecord.t < rightRecord.t ? leftRecord : rightRecord;
-			return true;
-		}
-		else if (hitLeft) // hit left node?
-		{
-			aRecord = leftRecord;
-			return true;
-		}
-		else if (hitRight) // hit right node?
-		{
-			aRecord = rightRecord;
-			return true;
-		}
-		else // hit neither
-		{
-			return false;
-		}
-	}
-	return false;
-}
-
-bool BVHNode::boundingBox(float aTime0, float aTime1, AABB &aBox) const
-{
-	aBox = mBox;
-	return true;
-}
-
-std::function<bool(HitableRef, HitableRef)> BVHNode::comparator(size_t aAxis) const
-{
-	auto boxCompare = [=](const HitableRef &lhs, const HitableRef &rhs) -> bool
-	{
-		AABB boxLeft;
-		AABB boxRight;
-		if (!lhs->boundingBox(0.0f, 0.0f, boxLeft) || !rhs->boundingBox(0.0f, 0.0f, boxRight))
-		{
-			std::cerr << "No bounding box in BVH node constructor." << std::endl;
-		}
-		return boxLeft.min()[aAxis] < boxRight.min()[aAxis];
-	};
-
-	return boxCompare;
 }
\ No newline at end of file
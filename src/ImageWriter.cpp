@@ -0,0 +1,226 @@
+#include "../include/ImageWriter.h"
+#include "../include/FileUtils.h"
+#include "../include/glm/gtc/packing.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace
+{
+	//! appends the raw bytes of a value - all binary formats written here are little-endian, like the hosts we run on
+	template<typename T>
+	void append(std::vector<char> &aData, const T &aValue)
+	{
+		const char *bytes = reinterpret_cast<const char*>(&aValue);
+		aData.insert(aData.end(), bytes, bytes + sizeof(T));
+	}
+
+	//! appends a string, including its terminating zero
+	void appendString(std::vector<char> &aData, const char *aString)
+	{
+		aData.insert(aData.end(), aString, aString + std::strlen(aString) + 1);
+	}
+
+	//! appends the name, type and size that start every attribute of an OpenEXR header
+	void appendAttribute(std::vector<char> &aData, const char *aName, const char *aType, int32_t aSize)
+	{
+		appendString(aData, aName);
+		appendString(aData, aType);
+		append(aData, aSize);
+	}
+
+	//! returns true if the host stores the least significant byte first
+	bool isLittleEndian()
+	{
+		const uint16_t probe = 1;
+		return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+	}
+}
+
+//----------------------------------------------------------------------------------
+// image writer
+ImageWriter::ImageWriter(const ImageOptions &aOptions) :
+	mOptions(aOptions)
+{
+}
+
+ImageWriterRef ImageWriter::create(const ImageOptions &aOptions)
+{
+	return ImageWriterRef(new ImageWriter(aOptions));
+}
+
+ImageFormat ImageWriter::formatFromPath(const std::string &aPath)
+{
+	size_t dot = aPath.find_last_of('.');
+	if (dot == std::string::npos)
+	{
+		return ImageFormat::Auto;
+	}
+
+	std::string extension = aPath.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+	if (extension == "ppm")
+	{
+		return ImageFormat::PPM;
+	}
+	if (extension == "pfm")
+	{
+		return ImageFormat::PFM;
+	}
+	if (extension == "exr")
+	{
+		return ImageFormat::EXR;
+	}
+	return ImageFormat::Auto;
+}
+
+bool ImageWriter::write(const std::string &aPath, const Framebuffer &aFramebuffer) const
+{
+	ImageFormat format = mOptions.format == ImageFormat::Auto ? formatFromPath(aPath) : mOptions.format;
+
+	std::vector<char> data;
+	switch (format)
+	{
+	case ImageFormat::PPM:
+		encodePPM(aFramebuffer, data);
+		break;
+	case ImageFormat::PFM:
+		encodePFM(aFramebuffer, data);
+		break;
+	case ImageFormat::EXR:
+		encodeEXR(aFramebuffer, data);
+		break;
+	default:
+		std::cerr << "Unknown image format for " << aPath << std::endl;
+		return false;
+	}
+
+	return writeFileAtomically(aPath, data.data(), data.size());
+}
+
+void ImageWriter::encodePPM(const Framebuffer &aFramebuffer, std::vector<char> &aData) const
+{
+	const uint32_t width = aFramebuffer.width();
+	const uint32_t height = aFramebuffer.height();
+	std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+
+	aData.resize(header.size() + static_cast<size_t>(width) * height * 3);
+	std::memcpy(aData.data(), header.data(), header.size());
+
+	// PPM stores the top row first
+	const float invGamma = 1.0f / mOptions.gamma;
+	char *pixel = aData.data() + header.size();
+	for (uint32_t row = 0; row < height; ++row)
+	{
+		uint32_t y = height - 1 - row;
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			const glm::vec3 &color = aFramebuffer.at(x, y);
+			for (int c = 0; c < 3; ++c)
+			{
+				float value = powf(glm::clamp(color[c], 0.0f, 1.0f), invGamma);
+				*pixel++ = static_cast<char>(static_cast<uint8_t>(255.99 * value));
+			}
+		}
+	}
+}
+
+void ImageWriter::encodePFM(const Framebuffer &aFramebuffer, std::vector<char> &aData) const
+{
+	static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "PFM rows are copied from the framebuffer directly");
+
+	// a negative scale marks little-endian data - PFM stores the bottom row first, just like the framebuffer
+	std::string header = "PF\n" + std::to_string(aFramebuffer.width()) + " " + std::to_string(aFramebuffer.height()) + "\n" +
+						 (isLittleEndian() ? "-1.0\n" : "1.0\n");
+	const auto &pixels = aFramebuffer.pixels();
+	size_t pixelBytes = pixels.size() * sizeof(glm::vec3);
+
+	aData.resize(header.size() + pixelBytes);
+	std::memcpy(aData.data(), header.data(), header.size());
+	std::memcpy(aData.data() + header.size(), pixels.data(), pixelBytes);
+}
+
+void ImageWriter::encodeEXR(const Framebuffer &aFramebuffer, std::vector<char> &aData) const
+{
+	const int32_t width = static_cast<int32_t>(aFramebuffer.width());
+	const int32_t height = static_cast<int32_t>(aFramebuffer.height());
+
+	// magic number and version 2, single part scanline file
+	const uint8_t magic[] = { 0x76, 0x2f, 0x31, 0x01, 0x02, 0x00, 0x00, 0x00 };
+	aData.insert(aData.end(), magic, magic + sizeof(magic));
+
+	// channels are listed, and stored, in alphabetical order
+	const char *channels[] = { "B", "G", "R" };
+	appendAttribute(aData, "channels", "chlist", 3 * 18 + 1);
+	for (const char *channel : channels)
+	{
+		appendString(aData, channel);
+		append(aData, int32_t(1));	// half
+		append(aData, uint8_t(0));	// pLinear
+		append(aData, uint8_t(0));	// reserved
+		append(aData, uint8_t(0));
+		append(aData, uint8_t(0));
+		append(aData, int32_t(1));	// x sampling
+		append(aData, int32_t(1));	// y sampling
+	}
+	append(aData, uint8_t(0));
+
+	appendAttribute(aData, "compression", "compression", 1);
+	append(aData, uint8_t(0));	// none
+
+	const int32_t window[] = { 0, 0, width - 1, height - 1 };
+	appendAttribute(aData, "dataWindow", "box2i", sizeof(window));
+	append(aData, window);
+	appendAttribute(aData, "displayWindow", "box2i", sizeof(window));
+	append(aData, window);
+
+	appendAttribute(aData, "lineOrder", "lineOrder", 1);
+	append(aData, uint8_t(0));	// increasing y
+
+	appendAttribute(aData, "pixelAspectRatio", "float", 4);
+	append(aData, 1.0f);
+
+	const float center[] = { 0.0f, 0.0f };
+	appendAttribute(aData, "screenWindowCenter", "v2f", sizeof(center));
+	append(aData, center);
+
+	appendAttribute(aData, "screenWindowWidth", "float", 4);
+	append(aData, 1.0f);
+
+	// end of header
+	append(aData, uint8_t(0));
+
+	// uncompressed files hold one scanline per block, so every block has the same size and the offset table can be
+	// filled in up front
+	const int32_t lineBytes = width * 3 * static_cast<int32_t>(sizeof(uint16_t));
+	const uint64_t blockBytes = 2 * sizeof(int32_t) + lineBytes;
+	const uint64_t firstBlock = aData.size() + height * sizeof(uint64_t);
+	for (int32_t y = 0; y < height; ++y)
+	{
+		append(aData, firstBlock + y * blockBytes);
+	}
+
+	aData.reserve(aData.size() + height * blockBytes);
+	std::vector<uint16_t> line(width * 3);
+	for (int32_t y = 0; y < height; ++y)
+	{
+		// EXR's y axis points down
+		uint32_t row = static_cast<uint32_t>(height - 1 - y);
+		for (int32_t x = 0; x < width; ++x)
+		{
+			const glm::vec3 &color = aFramebuffer.at(static_cast<uint32_t>(x), row);
+			line[x] = glm::packHalf1x16(color.b);
+			line[width + x] = glm::packHalf1x16(color.g);
+			line[2 * width + x] = glm::packHalf1x16(color.r);
+		}
+
+		append(aData, y);
+		append(aData, lineBytes);
+		const char *bytes = reinterpret_cast<const char*>(line.data());
+		aData.insert(aData.end(), bytes, bytes + lineBytes);
+	}
+}
@@ -0,0 +1,154 @@
+#include "../include/InstanceSet.h"
+
+#include <cmath>
+
+InstanceSetRef InstanceSet::create()
+{
+	return InstanceSetRef(new InstanceSet());
+}
+
+uint32_t InstanceSet::addGeometry(const HitableRef &aGeometry)
+{
+	mGeometries.push_back(aGeometry);
+	return static_cast<uint32_t>(mGeometries.size() - 1);
+}
+
+uint32_t InstanceSet::addInstance(uint32_t aGeometry, const glm::mat4 &aTransform)
+{
+	mTransforms.push_back(aTransform);
+	mInstanceGeometries.push_back(aGeometry);
+	return static_cast<uint32_t>(mTransforms.size() - 1);
+}
+
+void InstanceSet::setTransform(uint32_t aInstance, const glm::mat4 &aTransform)
+{
+	mTransforms[aInstance] = aTransform;
+}
+
+AABB InstanceSet::transformBox(const glm::mat4 &aTransform, const AABB &aBox)
+{
+	// the center is transformed as a point, and the half extent by the absolute values of the linear part, which bounds
+	// all eight transformed corners at once
+	glm::vec3 center{ aTransform * glm::vec4(aBox.centroid(), 1.0f) };
+	glm::vec3 halfExtent = 0.5f * aBox.extent();
+	glm::vec3 extent{ 0.0f };
+	for (int column = 0; column < 3; ++column)
+	{
+		for (int row = 0; row < 3; ++row)
+		{
+			extent[row] += std::abs(aTransform[column][row]) * halfExtent[column];
+		}
+	}
+
+	// the rays moved into object space carry rounding errors of their own, so a box computed to the last bit could still
+	// miss a ray that hits the geometry right at its edge
+	extent += 1e-6f * (glm::abs(center) + extent);
+	return AABB(center - extent, center + extent);
+}
+
+std::vector<AABB> InstanceSet::instanceBounds() const
+{
+	// every geometry is asked for its box once, however many instances it has
+	std::vector<AABB> geometryBounds(mGeometries.size());
+	std::vector<bool> geometryValid(mGeometries.size());
+	for (size_t i = 0; i < mGeometries.size(); ++i)
+	{
+		geometryValid[i] = mGeometries[i]->boundingBox(0.0f, 0.0f, geometryBounds[i]);
+		if (!geometryValid[i])
+		{
+			std::cerr << "No bounding box for a geometry of the instance set." << std::endl;
+		}
+	}
+
+	// instances of an empty geometry get an empty box at their origin, which no ray ever reaches
+	std::vector<AABB> bounds(mTransforms.size());
+	for (size_t i = 0; i < mTransforms.size(); ++i)
+	{
+		uint32_t geometry = mInstanceGeometries[i];
+		glm::vec3 origin{ mTransforms[i][3] };
+		bounds[i] = geometryValid[geometry] ? transformBox(mTransforms[i], geometryBounds[geometry]) : AABB(origin, origin);
+	}
+	return bounds;
+}
+
+void InstanceSet::updateLeafInstances()
+{
+	// traversal reads the inverse transforms, next to each other in leaf order
+	mLeafInstances.resize(mTransforms.size());
+	for (size_t slot = 0; slot < mLeafInstances.size(); ++slot)
+	{
+		uint32_t index = mBVH.primitiveIndices()[slot];
+		glm::mat4 worldToObject = glm::inverse(mTransforms[index]);
+		LeafInstance &instance = mLeafInstances[slot];
+		for (int row = 0; row < 3; ++row)
+		{
+			instance.worldToObject[row] = glm::vec4(worldToObject[0][row], worldToObject[1][row], worldToObject[2][row], worldToObject[3][row]);
+		}
+		instance.geometry = mInstanceGeometries[index];
+	}
+}
+
+void InstanceSet::build(const BVHBuildOptions &aOptions)
+{
+	mBVH.build(instanceBounds(), aOptions);
+	updateLeafInstances();
+}
+
+void InstanceSet::refit()
+{
+	mBVH.refit(instanceBounds());
+	updateLeafInstances();
+}
+
+bool InstanceSet::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
+{
+	if (mBVH.empty())
+	{
+		return false;
+	}
+
+	const glm::vec4 origin{ aRay.origin(), 1.0f };
+	const glm::vec4 direction{ aRay.direction(), 0.0f };
+	uint32_t closest = 0;
+	bool hitAnything = mBVH.intersect(aRay, aTMin, aTMax, [&](uint32_t aFirst, uint32_t aCount, uint32_t, float &aClosest)
+	{
+		bool hit = false;
+		for (uint32_t i = aFirst; i < aFirst + aCount; ++i)
+		{
+			const LeafInstance &instance = mLeafInstances[i];
+			const glm::vec4 *rows = instance.worldToObject;
+			Ray local{ glm::vec3(glm::dot(rows[0], origin), glm::dot(rows[1], origin), glm::dot(rows[2], origin)),
+					   glm::vec3(glm::dot(rows[0], direction), glm::dot(rows[1], direction), glm::dot(rows[2], direction)), aRay.time() };
+			HitRecord record;
+			if (mGeometries[instance.geometry]->hit(local, aTMin, aClosest, record))
+			{
+				aClosest = record.t;
+				aRecord = record;
+				closest = i;
+				hit = true;
+			}
+		}
+		return hit;
+	});
+
+	// back into the world: the position from the world ray, which reaches it at the same distance, and the normal by the
+	// inverse transpose of object-to-world, whose columns are the rows of world-to-object
+	if (hitAnything)
+	{
+		const glm::vec4 *rows = mLeafInstances[closest].worldToObject;
+		glm::vec3 normal = aRecord.normal.x * glm::vec3(rows[0]) + aRecord.normal.y * glm::vec3(rows[1]) + aRecord.normal.z * glm::vec3(rows[2]);
+		aRecord.position = aRay.pointAtTime(aRecord.t);
+		aRecord.normal = glm::normalize(normal);
+	}
+	return hitAnything;
+}
+
+bool InstanceSet::boundingBox(float aTime0, float aTime1, AABB &aBox) const
+{
+	if (mBVH.empty())
+	{
+		return false;
+	}
+	aBox = mBVH.bounds();
+	return true;
+}
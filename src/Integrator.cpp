@@ -0,0 +1,112 @@
+#include "../include/Integrator.h"
+#include "../include/Stats.h"
+
+#include <algorithm>
+#include <limits>
+
+//----------------------------------------------------------------------------------
+// integrator
+Integrator::Integrator(const IntegratorOptions &aOptions) :
+	mOptions(aOptions)
+{
+}
+
+IntegratorRef Integrator::create(const IntegratorOptions &aOptions)
+{
+	return IntegratorRef(new Integrator(aOptions));
+}
+
+glm::vec3 Integrator::radiance(const Ray &aRay, const Scene &aScene, Sampler &aSampler, uint32_t &aRayCount) const
+{
+	HitRecord record;
+	++aRayCount;
+	bool hit = aScene.hit(aRay, mOptions.tMin, std::numeric_limits<float>::max(), record);
+	return continuePath(aRay, hit, record, aScene, aSampler, aRayCount);
+}
+
+template<int N>
+void Integrator::radiance(RayPacket<N> &aPacket, const Scene &aScene, Sampler *aSamplers, glm::vec3 *aRadiance, uint32_t &aRayCount) const
+{
+	HitRecord records[N];
+	uint32_t hitMask = aScene.hitPacket(aPacket, mOptions.tMin, records);
+	for (uint32_t mask = aPacket.activeMask; mask; mask &= mask - 1)
+	{
+		uint32_t i = firstBit(mask);
+		++aRayCount;
+		aRadiance[i] = continuePath(aPacket.rays[i], (hitMask >> i) & 1, records[i], aScene, aSamplers[i], aRayCount);
+	}
+}
+
+template void Integrator::radiance<4>(RayPacket<4> &aPacket, const Scene &aScene, Sampler *aSamplers, glm::vec3 *aRadiance, uint32_t &aRayCount) const;
+template void Integrator::radiance<8>(RayPacket<8> &aPacket, const Scene &aScene, Sampler *aSamplers, glm::vec3 *aRadiance, uint32_t &aRayCount) const;
+template void Integrator::radiance<16>(RayPacket<16> &aPacket, const Scene &aScene, Sampler *aSamplers, glm::vec3 *aRadiance, uint32_t &aRayCount) const;
+
+glm::vec3 Integrator::continuePath(const Ray &aRay, bool aHit, const HitRecord &aRecord, const Scene &aScene, Sampler &aSampler, uint32_t &aRayCount) const
+{
+	const uint32_t maxDepths[] = { mOptions.maxDiffuseDepth, mOptions.maxSpecularDepth, mOptions.maxTransmissionDepth };
+	uint32_t depths[] = { 0, 0, 0 };
+	glm::vec3 throughput{ 1.0f };
+	Ray ray = aRay;
+	HitRecord record = aRecord;
+	bool hit = aHit;
+
+	for (uint32_t depth = 0; ; ++depth)
+	{
+		// did we hit anything?
+		// every path traced depth + 1 rays by the time it ends
+		if (!hit)
+		{
+			RT_STAT_PATH(StatCounter::PathsEscaped, depth + 1);
+			return throughput * sky(ray.direction());
+		}
+
+		// calculate the scattered ray based on the material properties at the hit location
+		aSampler.startBounce(depth + 1);
+		Ray scattered;
+		glm::vec3 attenuation;
+		ScatterType type;
+		if (depth >= mOptions.maxDepth)
+		{
+			RT_STAT_PATH(StatCounter::PathsDepthLimited, depth + 1);
+			return glm::vec3(0.0f);
+		}
+		if (!aScene.material(record.materialId).scatter(ray, record, aSampler, attenuation, scattered, type))
+		{
+			RT_STAT_PATH(StatCounter::PathsAbsorbed, depth + 1);
+			return glm::vec3(0.0f);
+		}
+		if (++depths[static_cast<int>(type)] > maxDepths[static_cast<int>(type)])
+		{
+			RT_STAT_PATH(StatCounter::PathsDepthLimited, depth + 1);
+			return glm::vec3(0.0f);
+		}
+		throughput *= attenuation;
+
+		// terminate dim paths early - the survivors carry the energy of the terminated ones
+		if (depth + 1 >= mOptions.rouletteDepth)
+		{
+			float survival = std::min(0.95f, std::max(throughput.r, std::max(throughput.g, throughput.b)));
+			if (aSampler.next1D() >= survival)
+			{
+				RT_STAT_PATH(StatCounter::PathsRouletted, depth + 1);
+				return glm::vec3(0.0f);
+			}
+			throughput /= survival;
+		}
+
+		ray = scattered;
+		++aRayCount;
+		hit = aScene.hit(ray, mOptions.tMin, std::numeric_limits<float>::max(), record);
+	}
+}
+
+glm::vec3 Integrator::sky(const glm::vec3 &aDirection)
+{
+	glm::vec3 unitDirection = glm::normalize(aDirection);
+
+	// remap the y-coord of the ray direction to 0...1
+	float t = 0.5f * (unitDirection.y + 1.0f);
+	const glm::vec3 white{ 1.0f };
+	const glm::vec3 sky{ 0.5f, 0.7f, 1.0f };
+	return lerp(white, sky, t);
+}
@@ -0,0 +1,118 @@
+#include "../include/MappedFile.h"
+
+#include <iostream>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string &aPath)
+{
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		std::cerr << "Failed to open " << aPath << std::endl;
+		return false;
+	}
+	mFile = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		std::cerr << "Failed to read the size of " << aPath << std::endl;
+		close();
+		return false;
+	}
+	mSize = static_cast<size_t>(size.QuadPart);
+	if (mSize == 0)
+	{
+		return true;
+	}
+
+	mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	mData = mMapping ? static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+	mFile = ::open(aPath.c_str(), O_RDONLY);
+	if (mFile < 0)
+	{
+		std::cerr << "Failed to open " << aPath << std::endl;
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(mFile, &status) != 0)
+	{
+		std::cerr << "Failed to read the size of " << aPath << std::endl;
+		close();
+		return false;
+	}
+	mSize = static_cast<size_t>(status.st_size);
+	if (mSize == 0)
+	{
+		return true;
+	}
+
+	void *data = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+	if (data != MAP_FAILED)
+	{
+		// the whole file is about to be read, in parallel - start reading ahead right away
+		madvise(data, mSize, MADV_WILLNEED);
+		mData = static_cast<const char*>(data);
+	}
+#endif
+
+	if (!mData)
+	{
+		std::cerr << "Failed to map " << aPath << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close()
+{
+#if defined(_WIN32)
+	if (mData)
+	{
+		UnmapViewOfFile(mData);
+	}
+	if (mMapping)
+	{
+		CloseHandle(mMapping);
+	}
+	if (mFile)
+	{
+		CloseHandle(mFile);
+	}
+	mMapping = nullptr;
+	mFile = nullptr;
+#else
+	if (mData)
+	{
+		munmap(const_cast<char*>(mData), mSize);
+	}
+	if (mFile >= 0)
+	{
+		::close(mFile);
+	}
+	mFile = -1;
+#endif
+	mData = nullptr;
+	mSize = 0;
+}
@@ -1,4 +1,20 @@
 #include "../include/Material.h"
+#include "../include/Stats.h"
+
+//----------------------------------------------------------------------------------
+// material
+MaterialRef Material::create(const MaterialDesc &aDesc)
+{
+	switch (aDesc.type)
+	{
+	case MaterialType::Metallic:
+		return std::make_shared<Metallic>(aDesc.albedo, aDesc.roughness);
+	case MaterialType::Dieletric:
+		return std::make_shared<Dieletric>(aDesc.ior);
+	default:
+		return std::make_shared<Lambertian>(aDesc.albedo);
+	}
+}
 
 //----------------------------------------------------------------------------------
 // lambertian
@@ -7,11 +23,13 @@ Lambertian::Lambertian(const glm::vec3 &aAlbedo) :
 {
 }
 
-bool Lambertian::scatter(const Ray &aRay, const HitRecord &aRecord, glm::vec3 &aAttenuation, Ray &aScattered) const
+bool Lambertian::scatter(const Ray &aRay, const HitRecord &aRecord, Sampler &aSampler, glm::vec3 &aAttenuation, Ray &aScattered, ScatterType &aType) const
 {
-	glm::vec3 target = aRecord.position + aRecord.normal + glm::sphericalRand(1.0f);
+	glm::vec3 target = aRecord.position + aRecord.normal + aSampler.sphericalRand(1.0f);
 	aScattered = Ray(aRecord.position, target - aRecord.position, aRay.time());
 	aAttenuation = mAlbedo;
+	aType = ScatterType::Diffuse;
+	RT_STAT_INCREMENT(StatCounter::ScatterDiffuse);
 	return true;
 }
 
@@ -25,12 +43,17 @@ Metallic::Metallic(const glm::vec3 &aAlbedo, float aRoughness) :
 	mRoughness = aRoughness;
 }
 
-bool Metallic::scatter(const Ray &aRay, const HitRecord &aRecord, glm::vec3 &aAttenuation, Ray &aScattered) const
+bool Metallic::scatter(const Ray &aRay, const HitRecord &aRecord, Sampler &aSampler, glm::vec3 &aAttenuation, Ray &aScattered, ScatterType &aType) const
 {
 	glm::vec3 reflected = glm::reflect(glm::normalize(aRay.direction()), aRecord.normal);
-	aScattered = Ray(aRecord.position, reflected + mRoughness * glm::sphericalRand(1.0f), aRay.time());
+	aScattered = Ray(aRecord.position, reflected + mRoughness * aSampler.sphericalRand(1.0f), aRay.time());
 	aAttenuation = mAlbedo;
-	return glm::dot(aScattered.direction(), aRecord.normal) > 0.0f;
+	aType = ScatterType::Specular;
+
+	// rays scattered below the surface are absorbed
+	bool scattered = glm::dot(aScattered.direction(), aRecord.normal) > 0.0f;
+	RT_STAT_INCREMENT(scattered ? StatCounter::ScatterSpecular : StatCounter::ScatterAbsorbed);
+	return scattered;
 }
 
 //----------------------------------------------------------------------------------
@@ -40,7 +63,7 @@ Dieletric::Dieletric(float aIOR) :
 {
 }
 
-bool Dieletric::scatter(const Ray &aRay, const HitRecord &aRecord, glm::vec3 &aAttenuation, Ray &aScattered) const
+bool Dieletric::scatter(const Ray &aRay, const HitRecord &aRecord, Sampler &aSampler, glm::vec3 &aAttenuation, Ray &aScattered, ScatterType &aType) const
 {
 	glm::vec3 outwardNormal;
 	glm::vec3 reflected = glm::reflect(glm::normalize(aRay.direction()), aRecord.normal);
@@ -77,13 +100,17 @@ bool Dieletric::scatter(const Ray &aRay, const HitRecord &aRecord, glm::vec3 &aA
 	}
 
 	// reflect or refract based on the probabilities calculated above
-	if (randFloat() < reflectProbability)
+	if (aSampler.next1D() < reflectProbability)
 	{
 		aScattered = Ray(aRecord.position, reflected, aRay.time());
+		aType = ScatterType::Specular;
+		RT_STAT_INCREMENT(StatCounter::ScatterSpecular);
 	}
 	else 
 	{
 		aScattered = Ray(aRecord.position, refracted, aRay.time());
+		aType = ScatterType::Transmission;
+		RT_STAT_INCREMENT(StatCounter::ScatterTransmission);
 	}
 	
 	return true;
@@ -0,0 +1,811 @@
+#include "../include/MeshLoader.h"
+#include "../include/MappedFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	//! bytes of an OBJ file per parsing task - large enough that the per-chunk work dwarfs scheduling, small enough that
+	//! work stealing evens out files whose vertices and faces are not spread uniformly
+	const size_t kChunkSize = size_t(1) << 20;
+
+	//! PLY vertices or faces per parsing task
+	const uint64_t kItemsPerChunk = 1 << 16;
+
+	//----------------------------------------------------------------------------------
+	// text parsing, always bounded by the end of a chunk, since the mapped file is not terminated by a zero
+
+	inline bool isBlank(char aChar)
+	{
+		return aChar == ' ' || aChar == '\t' || aChar == '\r';
+	}
+
+	inline bool isDigit(char aChar)
+	{
+		return aChar >= '0' && aChar <= '9';
+	}
+
+	//! returns the first character at or after aBegin that is not a space or tab
+	inline const char* skipBlanks(const char *aBegin, const char *aEnd)
+	{
+		while (aBegin < aEnd && isBlank(*aBegin))
+		{
+			++aBegin;
+		}
+		return aBegin;
+	}
+
+	//! returns the first space or tab at or after aBegin
+	inline const char* skipToken(const char *aBegin, const char *aEnd)
+	{
+		while (aBegin < aEnd && !isBlank(*aBegin))
+		{
+			++aBegin;
+		}
+		return aBegin;
+	}
+
+	//! returns the position of the newline that ends the line starting at aBegin, or aEnd if it is the last line
+	inline const char* lineEnd(const char *aBegin, const char *aEnd)
+	{
+		const void *newline = std::memchr(aBegin, '\n', aEnd - aBegin);
+		return newline ? static_cast<const char*>(newline) : aEnd;
+	}
+
+	//! returns mantissa * 10^exponent - exact powers of ten up to 1e22 keep the result within an ulp of the double
+	//! closest to the decimal number, which is far below the precision of the float it ends up in
+	double scaleByPowerOfTen(uint64_t aMantissa, int aExponent)
+	{
+		static const double kPowers[] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		double value = static_cast<double>(aMantissa);
+		if (aExponent < 0)
+		{
+			return aExponent >= -22 ? value / kPowers[-aExponent] : value * std::pow(10.0, aExponent);
+		}
+		return aExponent <= 22 ? value * kPowers[aExponent] : value * std::pow(10.0, aExponent);
+	}
+
+	//! parses a decimal floating point number like "-1.5e-3" at aBegin and returns the position after it, or nullptr if
+	//! there is no number - strtof cannot be used, as it might read past the end of the mapping
+	const char* parseFloat(const char *aBegin, const char *aEnd, float &aValue)
+	{
+		const char *p = aBegin;
+		bool negative = p < aEnd && *p == '-';
+		p += (p < aEnd && (*p == '-' || *p == '+')) ? 1 : 0;
+
+		// digits beyond the 18th do not fit the mantissa and only shift the exponent
+		const uint64_t limit = 100000000000000000ull;
+		uint64_t mantissa = 0;
+		int exponent = 0;
+		bool digits = false;
+		for (; p < aEnd && isDigit(*p); ++p)
+		{
+			digits = true;
+			if (mantissa < limit)
+			{
+				mantissa = 10 * mantissa + (*p - '0');
+			}
+			else
+			{
+				++exponent;
+			}
+		}
+		if (p < aEnd && *p == '.')
+		{
+			for (++p; p < aEnd && isDigit(*p); ++p)
+			{
+				digits = true;
+				if (mantissa < limit)
+				{
+					mantissa = 10 * mantissa + (*p - '0');
+					--exponent;
+				}
+			}
+		}
+		if (!digits)
+		{
+			return nullptr;
+		}
+
+		if (p < aEnd && (*p == 'e' || *p == 'E'))
+		{
+			const char *q = p + 1;
+			bool negativeExponent = q < aEnd && *q == '-';
+			q += (q < aEnd && (*q == '-' || *q == '+')) ? 1 : 0;
+			if (q < aEnd && isDigit(*q))
+			{
+				int value = 0;
+				for (; q < aEnd && isDigit(*q); ++q)
+				{
+					value = std::min(10 * value + (*q - '0'), 100000);
+				}
+				exponent += negativeExponent ? -value : value;
+				p = q;
+			}
+		}
+
+		double value = mantissa == 0 ? 0.0 : scaleByPowerOfTen(mantissa, std::max(-400, std::min(400, exponent)));
+		aValue = static_cast<float>(negative ? -value : value);
+		return p;
+	}
+
+	//! parses a decimal integer at aBegin and returns the position after it, or nullptr if there is no number
+	const char* parseInt(const char *aBegin, const char *aEnd, int64_t &aValue)
+	{
+		const char *p = aBegin;
+		bool negative = p < aEnd && *p == '-';
+		p += (p < aEnd && (*p == '-' || *p == '+')) ? 1 : 0;
+		if (p == aEnd || !isDigit(*p))
+		{
+			return nullptr;
+		}
+
+		int64_t value = 0;
+		for (; p < aEnd && isDigit(*p); ++p)
+		{
+			value = std::min<int64_t>(10 * value + (*p - '0'), std::numeric_limits<uint32_t>::max());
+		}
+		aValue = negative ? -value : value;
+		return p;
+	}
+
+	//! returns the keyword an OBJ line starts with, if it is a vertex ('v') or face ('f') statement, and 0 otherwise -
+	//! aBegin is moved past the keyword
+	inline char objStatement(const char *&aBegin, const char *aEnd)
+	{
+		const char *p = skipBlanks(aBegin, aEnd);
+		if (aEnd - p < 2 || (p[0] != 'v' && p[0] != 'f') || !isBlank(p[1]))
+		{
+			return 0;
+		}
+		aBegin = p + 1;
+		return p[0];
+	}
+
+	//! returns the start of the next vertex reference of a face at or after aBegin, or aEnd if there is none - a
+	//! comment ends the face
+	inline const char* nextReference(const char *aBegin, const char *aEnd)
+	{
+		const char *p = skipBlanks(aBegin, aEnd);
+		return (p < aEnd && *p == '#') ? aEnd : p;
+	}
+
+	//! a range of whole lines of an OBJ file, with the number of vertices and triangles in it and where they go
+	struct ObjChunk
+	{
+		const char *begin;
+		const char *end;
+		uint64_t vertexCount = 0;
+		uint64_t triangleCount = 0;
+		uint64_t firstVertex = 0;
+		uint64_t firstTriangle = 0;
+		uint64_t errors = 0;	// numbers that could not be parsed and indices out of range
+	};
+
+	//! counts the vertices and triangles of a chunk
+	void countOBJ(ObjChunk &aChunk)
+	{
+		for (const char *line = aChunk.begin; line < aChunk.end; )
+		{
+			const char *end = lineEnd(line, aChunk.end);
+			const char *p = line;
+			char statement = objStatement(p, end);
+			if (statement == 'v')
+			{
+				++aChunk.vertexCount;
+			}
+			else if (statement == 'f')
+			{
+				uint64_t references = 0;
+				for (p = nextReference(p, end); p < end; p = nextReference(skipToken(p, end), end))
+				{
+					++references;
+				}
+				aChunk.triangleCount += references >= 3 ? references - 2 : 0;
+			}
+			line = end < aChunk.end ? end + 1 : end;
+		}
+	}
+
+	//! parses the vertices and triangles of a chunk into the mesh's buffers, at the offsets computed from the counts of
+	//! all chunks before it - the lines are split exactly as in countOBJ(), so that they produce as many of both
+	void parseOBJ(ObjChunk &aChunk, const MeshLoadOptions &aOptions, uint64_t aVertexCount, float **aPositions, uint32_t *aIndices, uint32_t *aMaterials)
+	{
+		uint64_t vertex = aChunk.firstVertex;
+		uint64_t triangle = aChunk.firstTriangle;
+		for (const char *line = aChunk.begin; line < aChunk.end; )
+		{
+			const char *end = lineEnd(line, aChunk.end);
+			const char *p = line;
+			char statement = objStatement(p, end);
+			if (statement == 'v')
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					float value = 0.0f;
+					const char *next = parseFloat(skipBlanks(p, end), end, value);
+					aChunk.errors += next ? 0 : 1;
+					p = next ? next : end;
+					aPositions[axis][vertex] = value * aOptions.scale + aOptions.translation[axis];
+				}
+				++vertex;
+			}
+			else if (statement == 'f')
+			{
+				// the polygon is split into a fan around its first vertex
+				uint32_t first = 0;
+				uint32_t previous = 0;
+				uint32_t references = 0;
+				for (p = nextReference(p, end); p < end; p = nextReference(skipToken(p, end), end))
+				{
+					// only the position index counts, "v/vt/vn" and "v//vn" refer to the same vertex as "v" - negative
+					// indices count back from the last vertex defined before the face
+					int64_t value = 0;
+					int64_t index = parseInt(p, end, value) ? (value > 0 ? value - 1 : static_cast<int64_t>(vertex) + value) : -1;
+					bool valid = value != 0 && index >= 0 && index < static_cast<int64_t>(aVertexCount);
+					aChunk.errors += valid ? 0 : 1;
+					uint32_t current = valid ? static_cast<uint32_t>(index) : 0;
+
+					if (references == 0)
+					{
+						first = current;
+					}
+					else if (references >= 2)
+					{
+						aIndices[3 * triangle + 0] = first;
+						aIndices[3 * triangle + 1] = previous;
+						aIndices[3 * triangle + 2] = current;
+						aMaterials[triangle] = aOptions.material;
+						++triangle;
+					}
+					previous = current;
+					++references;
+				}
+			}
+			line = end < aChunk.end ? end + 1 : end;
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	// binary PLY
+
+	//! the scalar types of PLY properties
+	enum class PlyType : uint8_t
+	{
+		Int8,
+		UInt8,
+		Int16,
+		UInt16,
+		Int32,
+		UInt32,
+		Float32,
+		Float64,
+		Invalid
+	};
+
+	//! returns the type with the given name, under its old or its sized name
+	PlyType plyType(const std::string &aName)
+	{
+		static const char *kNames[][2] = {
+			{ "char", "int8" }, { "uchar", "uint8" }, { "short", "int16" }, { "ushort", "uint16" },
+			{ "int", "int32" }, { "uint", "uint32" }, { "float", "float32" }, { "double", "float64" }
+		};
+		for (uint8_t i = 0; i < static_cast<uint8_t>(PlyType::Invalid); ++i)
+		{
+			if (aName == kNames[i][0] || aName == kNames[i][1])
+			{
+				return static_cast<PlyType>(i);
+			}
+		}
+		return PlyType::Invalid;
+	}
+
+	inline size_t plySize(PlyType aType)
+	{
+		static const size_t kSizes[] = { 1, 1, 2, 2, 4, 4, 4, 8, 0 };
+		return kSizes[static_cast<size_t>(aType)];
+	}
+
+	//! reads a little-endian scalar of the given type - the hosts we run on are little-endian themselves
+	template<typename T>
+	inline T readScalar(const char *aData, PlyType aType)
+	{
+		switch (aType)
+		{
+		case PlyType::Int8: { int8_t v; std::memcpy(&v, aData, 1); return static_cast<T>(v); }
+		case PlyType::UInt8: { uint8_t v; std::memcpy(&v, aData, 1); return static_cast<T>(v); }
+		case PlyType::Int16: { int16_t v; std::memcpy(&v, aData, 2); return static_cast<T>(v); }
+		case PlyType::UInt16: { uint16_t v; std::memcpy(&v, aData, 2); return static_cast<T>(v); }
+		case PlyType::Int32: { int32_t v; std::memcpy(&v, aData, 4); return static_cast<T>(v); }
+		case PlyType::UInt32: { uint32_t v; std::memcpy(&v, aData, 4); return static_cast<T>(v); }
+		case PlyType::Float32: { float v; std::memcpy(&v, aData, 4); return static_cast<T>(v); }
+		case PlyType::Float64: { double v; std::memcpy(&v, aData, 8); return static_cast<T>(v); }
+		default: return T(0);
+		}
+	}
+
+	struct PlyProperty
+	{
+		std::string name;
+		PlyType type = PlyType::Invalid;		// of the value, or of the items of a list
+		PlyType countType = PlyType::Invalid;	// of the item count of a list, Invalid for scalar properties
+	};
+
+	struct PlyElement
+	{
+		std::string name;
+		uint64_t count = 0;
+		std::vector<PlyProperty> properties;
+		const char *data = nullptr;		// the first item, once the layout of the file is known
+
+		//! returns the size of every item, or 0 if the items hold lists and vary in size
+		size_t stride() const
+		{
+			size_t size = 0;
+			for (const auto &property : properties)
+			{
+				if (property.countType != PlyType::Invalid)
+				{
+					return 0;
+				}
+				size += plySize(property.type);
+			}
+			return size;
+		}
+
+		//! returns the byte offset of the scalar property with the given name within an item, or -1
+		int offset(const char *aName, PlyType &aType) const
+		{
+			size_t offset = 0;
+			for (const auto &property : properties)
+			{
+				if (property.name == aName && property.countType == PlyType::Invalid)
+				{
+					aType = property.type;
+					return static_cast<int>(offset);
+				}
+				offset += plySize(property.type);
+			}
+			return -1;
+		}
+
+		//! returns the position after the variable-sized item at aItem, or nullptr if it does not end before aEnd -
+		//! aIndices and aIndexCount are set to the list property aList
+		const char* skipItem(const char *aItem, const char *aEnd, int aList, const char *&aIndices, uint64_t &aIndexCount) const
+		{
+			const char *p = aItem;
+			for (size_t i = 0; i < properties.size(); ++i)
+			{
+				const PlyProperty &property = properties[i];
+				uint64_t count = 1;
+				if (property.countType != PlyType::Invalid)
+				{
+					if (static_cast<size_t>(aEnd - p) < plySize(property.countType))
+					{
+						return nullptr;
+					}
+					count = readScalar<uint64_t>(p, property.countType);
+					p += plySize(property.countType);
+				}
+				if (static_cast<int>(i) == aList)
+				{
+					aIndices = p;
+					aIndexCount = count;
+				}
+				if (static_cast<uint64_t>(aEnd - p) / plySize(property.type) < count)
+				{
+					return nullptr;
+				}
+				p += count * plySize(property.type);
+			}
+			return p;
+		}
+	};
+
+	//! a range of faces of a PLY file, with where it starts in the file and where its triangles go
+	struct PlyFaceChunk
+	{
+		const char *data;
+		uint64_t firstFace;
+		uint64_t firstTriangle;
+		uint64_t errors = 0;
+	};
+
+	//! parses the header of a PLY file into its elements and returns true if it describes a binary little-endian file -
+	//! aHeaderSize is set to the offset of the data that follows
+	bool parsePLYHeader(const char *aData, size_t aSize, std::vector<PlyElement> &aElements, size_t &aHeaderSize)
+	{
+		const char *end = aData + aSize;
+		bool little = false;
+		for (const char *line = aData; line < end; )
+		{
+			const char *next = lineEnd(line, end);
+			std::istringstream stream(std::string(line, next));
+			std::string keyword;
+			stream >> keyword;
+			if (line == aData && keyword != "ply")
+			{
+				std::cerr << "Not a PLY file" << std::endl;
+				return false;
+			}
+			else if (keyword == "format")
+			{
+				std::string format;
+				stream >> format;
+				little = format == "binary_little_endian";
+				if (!little)
+				{
+					std::cerr << "Unsupported PLY format " << format << ", only binary_little_endian can be loaded" << std::endl;
+					return false;
+				}
+			}
+			else if (keyword == "element")
+			{
+				aElements.emplace_back();
+				stream >> aElements.back().name >> aElements.back().count;
+			}
+			else if (keyword == "property" && !aElements.empty())
+			{
+				PlyProperty property;
+				std::string type;
+				stream >> type;
+				if (type == "list")
+				{
+					std::string countType;
+					stream >> countType >> type;
+					property.countType = plyType(countType);
+					if (property.countType == PlyType::Invalid)
+					{
+						std::cerr << "Unknown PLY type " << countType << std::endl;
+						return false;
+					}
+				}
+				property.type = plyType(type);
+				stream >> property.name;
+				if (property.type == PlyType::Invalid)
+				{
+					std::cerr << "Unknown PLY type " << type << std::endl;
+					return false;
+				}
+				aElements.back().properties.push_back(property);
+			}
+			else if (keyword == "end_header")
+			{
+				if (!little)
+				{
+					std::cerr << "PLY header without a format" << std::endl;
+					return false;
+				}
+				aHeaderSize = (next < end ? next + 1 : end) - aData;
+				return true;
+			}
+			line = next < end ? next + 1 : end;
+		}
+		std::cerr << "PLY header without end_header" << std::endl;
+		return false;
+	}
+}
+
+//----------------------------------------------------------------------------------
+// mesh loader
+MeshLoader::MeshLoader(const MeshLoadOptions &aOptions) :
+	mOptions(aOptions),
+	mPool(ThreadPool::shared(aOptions.threadCount))
+{
+}
+
+MeshLoaderRef MeshLoader::create(const MeshLoadOptions &aOptions)
+{
+	return MeshLoaderRef(new MeshLoader(aOptions));
+}
+
+MeshFormat MeshLoader::formatFromPath(const std::string &aPath)
+{
+	size_t dot = aPath.find_last_of('.');
+	if (dot == std::string::npos)
+	{
+		return MeshFormat::Auto;
+	}
+
+	std::string extension = aPath.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	if (extension == "obj")
+	{
+		return MeshFormat::OBJ;
+	}
+	if (extension == "ply")
+	{
+		return MeshFormat::PLY;
+	}
+	return MeshFormat::Auto;
+}
+
+bool MeshLoader::load(const std::string &aPath, TriangleMesh &aMesh)
+{
+	auto start = std::chrono::steady_clock::now();
+	mPath = aPath;
+	mBytes = 0;
+	mSeconds = 0.0;
+	mVertexCount = 0;
+	mTriangleCount = 0;
+
+	MeshFormat format = mOptions.format == MeshFormat::Auto ? formatFromPath(aPath) : mOptions.format;
+	if (format == MeshFormat::Auto)
+	{
+		std::cerr << "Unknown mesh format of " << aPath << std::endl;
+		return false;
+	}
+
+	MappedFile file;
+	if (!file.open(aPath))
+	{
+		return false;
+	}
+
+	bool loaded = format == MeshFormat::OBJ ? loadOBJ(file.data(), file.size(), aMesh) : loadPLY(file.data(), file.size(), aMesh);
+	if (!loaded)
+	{
+		std::cerr << "Failed to load " << aPath << std::endl;
+		aMesh.resize(0, 0, false);
+		return false;
+	}
+	mBytes = file.size();
+	mSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	mVertexCount = aMesh.vertexCount();
+	mTriangleCount = aMesh.triangleCount();
+	return true;
+}
+
+bool MeshLoader::loadOBJ(const char *aData, size_t aSize, TriangleMesh &aMesh)
+{
+	// chunks of about kChunkSize bytes, each extended to the end of the line it would otherwise split
+	size_t chunkCount = std::max<size_t>(1, aSize / kChunkSize);
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char *end = aData + aSize;
+	const char *begin = aData;
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		const char *split = i + 1 == chunkCount ? end : std::max(begin, aData + (i + 1) * (aSize / chunkCount));
+		split = split < end ? lineEnd(split, end) : end;
+		chunks[i].begin = begin;
+		chunks[i].end = split < end ? split + 1 : end;
+		begin = chunks[i].end;
+	}
+
+	mPool->dispatch(chunks.size(), [&](size_t aTaskIndex, size_t)
+	{
+		countOBJ(chunks[aTaskIndex]);
+	});
+
+	// every chunk writes behind the vertices and triangles of all chunks before it
+	uint64_t vertexCount = 0;
+	uint64_t triangleCount = 0;
+	for (auto &chunk : chunks)
+	{
+		chunk.firstVertex = vertexCount;
+		chunk.firstTriangle = triangleCount;
+		vertexCount += chunk.vertexCount;
+		triangleCount += chunk.triangleCount;
+	}
+	if (vertexCount > std::numeric_limits<uint32_t>::max())
+	{
+		std::cerr << "Too many vertices (" << vertexCount << ") for 32-bit indices" << std::endl;
+		return false;
+	}
+
+	aMesh.resize(vertexCount, triangleCount, false);
+	float *positions[3] = { aMesh.positions(0), aMesh.positions(1), aMesh.positions(2) };
+	uint32_t *indices = aMesh.indices();
+	uint32_t *materials = aMesh.materialIds();
+	mPool->dispatch(chunks.size(), [&](size_t aTaskIndex, size_t)
+	{
+		parseOBJ(chunks[aTaskIndex], mOptions, vertexCount, positions, indices, materials);
+	});
+
+	uint64_t errors = 0;
+	for (const auto &chunk : chunks)
+	{
+		errors += chunk.errors;
+	}
+	if (errors > 0)
+	{
+		std::cerr << errors << " invalid numbers or vertex indices in OBJ file" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool MeshLoader::loadPLY(const char *aData, size_t aSize, TriangleMesh &aMesh)
+{
+	std::vector<PlyElement> elements;
+	size_t headerSize = 0;
+	if (!parsePLYHeader(aData, aSize, elements, headerSize))
+	{
+		return false;
+	}
+
+	// find where every element starts - the faces have to be walked one by one, as their size varies, so their ranges
+	// and the first triangle of every range are noted on the way, and so is every other variable-sized element skipped
+	const char *end = aData + aSize;
+	const char *p = aData + headerSize;
+	const PlyElement *vertices = nullptr;
+	const PlyElement *faces = nullptr;
+	int faceList = -1;
+	std::vector<PlyFaceChunk> faceChunks;
+	uint64_t triangleCount = 0;
+	for (auto &element : elements)
+	{
+		element.data = p;
+		int list = -1;
+		for (size_t i = 0; i < element.properties.size(); ++i)
+		{
+			const PlyProperty &property = element.properties[i];
+			list = (property.countType != PlyType::Invalid && (property.name == "vertex_indices" || property.name == "vertex_index")) ? static_cast<int>(i) : list;
+		}
+		bool isFaces = element.name == "face" && list >= 0 && !faces;
+		if (isFaces)
+		{
+			faces = &element;
+			faceList = list;
+		}
+		else if (element.name == "vertex" && !vertices)
+		{
+			vertices = &element;
+		}
+
+		size_t stride = element.stride();
+		if (stride > 0)
+		{
+			if (static_cast<uint64_t>(end - p) / stride < element.count)
+			{
+				std::cerr << "PLY file ends within element " << element.name << std::endl;
+				return false;
+			}
+			p += element.count * stride;
+			continue;
+		}
+
+		for (uint64_t item = 0; item < element.count; ++item)
+		{
+			if (isFaces && item % kItemsPerChunk == 0)
+			{
+				faceChunks.push_back({ p, item, triangleCount });
+			}
+			const char *indices = nullptr;
+			uint64_t indexCount = 0;
+			p = element.skipItem(p, end, list, indices, indexCount);
+			if (!p)
+			{
+				std::cerr << "PLY file ends within element " << element.name << std::endl;
+				return false;
+			}
+			triangleCount += (isFaces && indexCount >= 3) ? indexCount - 2 : 0;
+		}
+	}
+
+	PlyType types[3];
+	int offsets[3] = { -1, -1, -1 };
+	PlyType normalTypes[3];
+	int normalOffsets[3] = { -1, -1, -1 };
+	for (int axis = 0; axis < 3 && vertices; ++axis)
+	{
+		const char *names[] = { "x", "y", "z" };
+		const char *normalNames[] = { "nx", "ny", "nz" };
+		offsets[axis] = vertices->offset(names[axis], types[axis]);
+		normalOffsets[axis] = vertices->offset(normalNames[axis], normalTypes[axis]);
+	}
+	if (!vertices || vertices->stride() == 0 || offsets[0] < 0 || offsets[1] < 0 || offsets[2] < 0)
+	{
+		std::cerr << "PLY file without vertex positions" << std::endl;
+		return false;
+	}
+	if (vertices->count > std::numeric_limits<uint32_t>::max())
+	{
+		std::cerr << "Too many vertices (" << vertices->count << ") for 32-bit indices" << std::endl;
+		return false;
+	}
+
+	bool normals = normalOffsets[0] >= 0 && normalOffsets[1] >= 0 && normalOffsets[2] >= 0;
+	uint64_t vertexCount = vertices->count;
+	aMesh.resize(vertexCount, triangleCount, normals);
+	float *positions[3] = { aMesh.positions(0), aMesh.positions(1), aMesh.positions(2) };
+	float *normalData[3] = { aMesh.normals(0), aMesh.normals(1), aMesh.normals(2) };
+	uint32_t *indices = aMesh.indices();
+	uint32_t *materials = aMesh.materialIds();
+
+	// the vertex ranges come first, then the face ranges
+	size_t stride = vertices->stride();
+	size_t vertexChunks = static_cast<size_t>((vertexCount + kItemsPerChunk - 1) / kItemsPerChunk);
+	mPool->dispatch(vertexChunks + faceChunks.size(), [&](size_t aTaskIndex, size_t)
+	{
+		if (aTaskIndex < vertexChunks)
+		{
+			uint64_t first = aTaskIndex * kItemsPerChunk;
+			uint64_t last = std::min(first + kItemsPerChunk, vertexCount);
+			for (uint64_t v = first; v < last; ++v)
+			{
+				const char *item = vertices->data + v * stride;
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					positions[axis][v] = readScalar<float>(item + offsets[axis], types[axis]) * mOptions.scale + mOptions.translation[axis];
+					if (normals)
+					{
+						normalData[axis][v] = readScalar<float>(item + normalOffsets[axis], normalTypes[axis]);
+					}
+				}
+			}
+			return;
+		}
+
+		PlyFaceChunk &chunk = faceChunks[aTaskIndex - vertexChunks];
+		uint64_t last = std::min(chunk.firstFace + kItemsPerChunk, faces->count);
+		uint64_t triangle = chunk.firstTriangle;
+		PlyType indexType = faces->properties[faceList].type;
+		size_t indexSize = plySize(indexType);
+		const char *item = chunk.data;
+		for (uint64_t f = chunk.firstFace; f < last; ++f)
+		{
+			// every face was checked to lie within the file while its range was found
+			const char *list = nullptr;
+			uint64_t count = 0;
+			item = faces->skipItem(item, end, faceList, list, count);
+
+			// the polygon is split into a fan around its first vertex
+			uint32_t first = 0;
+			uint32_t previous = 0;
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				int64_t index = readScalar<int64_t>(list + i * indexSize, indexType);
+				bool valid = index >= 0 && static_cast<uint64_t>(index) < vertexCount;
+				chunk.errors += valid ? 0 : 1;
+				uint32_t current = valid ? static_cast<uint32_t>(index) : 0;
+				if (i == 0)
+				{
+					first = current;
+				}
+				else if (i >= 2)
+				{
+					indices[3 * triangle + 0] = first;
+					indices[3 * triangle + 1] = previous;
+					indices[3 * triangle + 2] = current;
+					materials[triangle] = mOptions.material;
+					++triangle;
+				}
+				previous = current;
+			}
+		}
+	});
+
+	uint64_t errors = 0;
+	for (const auto &chunk : faceChunks)
+	{
+		errors += chunk.errors;
+	}
+	if (errors > 0)
+	{
+		std::cerr << errors << " invalid vertex indices in PLY file" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void MeshLoader::printStats(std::ostream &aStream) const
+{
+	std::streamsize precision = aStream.precision();
+	double megabytes = mBytes / (1024.0 * 1024.0);
+	aStream << "loaded " << mPath << ": " << mVertexCount << " vertices, " << mTriangleCount << " triangles, " << std::fixed
+			<< std::setprecision(1) << megabytes << " MB in " << std::setprecision(3) << mSeconds << "s ("
+			<< std::setprecision(1) << (mSeconds > 0.0 ? megabytes / mSeconds : 0.0) << " MB/s on " << mPool->threadCount() << " threads)" << std::endl;
+	aStream << std::defaultfloat << std::setprecision(precision);
+}
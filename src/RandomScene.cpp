@@ -0,0 +1,91 @@
+#include "../include/RandomScene.h"
+#include "../include/SphereSet.h"
+
+#include <algorithm>
+#include <iostream>
+
+SceneRef randomScene(const SceneOptions &aOptions, const BVHBuildOptions &aBuildOptions)
+{
+	std::default_random_engine engine(aOptions.seed);
+	std::uniform_real_distribution<float> distribution;
+	auto randFloat = [&]() { return distribution(engine); };
+
+	SceneRef scene = Scene::create();
+	uint32_t groundMat = scene->addMaterial(std::make_shared<Lambertian>(glm::vec3(0.5f)));
+	scene->addSphere(glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, groundMat);
+
+	uint32_t mat1 = scene->addMaterial(std::make_shared<Dieletric>(1.5));
+	scene->addSphere(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, mat1);
+
+	uint32_t mat2 = scene->addMaterial(std::make_shared<Lambertian>(glm::vec3(0.4f, 0.2f, 0.1)));
+	scene->addSphere(glm::vec3(-4.0f, 1.0f, 0.0f), 1.0f, mat2);
+
+	uint32_t mat3 = scene->addMaterial(std::make_shared<Metallic>(glm::vec3(0.7f, 0.6f, 0.5f), 0.0f));
+	scene->addSphere(glm::vec3(4.0f, 1.0f, 0.0f), 1.0f, mat3);
+
+	// the small spheres share a palette of materials and are stored in structure-of-arrays form, either by the scene
+	// itself or by a sphere set, so even hundreds of thousands of them cost a handful of allocations
+	if (aOptions.sphereCount > 0)
+	{
+		SphereSetRef smallSpheres = SphereSet::create();
+		const uint32_t paletteSize = 16;
+		uint32_t paletteStart = 0;
+		for (uint32_t i = 0; i < paletteSize; ++i)
+		{
+			glm::vec3 albedo{ randFloat(), randFloat(), randFloat() };
+			MaterialRef material;
+			if (i % 4 == 0)
+			{
+				material = std::make_shared<Metallic>(0.5f * (albedo + 1.0f), 0.5f * randFloat());
+			}
+			else if (i % 4 == 1)
+			{
+				material = std::make_shared<Dieletric>(1.5f);
+			}
+			else
+			{
+				material = std::make_shared<Lambertian>(albedo * albedo);
+			}
+
+			// the palette occupies consecutive entries of the scene's material table
+			uint32_t id = scene->addMaterial(material);
+			paletteStart = i == 0 ? id : paletteStart;
+		}
+
+		// scatter the spheres over a square that grows with their number
+		float extent = std::max(11.0f, 0.5f * sqrtf(static_cast<float>(aOptions.sphereCount)));
+		if (aOptions.sphereSet)
+		{
+			smallSpheres->reserve(aOptions.sphereCount);
+		}
+		for (uint32_t i = 0; i < aOptions.sphereCount; ++i)
+		{
+			float x = (2.0f * randFloat() - 1.0f) * extent;
+			float z = (2.0f * randFloat() - 1.0f) * extent;
+			uint32_t material = paletteStart + static_cast<uint32_t>(randFloat() * paletteSize) % paletteSize;
+			if (aOptions.motionBlur && (material - paletteStart) % 4 >= 2)
+			{
+				// diffuse spheres move, so they always go into the scene itself
+				glm::vec3 center{ x, 0.2f, z };
+				scene->addMovingSphere(center, center + glm::vec3(0.0f, 0.5f * randFloat(), 0.0f), 0.0f, 1.0f, 0.2f, material);
+			}
+			else if (aOptions.sphereSet)
+			{
+				smallSpheres->push_back(glm::vec3(x, 0.2f, z), 0.2f, material);
+			}
+			else
+			{
+				scene->addSphere(glm::vec3(x, 0.2f, z), 0.2f, material);
+			}
+		}
+
+		if (aOptions.sphereSet)
+		{
+			smallSpheres->build(aBuildOptions);
+			smallSpheres->bvh().printStats(std::clog);
+			scene->add(smallSpheres);
+		}
+	}
+
+	return scene;
+}
@@ -1,138 +1,589 @@
-#include "../include/Hitable.h"
+#include "../include/AccumulationBuffer.h"
+#include "../include/ImageWriter.h"
+#include "../include/InstanceSet.h"
+#include "../include/Integrator.h"
+#include "../include/Material.h"
+#include "../include/MeshLoader.h"
+#include "../include/RandomScene.h"
+#include "../include/Scene.h"
+#include "../include/SceneCache.h"
 #include "../include/Ray.h"
 #include "../include/Camera.h"
+#include "../include/Renderer.h"
+#include "../include/Stats.h"
+#include "../include/WavefrontIntegrator.h"
+#include "../include/glm/gtc/matrix_transform.hpp"
 
-#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <iostream>
+#include <string>
 #include <limits>
+#include <random>
+
+//! returns the seconds elapsed since the given time
+double secondsSince(std::chrono::steady_clock::time_point aStart)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - aStart).count();
+}
 
-//! returns a color based on the result of intersecting the given ray with the given list of hitable objects
-glm::vec3 color(const Ray &aRay, const HitableList &aList, uint32_t depth)
+//! settings for adaptive sampling, which stops sampling pixels once the estimated error of their mean is small enough
+struct AdaptiveOptions
 {
-	HitRecord record;
-	const float delta = 0.001f;
-	const uint32_t maxDepth = 50;
+	bool enabled = false;
+	uint32_t minSamples = 32;		// samples every pixel takes before its error is trusted - fewer let rare bright paths go unseen
+	float threshold = 0.02f;		// relative standard error of the mean luminance at which a pixel stops
+	float luminanceFloor = 0.1f;	// errors of darker pixels are measured relative to this luminance
+	std::string sampleMapPath;		// if set, the sample count of every pixel is written here, 1.0 meaning --samples
+};
+
+//! everything that can be set from the command line
+struct Options
+{
+	RenderOptions render;
+	SceneOptions scene;
+	IntegratorOptions integrator;
+	ImageOptions image;
+	AdaptiveOptions adaptive;
+	MeshLoadOptions mesh;
+	std::string meshPath;		// if set, this OBJ or PLY mesh is added to the scene
+	uint32_t meshInstances = 0;	// if nonzero, the mesh is added this many times, as instances scattered over the ground
+	std::string outputPath = "test.ppm";
+	std::string statsPath;		// if set, the statistics of the run are written here as JSON
+	std::string sceneCachePath;	// if set, the built scene is loaded from here, or written here if there is no valid cache
+	uint32_t width = 200;
+	uint32_t height = 100;
+	uint32_t samples = 1;		// samples per pixel
+	uint32_t packetSize = 16;	// camera rays traced together: 1 (no packets), 4, 8 or 16
+	bool wavefront = false;		// trace each tile's paths in batches, one bounce at a time
+	bool progressive = false;	// render one sample per pixel per pass, resolving the image after every pass
+	double timeBudget = 0.0;	// seconds the whole run may take in progressive mode, 0 for no limit
+	double checkpointInterval = 0.0;	// seconds between intermediate images in progressive mode, 0 for none
+};
+
+//! renders samples [aFirstSample, aFirstSample + aSamples) of a tile in small blocks of pixels, tracing the camera rays of
+//! each block for one sample as a packet of N rays - if aActive is given, only the pixels with a nonzero entry are rendered
+template<int N>
+void renderPackets(const Tile &aTile, Framebuffer &aFramebuffer, const Camera &aCamera, const Scene &aScene, const Integrator &aIntegrator, uint32_t aFirstSample, uint32_t aSamples, uint32_t &aRayCount, const uint8_t *aActive)
+{
+	// 2x2, 4x2 or 4x4 pixels
+	const uint32_t blockWidth = N == 4 ? 2 : 4;
+	const uint32_t blockHeight = N / blockWidth;
+	const uint32_t width = aFramebuffer.width();
+	const uint32_t height = aFramebuffer.height();
+
+	for (uint32_t y0 = aTile.y0; y0 < aTile.y1; y0 += blockHeight)
+	{
+		for (uint32_t x0 = aTile.x0; x0 < aTile.x1; x0 += blockWidth)
+		{
+			glm::vec3 accumColor[N];
+			std::fill(accumColor, accumColor + N, glm::vec3(0.0f));
+			for (uint32_t samp = aFirstSample; samp < aFirstSample + aSamples; ++samp)
+			{
+				// lanes that fall outside the tile stay inactive
+				RayPacket<N> packet;
+				Sampler samplers[N];
+				for (int lane = 0; lane < N; ++lane)
+				{
+					uint32_t i = x0 + lane % blockWidth;
+					uint32_t j = y0 + lane / blockWidth;
+					if (i >= aTile.x1 || j >= aTile.y1 || (aActive && !aActive[j * width + i]))
+					{
+						packet.clear(lane);
+						continue;
+					}
+
+					// the same sampler, jitter and camera ray as when the pixel is rendered on its own
+					samplers[lane] = Sampler{ j * width + i, samp };
+					glm::vec2 jitter = samplers[lane].next2D();
+					float u = float(i + jitter.x) / float(width);
+					float v = float(j + jitter.y) / float(height);
+					packet.set(lane, aCamera.generateRay(u, v, samplers[lane]));
+				}
+
+				if (packet.activeMask == 0)
+				{
+					continue;
+				}
+
+				glm::vec3 radiance[N];
+				aIntegrator.radiance(packet, aScene, samplers, radiance, aRayCount);
+				for (uint32_t mask = packet.activeMask; mask; mask &= mask - 1)
+				{
+					uint32_t lane = firstBit(mask);
+					accumColor[lane] += radiance[lane];
+				}
+			}
+
+			for (int lane = 0; lane < N; ++lane)
+			{
+				uint32_t i = x0 + lane % blockWidth;
+				uint32_t j = y0 + lane / blockWidth;
+				if (i < aTile.x1 && j < aTile.y1)
+				{
+					aFramebuffer.set(i, j, accumColor[lane] / float(aSamples));
+				}
+			}
+		}
+	}
+}
 
-	// did we hit anything?
-	if (aList.hit(aRay, delta, std::numeric_limits<float>::max(), record))
+//! parses "--threads N", "--tile N", "--spheres N", "--seed N", "--sphere-set 0|1", "--motion-blur 0|1", "--roulette N", the path depth limits "--max-depth N",
+//! "--max-diffuse N", "--max-specular N" and "--max-transmission N", the output settings "--output PATH",
+//! "--format ppm|pfm|exr" and "--gamma G", "--width N", "--height N", "--samples N", "--packet N", and the wavefront
+//! integrator "--wavefront 0|1" with its batch size "--wavefront-size N" and secondary ray order "--ray-sort none|octant|morton",
+//! progressive rendering "--progressive 0|1" with "--time-budget SECONDS" and "--checkpoint SECONDS", and adaptive
+//! sampling "--adaptive 0|1" with "--min-samples N", "--error E", "--luminance-floor L" and "--sample-map PATH",
+//! "--stats PATH" for the statistics as JSON, "--mesh PATH" with "--mesh-scale S" and "--mesh-instances N" for a mesh to
+//! add to the scene, and "--scene-cache PATH" for the scene cache
+Options parseOptions(int argc, char **argv)
+{
+	Options options;
+	for (int i = 1; i + 1 < argc; i += 2)
 	{
-		Ray scattered;
-		glm::vec3 attenuation;
-		
-		// calculate the scattered ray based on the material properties at the hit location
-		if (depth < maxDepth && record.material->scatter(aRay, record, attenuation, scattered))
+		const char *argument = argv[i + 1];
+		uint32_t value = static_cast<uint32_t>(std::strtoul(argument, nullptr, 10));
+		if (std::strcmp(argv[i], "--threads") == 0)
+		{
+			options.render.threadCount = value;
+		}
+		else if (std::strcmp(argv[i], "--tile") == 0)
+		{
+			options.render.tileSize = value;
+		}
+		else if (std::strcmp(argv[i], "--spheres") == 0)
+		{
+			options.scene.sphereCount = value;
+		}
+		else if (std::strcmp(argv[i], "--seed") == 0)
+		{
+			options.scene.seed = value;
+		}
+		else if (std::strcmp(argv[i], "--sphere-set") == 0)
+		{
+			options.scene.sphereSet = value != 0;
+		}
+		else if (std::strcmp(argv[i], "--motion-blur") == 0)
+		{
+			options.scene.motionBlur = value != 0;
+		}
+		else if (std::strcmp(argv[i], "--roulette") == 0)
+		{
+			options.integrator.rouletteDepth = value;
+		}
+		else if (std::strcmp(argv[i], "--max-depth") == 0)
+		{
+			options.integrator.maxDepth = value;
+		}
+		else if (std::strcmp(argv[i], "--max-diffuse") == 0)
+		{
+			options.integrator.maxDiffuseDepth = value;
+		}
+		else if (std::strcmp(argv[i], "--max-specular") == 0)
+		{
+			options.integrator.maxSpecularDepth = value;
+		}
+		else if (std::strcmp(argv[i], "--max-transmission") == 0)
+		{
+			options.integrator.maxTransmissionDepth = value;
+		}
+		else if (std::strcmp(argv[i], "--output") == 0)
+		{
+			options.outputPath = argument;
+		}
+		else if (std::strcmp(argv[i], "--format") == 0)
+		{
+			options.image.format = ImageWriter::formatFromPath(std::string(".") + argument);
+		}
+		else if (std::strcmp(argv[i], "--gamma") == 0)
+		{
+			options.image.gamma = std::strtof(argument, nullptr);
+		}
+		else if (std::strcmp(argv[i], "--width") == 0)
+		{
+			options.width = std::max<uint32_t>(1, value);
+		}
+		else if (std::strcmp(argv[i], "--height") == 0)
+		{
+			options.height = std::max<uint32_t>(1, value);
+		}
+		else if (std::strcmp(argv[i], "--samples") == 0)
+		{
+			options.samples = std::max<uint32_t>(1, value);
+		}
+		else if (std::strcmp(argv[i], "--packet") == 0)
+		{
+			options.packetSize = value;
+		}
+		else if (std::strcmp(argv[i], "--wavefront") == 0)
+		{
+			options.wavefront = value != 0;
+		}
+		else if (std::strcmp(argv[i], "--wavefront-size") == 0)
+		{
+			options.integrator.wavefrontSize = value;
+		}
+		else if (std::strcmp(argv[i], "--progressive") == 0)
+		{
+			options.progressive = value != 0;
+		}
+		else if (std::strcmp(argv[i], "--time-budget") == 0)
+		{
+			options.timeBudget = std::strtod(argument, nullptr);
+		}
+		else if (std::strcmp(argv[i], "--checkpoint") == 0)
+		{
+			options.checkpointInterval = std::strtod(argument, nullptr);
+		}
+		else if (std::strcmp(argv[i], "--adaptive") == 0)
+		{
+			options.adaptive.enabled = value != 0;
+		}
+		else if (std::strcmp(argv[i], "--min-samples") == 0)
+		{
+			options.adaptive.minSamples = std::max<uint32_t>(2, value);
+		}
+		else if (std::strcmp(argv[i], "--error") == 0)
+		{
+			options.adaptive.threshold = std::strtof(argument, nullptr);
+		}
+		else if (std::strcmp(argv[i], "--luminance-floor") == 0)
+		{
+			options.adaptive.luminanceFloor = std::strtof(argument, nullptr);
+		}
+		else if (std::strcmp(argv[i], "--sample-map") == 0)
+		{
+			options.adaptive.sampleMapPath = argument;
+		}
+		else if (std::strcmp(argv[i], "--stats") == 0)
 		{
-			return attenuation * color(scattered, aList, ++depth);
+			options.statsPath = argument;
+		}
+		else if (std::strcmp(argv[i], "--scene-cache") == 0)
+		{
+			options.sceneCachePath = argument;
+		}
+		else if (std::strcmp(argv[i], "--mesh") == 0)
+		{
+			options.meshPath = argument;
+		}
+		else if (std::strcmp(argv[i], "--mesh-scale") == 0)
+		{
+			options.mesh.scale = std::strtof(argument, nullptr);
+		}
+		else if (std::strcmp(argv[i], "--mesh-instances") == 0)
+		{
+			options.meshInstances = value;
+		}
+		else if (std::strcmp(argv[i], "--ray-sort") == 0)
+		{
+			if (std::strcmp(argument, "octant") == 0)
+			{
+				options.integrator.raySort = RaySortMode::Octant;
+			}
+			else if (std::strcmp(argument, "morton") == 0)
+			{
+				options.integrator.raySort = RaySortMode::Morton;
+			}
+			else
+			{
+				options.integrator.raySort = RaySortMode::None;
+			}
 		}
 		else
 		{
-			return glm::vec3(0.0f);
+			std::cerr << "Unknown option " << argv[i] << std::endl;
 		}
 	}
-	else 
-	{
-		glm::vec3 unitDirection = glm::normalize(aRay.direction());
-
-		// remap the y-coord of the ray direction to 0...1
-		float t = 0.5f * (unitDirection.y + 1.0f);
-		const glm::vec3 white{ 1.0f };
-		const glm::vec3 sky{ 0.5f, 0.7f, 1.0f };
-		return lerp(white, sky, t);
-	}
+	return options;
 }
 
-HitableListRef randomScene()
+//! returns the key that tells the scene caches of different scenes apart - a hash of every setting that changes the
+//! generated scene or its BVH, except for the thread count, as a tree built on any number of threads is equally valid
+uint64_t sceneCacheKey(const SceneOptions &aScene, const BVHBuildOptions &aBuild)
 {
-	const size_t n = 500;
-	HitableListRef scene = HitableList::create();
-	//scene->list().resize(3);
-
-	//scene.list().resize(500);
-
-	//MaterialRef groundMat = std::make_shared<Lambertian>(glm::vec3(0.5f));
-	//scene.list()[0] = std::make_shared<Sphere>(glm::vec3(0.0f, -1000.f, 0.0f), 1000.0f, groundMat);
-
-	auto groundMat = std::make_shared<Lambertian>(glm::vec3(0.5f));
-	scene->push_back(Sphere::create(glm::vec3(0.0f, -1000.0f, 0.0f), 1000.0f, groundMat));
-
-	auto mat1 = std::make_shared<Dieletric>(1.5);
-	scene->push_back(Sphere::create(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, mat1));
-
-	auto mat2 = std::make_shared<Lambertian>(glm::vec3(0.4f, 0.2f, 0.1));
-	scene->push_back(Sphere::create(glm::vec3(-4.0f, 1.0f, 0.0f), 1.0f, mat2));
-
-	auto mat3 = std::make_shared<Metallic>(glm::vec3(0.7f, 0.6f, 0.5f), 0.0f);
-	scene->push_back(Sphere::create(glm::vec3(4.0f, 1.0f, 0.0f), 1.0f, mat3));
+	uint64_t key = SceneCacheReader::hash(aScene.sphereCount);
+	key = SceneCacheReader::hash(aScene.sphereSet, key);
+	key = SceneCacheReader::hash(aScene.motionBlur, key);
+	key = SceneCacheReader::hash(aScene.seed, key);
+	key = SceneCacheReader::hash(aBuild.splitMethod, key);
+	key = SceneCacheReader::hash(aBuild.binCount, key);
+	key = SceneCacheReader::hash(aBuild.maxLeafSize, key);
+	key = SceneCacheReader::hash(aBuild.traversalCost, key);
+	key = SceneCacheReader::hash(aBuild.intersectionCost, key);
+	key = SceneCacheReader::hash(aBuild.width, key);
+	return SceneCacheReader::hash(aBuild.parallelThreshold, key);
+}
 
-	//for (size_t i = 0; i < 20; ++i)
-	//{
-	//	auto randMat = std::make_shared<Lambertian>(glm::vec3(randFloat(), randFloat(), randFloat()));
-	//	float x = (randFloat() - 0.5f) * 10.0f;
-	//	float z = (randFloat() - 0.5f) * 10.0f;
-	//	glm::vec3 randCenter{x, 0.2f, z};
-	//	scene->push_back(MovingSphere::create(randCenter, randCenter + glm::vec3(0.0f, 0.5f, 0.0f), 0.0f, 1.0f, 0.2f, randMat));
-	//}
+//! returns an instance set with aCount copies of a built mesh, scattered over the ground like the small random spheres,
+//! each scaled to about their size and turned about the vertical at random - the mesh itself is stored only once
+InstanceSetRef scatterInstances(const TriangleMeshRef &aMesh, uint32_t aCount, uint32_t aSeed, const BVHBuildOptions &aBuildOptions)
+{
+	AABB box;
+	aMesh->boundingBox(0.0f, 0.0f, box);
+	glm::vec3 extent = box.extent();
+	float scale = 0.4f / std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f));
 
-	return scene;
+	std::default_random_engine engine(aSeed);
+	std::uniform_real_distribution<float> uniform;
+	InstanceSetRef instances = InstanceSet::create();
+	uint32_t geometry = instances->addGeometry(aMesh);
+	for (uint32_t i = 0; i < aCount; ++i)
+	{
+		// the mesh is centered, scaled and turned, then set down on the ground
+		glm::vec3 position{ -11.0f + 22.0f * uniform(engine), 0.5f * scale * extent.y, -11.0f + 22.0f * uniform(engine) };
+		float angle = 6.2831853f * uniform(engine);
+		glm::mat4 transform = glm::translate(glm::mat4(1.0f), position);
+		transform = glm::rotate(transform, angle, glm::vec3(0.0f, 1.0f, 0.0f));
+		transform = glm::scale(transform, glm::vec3(scale));
+		transform = glm::translate(transform, -box.centroid());
+		instances->addInstance(geometry, transform);
+	}
+	instances->build(aBuildOptions);
+	return instances;
 }
 
-int main()
+int main(int argc, char **argv)
 {
-	// output a dummy ppm image file:
-	// P3 means the colors are in ASCII
-	// 3 columns and 2 rows
-	// 255 is the max color
-	const uint32_t width = 200;
-	const uint32_t height = 100;
-	const uint32_t ns = 1;
-	const uint32_t maxColor = 255;
-	const float gamma = 2.2f;
-
-	std::ofstream outFile("test.ppm");
-	outFile << "P3\n" << width << " " << height << "\n" << maxColor << "\n";
-
-	// scene
+	auto start = std::chrono::steady_clock::now();
+	Options options = parseOptions(argc, argv);
+	const uint32_t width = options.width;
+	const uint32_t height = options.height;
+	const uint32_t ns = options.samples;
+
+	// scene, built for the camera's shutter interval so that moving spheres are bounded at the time of every ray
 	const float r = 0.5f; 
-	HitableListRef scene = randomScene();
-	BVHNodeRef sceneHierarchy = BVHNode::create(scene, 0.0f, 0.0f);
+	const float shutterOpen = 0.0f;
+	const float shutterClose = 1.0f;
+	// the loader, every build and the renderer are given the same thread count, so that they all run on one shared pool
+	BVHBuildOptions buildOptions;
+	buildOptions.threadCount = options.render.threadCount;
+	StatsReport report;
+	SceneRef scene;
+	double loadSeconds = 0.0;
+	const uint64_t cacheKey = sceneCacheKey(options.scene, buildOptions);
+	if (!options.sceneCachePath.empty() && options.meshPath.empty())
+	{
+		// a cache of the same scene replaces generating and building it - its arrays are traversed in the mapped file
+		scene = Scene::loadCache(options.sceneCachePath, cacheKey);
+		loadSeconds = scene ? secondsSince(start) : 0.0;
+	}
+	if (!scene)
+	{
+		scene = randomScene(options.scene, buildOptions);
+	}
+	if (!options.meshPath.empty())
+	{
+		// the mesh keeps its own BVH, which becomes a single primitive of the scene's
+		MeshLoadOptions meshOptions = options.mesh;
+		meshOptions.threadCount = options.render.threadCount;
+		meshOptions.material = scene->addMaterial(std::make_shared<Lambertian>(glm::vec3(0.7f)));
+		MeshLoader loader{ meshOptions };
+		TriangleMeshRef mesh = TriangleMesh::create();
+		if (!loader.load(options.meshPath, *mesh))
+		{
+			return 1;
+		}
+		loader.printStats(std::cout);
+		loadSeconds = loader.loadSeconds();
+		mesh->build(buildOptions);
+		if (options.meshInstances > 0)
+		{
+			scene->add(scatterInstances(mesh, options.meshInstances, options.scene.seed, buildOptions));
+		}
+		else
+		{
+			scene->add(mesh);
+		}
+	}
+	if (scene->bvh().empty())
+	{
+		scene->build(shutterOpen, shutterClose, buildOptions);
+
+		// meshes and sphere sets are custom primitives, which the cache cannot hold
+		if (!options.sceneCachePath.empty() && scene->cacheable())
+		{
+			scene->saveCache(options.sceneCachePath, cacheKey);
+		}
+	}
+	scene->bvh().printStats(std::cout);
+	if (loadSeconds > 0.0)
+	{
+		report.phases.push_back({ "load", loadSeconds });
+	}
+	report.phases.push_back({ "build", secondsSince(start) - loadSeconds });
 
 	// camera
-\	glm::vec3 eyePos(13.0f, 2.0f, 3.0f);
+	glm::vec3 eyePos(13.0f, 2.0f, 3.0f);
 	glm::vec3 lookAt(0.0f, 0.0f, 0.0f);
 	glm::vec3 up(0.0f, 1.0f, 0.0f);
 	float aspectRatio = static_cast<float>(width) / height;
 	float focusDistance = 10.0;
-	Camera camera{ eyePos, lookAt, up, aspectRatio, focusDistance, 20.0f, 0.0f, 0.0f, 1.0f };
+	Camera camera{ eyePos, lookAt, up, aspectRatio, focusDistance, 20.0f, 0.0f, shutterOpen, shutterClose };
 
-	// actual pixel data
-	for (int j = height - 1; j >= 0; --j)	// 99 to 0
+	// renders samples [firstSample, firstSample + sampleCount) of every pixel - or only of the pixels marked in the active
+	// mask, if there is one - in tiles across all threads, storing their mean
+	Integrator integrator{ options.integrator };
+	WavefrontIntegrator wavefront{ options.integrator };
+	std::atomic<uint64_t> rayCount{ 0 };
+	Renderer renderer{ options.render };
+	auto renderSamples = [&](uint32_t aFirstSample, uint32_t aSampleCount, Framebuffer &aTarget, const uint8_t *aActive)
 	{
-		for (int i = 0; i < width; ++i)	// 0 to 200
+		if (options.wavefront)
 		{
-			glm::vec3 accumColor{ 0.0f };
+			renderer.render([&](const Tile &aTile, Framebuffer &aFramebuffer)
+			{
+				uint32_t tileRays = 0;
+				wavefront.render(aTile, aFramebuffer, camera, *scene, aFirstSample, aSampleCount, tileRays, aActive);
+				rayCount += tileRays;
+			}, aTarget);
+		}
+		else if (options.packetSize == 4 || options.packetSize == 8 || options.packetSize == 16)
+		{
+			renderer.render([&](const Tile &aTile, Framebuffer &aFramebuffer)
+			{
+				uint32_t tileRays = 0;
+				switch (options.packetSize)
+				{
+				case 4:
+					renderPackets<4>(aTile, aFramebuffer, camera, *scene, integrator, aFirstSample, aSampleCount, tileRays, aActive);
+					break;
+				case 8:
+					renderPackets<8>(aTile, aFramebuffer, camera, *scene, integrator, aFirstSample, aSampleCount, tileRays, aActive);
+					break;
+				default:
+					renderPackets<16>(aTile, aFramebuffer, camera, *scene, integrator, aFirstSample, aSampleCount, tileRays, aActive);
+					break;
+				}
+				rayCount += tileRays;
+			}, aTarget);
+		}
+		else
+		{
+			renderer.render([&](uint32_t i, uint32_t j)
+			{
+				glm::vec3 accumColor{ 0.0f };
+				uint32_t pixelRays = 0;
+				if (aActive && !aActive[j * width + i])
+				{
+					return accumColor;
+				}
+
+				// perform anti-aliasing by taking multiple samples 
+				for (uint32_t samp = aFirstSample; samp < aFirstSample + aSampleCount; ++samp)
+				{
+					// every sample draws from its own random stream, so the image does not depend on which thread renders it
+					Sampler sampler{ j * width + i, samp };
+
+					// jitter the position by a small amount
+					glm::vec2 jitter = sampler.next2D();
+					float u = float(i + jitter.x) / float(width);
+					float v = float(j + jitter.y) / float(height);
+					Ray ray = camera.generateRay(u, v, sampler);
 
-			// perform anti-aliasing by taking multiple samples 
-			for (int samp = 0; samp < ns; ++samp)
+					// accumulate the total color contributions
+					accumColor += integrator.radiance(ray, *scene, sampler, pixelRays);
+				}
+				rayCount += pixelRays;
+				return accumColor / float(aSampleCount);
+			}, aTarget);
+		}
+	};
+
+	ImageWriter writer{ options.image };
+	Framebuffer framebuffer{ width, height };
+	double renderStart = secondsSince(start);
+	renderer.resetStats();
+	uint64_t samplesTaken = static_cast<uint64_t>(width) * height * ns;
+	if (options.progressive || options.adaptive.enabled)
+	{
+		// one sample per pixel per pass, until the target sample count is reached or the next pass would likely overrun
+		// the time budget - the first pass always runs, so there is an image to write
+		//
+		// adaptive sampling lets only the pixels whose error is still above the threshold take part in a pass, once every
+		// pixel has taken the minimum number of samples - a pixel that stops never resumes, as its estimate no longer
+		// changes, so every pixel rendered in pass k has taken exactly k samples and takes sample k next
+		AccumulationBuffer accumulation{ width, height };
+		Framebuffer pass{ width, height };
+		std::vector<uint8_t> active;
+		double lastCheckpoint = secondsSince(start);
+		double passSeconds = 0.0;
+		uint32_t passes = 0;
+		while (passes < ns && (passes == 0 || options.timeBudget <= 0.0 || secondsSince(start) + passSeconds <= options.timeBudget))
+		{
+			double passStart = secondsSince(start);
+			if (options.adaptive.enabled && passes >= options.adaptive.minSamples)
+			{
+				if (accumulation.findUnconverged(options.adaptive.threshold, options.adaptive.luminanceFloor, active) == 0)
+				{
+					break;
+				}
+				renderSamples(passes, 1, pass, active.data());
+				accumulation.add(pass, active);
+			}
+			else
 			{
-				// jitter the position by a small amount
-				float u = float(i + randFloat()) / float(width);
-				float v = float(j + randFloat()) / float(height);
-				Ray ray = camera.generateRay(u, v);
+				renderSamples(passes, 1, pass, nullptr);
+				accumulation.add(pass);
+			}
+			++passes;
+			passSeconds = secondsSince(start) - passStart;
 
-				// accumulate the total color contributions
-				accumColor += color(ray, scene->list(), 0.0f);
+			if (options.checkpointInterval > 0.0 && passes < ns && secondsSince(start) - lastCheckpoint >= options.checkpointInterval)
+			{
+				accumulation.resolve(framebuffer);
+				writer.write(options.outputPath, framebuffer);
+				lastCheckpoint = secondsSince(start);
+				std::cout << "checkpoint after " << passes << " passes, " << lastCheckpoint << "s" << std::endl;
 			}
-			accumColor /= ns;
+		}
+		accumulation.resolve(framebuffer);
+		samplesTaken = accumulation.totalSamples();
+		std::cout << passes << " passes of up to " << ns << " in " << secondsSince(start) << "s, "
+				  << static_cast<double>(samplesTaken) / (static_cast<uint64_t>(width) * height) << " samples per pixel on average" << std::endl;
+
+		// the sample count AOV, linear even in 8-bit formats
+		if (!options.adaptive.sampleMapPath.empty())
+		{
+			ImageOptions mapOptions = options.image;
+			mapOptions.gamma = 1.0f;
+			Framebuffer sampleMap{ width, height };
+			accumulation.resolveSampleCounts(sampleMap, 1.0f / float(ns));
+			ImageWriter{ mapOptions }.write(options.adaptive.sampleMapPath, sampleMap);
+		}
+	}
+	else
+	{
+		renderSamples(0, ns, framebuffer, nullptr);
+	}
+	report.phases.push_back({ "render", secondsSince(start) - renderStart });
+	renderer.printStats(std::cout);
+	if (options.wavefront)
+	{
+		wavefront.printStats(std::cout);
+	}
 
-			// gamma correction
-			accumColor = glm::vec3(powf(accumColor.r, 1.0f / gamma), powf(accumColor.g, 1.0f / gamma), powf(accumColor.b, 1.0f / gamma));
+	// the whole image is encoded in memory and written at once
+	double outputStart = secondsSince(start);
+	bool written = writer.write(options.outputPath, framebuffer);
+	report.phases.push_back({ "output", secondsSince(start) - outputStart });
 
-			int ir = static_cast<int>(255.99 * accumColor.r);
-			int ig = static_cast<int>(255.99 * accumColor.g);
-			int ib = static_cast<int>(255.99 * accumColor.b);
-			outFile << ir << " " << ig << " " << ib << "\n";
+	// the counters of all threads, gathered now that none of them is rendering
+	report.counters = Stats::gather();
+	report.rayCount = rayCount;
+	report.sampleCount = samplesTaken;
+	report.print(std::cout);
+	if (!options.statsPath.empty())
+	{
+		std::ofstream file(options.statsPath);
+		report.writeJson(file);
+		if (!file)
+		{
+			std::cerr << "Could not write " << options.statsPath << std::endl;
 		}
 	}
-	return 0;
+	return written ? 0 : 1;
 }
-
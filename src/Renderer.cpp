@@ -0,0 +1,91 @@
+#include "../include/Renderer.h"
+
+#include <algorithm>
+#include <iomanip>
+
+Renderer::Renderer(const RenderOptions &aOptions) :
+	mOptions(aOptions),
+	mPool(ThreadPool::shared(aOptions.threadCount))
+{
+	mOptions.tileSize = std::max<uint32_t>(1, mOptions.tileSize);
+}
+
+RendererRef Renderer::create(const RenderOptions &aOptions)
+{
+	return RendererRef(new Renderer(aOptions));
+}
+
+void Renderer::render(const PixelFunction &aPixelFunction, Framebuffer &aFramebuffer)
+{
+	render([&](const Tile &aTile, Framebuffer &aTarget)
+	{
+		for (uint32_t y = aTile.y0; y < aTile.y1; ++y)
+		{
+			for (uint32_t x = aTile.x0; x < aTile.x1; ++x)
+			{
+				aTarget.set(x, y, aPixelFunction(x, y));
+			}
+		}
+	}, aFramebuffer);
+}
+
+void Renderer::render(const TileFunction &aTileFunction, Framebuffer &aFramebuffer)
+{
+	buildTiles(aFramebuffer.width(), aFramebuffer.height());
+	mPool->dispatch(mTiles.size(), [&](size_t aTaskIndex, size_t)
+	{
+		aTileFunction(mTiles[aTaskIndex], aFramebuffer);
+	});
+}
+
+void Renderer::resetStats()
+{
+	mPool->resetStats();
+}
+
+void Renderer::printStats(std::ostream &aStream) const
+{
+	auto stats = mPool->stats();
+	double wall = mPool->dispatchSeconds();
+	std::streamsize precision = aStream.precision();
+
+	// progressive and adaptive rendering call render() once per pass, and every pass renders every tile again
+	uint64_t tiles = 0;
+	for (const ThreadStats &threadStats : stats)
+	{
+		tiles += threadStats.tasksExecuted;
+	}
+	aStream << "rendered " << tiles << " tiles of " << mOptions.tileSize << "x" << mOptions.tileSize
+			<< " on " << stats.size() << " threads in " << std::fixed << std::setprecision(3) << wall << "s\n";
+
+	double totalBusy = 0.0;
+	for (size_t i = 0; i < stats.size(); ++i)
+	{
+		double utilization = wall > 0.0 ? 100.0 * stats[i].busySeconds / wall : 0.0;
+		totalBusy += stats[i].busySeconds;
+		aStream << "  thread " << std::setw(3) << i << ": " << std::setw(6) << std::setprecision(1) << utilization << "% busy, "
+				<< stats[i].tasksExecuted << " tiles (" << stats[i].tasksStolen << " stolen)\n";
+	}
+
+	double average = (wall > 0.0 && !stats.empty()) ? 100.0 * totalBusy / (wall * stats.size()) : 0.0;
+	aStream << "  average utilization: " << std::setprecision(1) << average << "%" << std::endl;
+	aStream << std::defaultfloat << std::setprecision(precision);
+}
+
+void Renderer::buildTiles(uint32_t aWidth, uint32_t aHeight)
+{
+	mTiles.clear();
+	uint32_t size = mOptions.tileSize;
+
+	// the image is written top to bottom, so emit the top rows of tiles first
+	uint32_t rows = (aHeight + size - 1) / size;
+	for (uint32_t row = 0; row < rows; ++row)
+	{
+		uint32_t y1 = aHeight - row * size;
+		uint32_t y0 = y1 > size ? y1 - size : 0;
+		for (uint32_t x0 = 0; x0 < aWidth; x0 += size)
+		{
+			mTiles.push_back({ x0, y0, std::min(x0 + size, aWidth), y1 });
+		}
+	}
+}
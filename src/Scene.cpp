@@ -0,0 +1,549 @@
+#include "../include/Scene.h"
+#include "../include/SceneCache.h"
+
+namespace
+{
+	//! the ray-sphere test of Sphere::hit - returns true and the nearer root if it lies within (tMin, tMax), otherwise
+	//! the farther one
+	inline bool intersectSphere(const glm::vec3 &aCenter, float aRadius, const Ray &aRay, float aTMin, float aTMax, float &aT)
+	{
+		glm::vec3 oc{ aRay.origin() - aCenter };
+		float a = glm::dot(aRay.direction(), aRay.direction());
+		float b = 2.0f * glm::dot(oc, aRay.direction());
+		float c = glm::dot(oc, oc) - aRadius * aRadius;
+		float discriminant = b * b - 4.0f * a * c;
+		if (discriminant > 0.0f)
+		{
+			float temp = (-b - sqrtf(discriminant)) / (2.0f * a);
+			if (temp > aTMin && temp < aTMax)
+			{
+				aT = temp;
+				return true;
+			}
+			temp = (-b + sqrtf(discriminant)) / (2.0f * a);
+			if (temp > aTMin && temp < aTMax)
+			{
+				aT = temp;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//! returns the center of a moving sphere at the given time, as MovingSphere::centerAtTime does
+	inline glm::vec3 centerAtTime(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aTime)
+	{
+		return aCenter0 + ((aTime - aTime0) / (aTime1 - aTime0)) * (aCenter1 - aCenter0);
+	}
+
+	//! permutes an array - a vector or a buffer - so that element i becomes aArray[aOrder[i]]
+	template<typename Array>
+	void reorder(Array &aArray, const std::vector<uint32_t> &aOrder)
+	{
+		std::vector<typename std::decay<decltype(aArray[0])>::type> sorted(aArray.size());
+		for (size_t i = 0; i < aOrder.size(); ++i)
+		{
+			sorted[i] = aArray[aOrder[i]];
+		}
+		aArray = std::move(sorted);
+	}
+
+	//! replaces one element of a buffer
+	template<typename T>
+	void setElement(Buffer<T> &aBuffer, size_t aIndex, const T &aValue)
+	{
+		aBuffer.storage()[aIndex] = aValue;
+		aBuffer.update();
+	}
+
+	//! moves the positions in aSlots along with the elements they point at when an array is permuted by aOrder
+	void reorderSlots(Buffer<uint32_t> &aSlots, const std::vector<uint32_t> &aOrder)
+	{
+		std::vector<uint32_t> positions(aOrder.size());
+		for (size_t i = 0; i < aOrder.size(); ++i)
+		{
+			positions[aOrder[i]] = static_cast<uint32_t>(i);
+		}
+		for (uint32_t &slot : aSlots.storage())
+		{
+			slot = positions[slot];
+		}
+		aSlots.update();
+	}
+}
+
+//----------------------------------------------------------------------------------
+// scene
+SceneRef Scene::create()
+{
+	return SceneRef(new Scene());
+}
+
+uint32_t Scene::addMaterial(const MaterialRef &aMaterial)
+{
+	mMaterials.push_back(aMaterial);
+	return static_cast<uint32_t>(mMaterials.size() - 1);
+}
+
+uint32_t Scene::addSphere(const glm::vec3 &aCenter, float aRadius, uint32_t aMaterial)
+{
+	uint32_t index = static_cast<uint32_t>(mSpheres.size());
+	mSpheres.centerX.push_back(aCenter.x);
+	mSpheres.centerY.push_back(aCenter.y);
+	mSpheres.centerZ.push_back(aCenter.z);
+	mSpheres.radius.push_back(aRadius);
+	mSpheres.materials.push_back(aMaterial);
+	mSpheres.slots.push_back(index);
+	return index;
+}
+
+uint32_t Scene::addMovingSphere(const glm::vec3 &aCenter0, const glm::vec3 &aCenter1, float aTime0, float aTime1, float aRadius, uint32_t aMaterial)
+{
+	uint32_t index = static_cast<uint32_t>(mMovingSpheres.size());
+	mMovingSpheres.center0X.push_back(aCenter0.x);
+	mMovingSpheres.center0Y.push_back(aCenter0.y);
+	mMovingSpheres.center0Z.push_back(aCenter0.z);
+	mMovingSpheres.center1X.push_back(aCenter1.x);
+	mMovingSpheres.center1Y.push_back(aCenter1.y);
+	mMovingSpheres.center1Z.push_back(aCenter1.z);
+	mMovingSpheres.time0.push_back(aTime0);
+	mMovingSpheres.time1.push_back(aTime1);
+	mMovingSpheres.radius.push_back(aRadius);
+	mMovingSpheres.materials.push_back(aMaterial);
+	mMovingSpheres.slots.push_back(index);
+	return index;
+}
+
+void Scene::setSphereCenter(uint32_t aIndex, const glm::vec3 &aCenter)
+{
+	uint32_t slot = mSpheres.slots[aIndex];
+	setElement(mSpheres.centerX, slot, aCenter.x);
+	setElement(mSpheres.centerY, slot, aCenter.y);
+	setElement(mSpheres.centerZ, slot, aCenter.z);
+}
+
+void Scene::setMovingSphereCenters(uint32_t aIndex, const glm::vec3 &aCenter0, const glm::vec3 &aCenter1)
+{
+	uint32_t slot = mMovingSpheres.slots[aIndex];
+	setElement(mMovingSpheres.center0X, slot, aCenter0.x);
+	setElement(mMovingSpheres.center0Y, slot, aCenter0.y);
+	setElement(mMovingSpheres.center0Z, slot, aCenter0.z);
+	setElement(mMovingSpheres.center1X, slot, aCenter1.x);
+	setElement(mMovingSpheres.center1Y, slot, aCenter1.y);
+	setElement(mMovingSpheres.center1Z, slot, aCenter1.z);
+}
+
+void Scene::add(const HitableRef &aHitable)
+{
+	mCustom.push_back(aHitable);
+}
+
+void Scene::primitiveBounds(float aTime0, float aTime1, std::vector<AABB> &aStartBounds, std::vector<AABB> &aEndBounds, std::vector<uint8_t> &aTypes) const
+{
+	aStartBounds.clear();
+	aEndBounds.clear();
+	aTypes.clear();
+	aStartBounds.reserve(size());
+	aEndBounds.reserve(size());
+	aTypes.reserve(size());
+
+	for (size_t i = 0; i < mSpheres.size(); ++i)
+	{
+		glm::vec3 center{ mSpheres.centerX[i], mSpheres.centerY[i], mSpheres.centerZ[i] };
+		AABB box{ center - glm::vec3(mSpheres.radius[i]), center + glm::vec3(mSpheres.radius[i]) };
+		aStartBounds.push_back(box);
+		aEndBounds.push_back(box);
+		aTypes.push_back(static_cast<uint8_t>(PrimitiveType::Sphere));
+	}
+
+	// a moving sphere is where its linear motion puts it at either end of the interval
+	for (size_t i = 0; i < mMovingSpheres.size(); ++i)
+	{
+		glm::vec3 center0{ mMovingSpheres.center0X[i], mMovingSpheres.center0Y[i], mMovingSpheres.center0Z[i] };
+		glm::vec3 center1{ mMovingSpheres.center1X[i], mMovingSpheres.center1Y[i], mMovingSpheres.center1Z[i] };
+		glm::vec3 start = centerAtTime(center0, center1, mMovingSpheres.time0[i], mMovingSpheres.time1[i], aTime0);
+		glm::vec3 end = centerAtTime(center0, center1, mMovingSpheres.time0[i], mMovingSpheres.time1[i], aTime1);
+		glm::vec3 radius{ mMovingSpheres.radius[i] };
+		aStartBounds.push_back(AABB(start - radius, start + radius));
+		aEndBounds.push_back(AABB(end - radius, end + radius));
+		aTypes.push_back(static_cast<uint8_t>(PrimitiveType::MovingSphere));
+	}
+
+	// custom primitives only know their box over an interval, which is used at both ends as if they stood still
+	for (const auto &hitable : mCustom)
+	{
+		AABB box;
+		if (!hitable->boundingBox(aTime0, aTime1, box))
+		{
+			std::cerr << "No bounding box for a custom primitive of the scene." << std::endl;
+		}
+		aStartBounds.push_back(box);
+		aEndBounds.push_back(box);
+		aTypes.push_back(static_cast<uint8_t>(PrimitiveType::Custom));
+	}
+}
+
+void Scene::build(float aTime0, float aTime1, const BVHBuildOptions &aOptions)
+{
+	std::vector<AABB> startBounds;
+	std::vector<AABB> endBounds;
+	std::vector<uint8_t> types;
+	primitiveBounds(aTime0, aTime1, startBounds, endBounds, types);
+
+	// only moving spheres make the hierarchy move - without any, it is built and traversed as before
+	if (aTime1 > aTime0 && mMovingSpheres.size() > 0)
+	{
+		mBVH.build(startBounds, endBounds, aTime0, aTime1, aOptions, types);
+	}
+	else
+	{
+		mBVH.build(startBounds, aOptions, types);
+	}
+	storeInLeafOrder();
+}
+
+void Scene::refit(float aTime0, float aTime1)
+{
+	if (mBVH.empty())
+	{
+		build(aTime0, aTime1);
+		return;
+	}
+
+	std::vector<AABB> startBounds;
+	std::vector<AABB> endBounds;
+	std::vector<uint8_t> types;
+	primitiveBounds(aTime0, aTime1, startBounds, endBounds, types);
+
+	bool refitted = aTime1 > aTime0 && mMovingSpheres.size() > 0
+		? mBVH.refit(startBounds, endBounds, aTime0, aTime1, types)
+		: mBVH.refit(startBounds, types);
+	if (!refitted)
+	{
+		storeInLeafOrder();
+	}
+}
+
+void Scene::storeInLeafOrder()
+{
+	// the leaf offsets of each type count only primitives of that type, so splitting the leaf order by type gives the
+	// order in which every array has to be stored - and every slot then refers to the position its primitive moves to,
+	// which is where primitiveBounds() puts its box on the next refit
+	const uint32_t sphereEnd = static_cast<uint32_t>(mSpheres.size());
+	const uint32_t movingSphereEnd = sphereEnd + static_cast<uint32_t>(mMovingSpheres.size());
+	std::vector<uint32_t> sphereOrder;
+	std::vector<uint32_t> movingSphereOrder;
+	std::vector<uint32_t> customOrder;
+	std::vector<uint32_t> primitiveIndices;
+	primitiveIndices.reserve(size());
+	for (uint32_t index : mBVH.primitiveIndices())
+	{
+		if (index < sphereEnd)
+		{
+			primitiveIndices.push_back(static_cast<uint32_t>(sphereOrder.size()));
+			sphereOrder.push_back(index);
+		}
+		else if (index < movingSphereEnd)
+		{
+			primitiveIndices.push_back(sphereEnd + static_cast<uint32_t>(movingSphereOrder.size()));
+			movingSphereOrder.push_back(index - sphereEnd);
+		}
+		else
+		{
+			primitiveIndices.push_back(movingSphereEnd + static_cast<uint32_t>(customOrder.size()));
+			customOrder.push_back(index - movingSphereEnd);
+		}
+	}
+	mBVH.setPrimitiveIndices(std::move(primitiveIndices));
+
+	reorder(mSpheres.centerX, sphereOrder);
+	reorder(mSpheres.centerY, sphereOrder);
+	reorder(mSpheres.centerZ, sphereOrder);
+	reorder(mSpheres.radius, sphereOrder);
+	reorder(mSpheres.materials, sphereOrder);
+	reorderSlots(mSpheres.slots, sphereOrder);
+
+	reorder(mMovingSpheres.center0X, movingSphereOrder);
+	reorder(mMovingSpheres.center0Y, movingSphereOrder);
+	reorder(mMovingSpheres.center0Z, movingSphereOrder);
+	reorder(mMovingSpheres.center1X, movingSphereOrder);
+	reorder(mMovingSpheres.center1Y, movingSphereOrder);
+	reorder(mMovingSpheres.center1Z, movingSphereOrder);
+	reorder(mMovingSpheres.time0, movingSphereOrder);
+	reorder(mMovingSpheres.time1, movingSphereOrder);
+	reorder(mMovingSpheres.radius, movingSphereOrder);
+	reorder(mMovingSpheres.materials, movingSphereOrder);
+	reorderSlots(mMovingSpheres.slots, movingSphereOrder);
+
+	reorder(mCustom, customOrder);
+}
+
+bool Scene::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
+{
+	PrimitiveHit closest{ PrimitiveType::Custom, 0, aTMax };
+	bool hitAnything = false;
+	if (mBVH.empty())
+	{
+		// not built yet: test everything
+		float tMax = aTMax;
+		hitAnything |= intersectLeaf(PrimitiveType::Sphere, 0, static_cast<uint32_t>(mSpheres.size()), aRay, aTMin, tMax, closest, aRecord);
+		hitAnything |= intersectLeaf(PrimitiveType::MovingSphere, 0, static_cast<uint32_t>(mMovingSpheres.size()), aRay, aTMin, tMax, closest, aRecord);
+		hitAnything |= intersectLeaf(PrimitiveType::Custom, 0, static_cast<uint32_t>(mCustom.size()), aRay, aTMin, tMax, closest, aRecord);
+	}
+	else
+	{
+		hitAnything = mBVH.intersect(aRay, aTMin, aTMax, [&](uint32_t aFirst, uint32_t aCount, uint32_t aType, float &aClosest)
+		{
+			return intersectLeaf(static_cast<PrimitiveType>(aType), aFirst, aCount, aRay, aTMin, aClosest, closest, aRecord);
+		});
+	}
+
+	// custom primitives fill in the record themselves, every other type only gets a record for the closest hit
+	if (hitAnything && closest.type != PrimitiveType::Custom)
+	{
+		fillRecord(closest, aRay, aRecord);
+	}
+	return hitAnything;
+}
+
+template<int N>
+uint32_t Scene::hitPacket(RayPacket<N> &aPacket, float aTMin, HitRecord *aRecords) const
+{
+	PrimitiveHit closest[N];
+	uint32_t hitMask = 0;
+	if (mBVH.empty())
+	{
+		for (int i = 0; i < N; ++i)
+		{
+			if (((aPacket.activeMask >> i) & 1) && hit(aPacket.rays[i], aTMin, aPacket.tMax[i], aRecords[i]))
+			{
+				aPacket.tMax[i] = aRecords[i].t;
+				hitMask |= 1u << i;
+			}
+		}
+		return hitMask;
+	}
+
+	mBVH.intersectPacket(aPacket, aTMin, [&](uint32_t aFirst, uint32_t aCount, uint32_t aType, uint32_t aMask)
+	{
+		bool hitAnything = false;
+		while (aMask)
+		{
+			uint32_t i = firstBit(aMask);
+			aMask &= aMask - 1;
+			if (intersectLeaf(static_cast<PrimitiveType>(aType), aFirst, aCount, aPacket.rays[i], aTMin, aPacket.tMax[i], closest[i], aRecords[i]))
+			{
+				hitMask |= 1u << i;
+				hitAnything = true;
+			}
+		}
+		return hitAnything;
+	});
+
+	for (uint32_t mask = hitMask; mask; mask &= mask - 1)
+	{
+		uint32_t i = firstBit(mask);
+		if (closest[i].type != PrimitiveType::Custom)
+		{
+			fillRecord(closest[i], aPacket.rays[i], aRecords[i]);
+		}
+	}
+	return hitMask;
+}
+
+template uint32_t Scene::hitPacket<4>(RayPacket<4> &aPacket, float aTMin, HitRecord *aRecords) const;
+template uint32_t Scene::hitPacket<8>(RayPacket<8> &aPacket, float aTMin, HitRecord *aRecords) const;
+template uint32_t Scene::hitPacket<16>(RayPacket<16> &aPacket, float aTMin, HitRecord *aRecords) const;
+
+bool Scene::intersectLeaf(PrimitiveType aType, uint32_t aFirst, uint32_t aCount, const Ray &aRay, float aTMin, float &aTMax, PrimitiveHit &aHit, HitRecord &aRecord) const
+{
+	bool hitAnything = false;
+	switch (aType)
+	{
+	case PrimitiveType::Sphere:
+		for (uint32_t i = aFirst; i < aFirst + aCount; ++i)
+		{
+			glm::vec3 center{ mSpheres.centerX[i], mSpheres.centerY[i], mSpheres.centerZ[i] };
+			if (intersectSphere(center, mSpheres.radius[i], aRay, aTMin, aTMax, aTMax))
+			{
+				aHit = { aType, i, aTMax };
+				hitAnything = true;
+			}
+		}
+		break;
+	case PrimitiveType::MovingSphere:
+		for (uint32_t i = aFirst; i < aFirst + aCount; ++i)
+		{
+			glm::vec3 center0{ mMovingSpheres.center0X[i], mMovingSpheres.center0Y[i], mMovingSpheres.center0Z[i] };
+			glm::vec3 center1{ mMovingSpheres.center1X[i], mMovingSpheres.center1Y[i], mMovingSpheres.center1Z[i] };
+			glm::vec3 center = centerAtTime(center0, center1, mMovingSpheres.time0[i], mMovingSpheres.time1[i], aRay.time());
+			if (intersectSphere(center, mMovingSpheres.radius[i], aRay, aTMin, aTMax, aTMax))
+			{
+				aHit = { aType, i, aTMax };
+				hitAnything = true;
+			}
+		}
+		break;
+	case PrimitiveType::Custom:
+		for (uint32_t i = aFirst; i < aFirst + aCount; ++i)
+		{
+			HitRecord tempRecord;
+			if (mCustom[i]->hit(aRay, aTMin, aTMax, tempRecord))
+			{
+				aTMax = tempRecord.t;
+				aHit = { aType, i, aTMax };
+				aRecord = tempRecord;
+				hitAnything = true;
+			}
+		}
+		break;
+	}
+	return hitAnything;
+}
+
+void Scene::fillRecord(const PrimitiveHit &aHit, const Ray &aRay, HitRecord &aRecord) const
+{
+	uint32_t i = aHit.index;
+	glm::vec3 center;
+	float radius;
+	uint32_t material;
+	if (aHit.type == PrimitiveType::Sphere)
+	{
+		center = glm::vec3(mSpheres.centerX[i], mSpheres.centerY[i], mSpheres.centerZ[i]);
+		radius = mSpheres.radius[i];
+		material = mSpheres.materials[i];
+	}
+	else
+	{
+		glm::vec3 center0{ mMovingSpheres.center0X[i], mMovingSpheres.center0Y[i], mMovingSpheres.center0Z[i] };
+		glm::vec3 center1{ mMovingSpheres.center1X[i], mMovingSpheres.center1Y[i], mMovingSpheres.center1Z[i] };
+		center = centerAtTime(center0, center1, mMovingSpheres.time0[i], mMovingSpheres.time1[i], aRay.time());
+		radius = mMovingSpheres.radius[i];
+		material = mMovingSpheres.materials[i];
+	}
+
+	aRecord.t = aHit.t;
+	aRecord.position = aRay.pointAtTime(aHit.t);
+	aRecord.normal = (aRecord.position - center) / radius;
+	aRecord.materialId = material;
+}
+
+bool Scene::boundingBox(float aTime0, float aTime1, AABB &aBox) const
+{
+	if (size() == 0)
+	{
+		return false;
+	}
+	if (!mBVH.empty())
+	{
+		aBox = mBVH.bounds();
+		return true;
+	}
+
+	std::vector<AABB> startBounds;
+	std::vector<AABB> endBounds;
+	std::vector<uint8_t> types;
+	primitiveBounds(aTime0, aTime1, startBounds, endBounds, types);
+	aBox = AABB::empty();
+	for (size_t i = 0; i < startBounds.size(); ++i)
+	{
+		aBox.extend(startBounds[i]);
+		aBox.extend(endBounds[i]);
+	}
+	return true;
+}
+
+bool Scene::saveCache(const std::string &aPath, uint64_t aKey) const
+{
+	if (!cacheable())
+	{
+		std::cerr << "Scenes with custom primitives cannot be cached" << std::endl;
+		return false;
+	}
+	if (mBVH.empty() && size() > 0)
+	{
+		std::cerr << "Only built scenes can be cached" << std::endl;
+		return false;
+	}
+
+	std::vector<MaterialDesc> materials;
+	for (const auto &material : mMaterials)
+	{
+		materials.push_back(material->desc());
+	}
+
+	SceneCacheWriter writer;
+	mBVH.writeCache(writer);
+	writer.add(SceneCacheSection::Materials, materials);
+	writer.add(SceneCacheSection::SphereCenterX, mSpheres.centerX);
+	writer.add(SceneCacheSection::SphereCenterY, mSpheres.centerY);
+	writer.add(SceneCacheSection::SphereCenterZ, mSpheres.centerZ);
+	writer.add(SceneCacheSection::SphereRadius, mSpheres.radius);
+	writer.add(SceneCacheSection::SphereMaterials, mSpheres.materials);
+	writer.add(SceneCacheSection::SphereSlots, mSpheres.slots);
+	writer.add(SceneCacheSection::MovingSphereCenter0X, mMovingSpheres.center0X);
+	writer.add(SceneCacheSection::MovingSphereCenter0Y, mMovingSpheres.center0Y);
+	writer.add(SceneCacheSection::MovingSphereCenter0Z, mMovingSpheres.center0Z);
+	writer.add(SceneCacheSection::MovingSphereCenter1X, mMovingSpheres.center1X);
+	writer.add(SceneCacheSection::MovingSphereCenter1Y, mMovingSpheres.center1Y);
+	writer.add(SceneCacheSection::MovingSphereCenter1Z, mMovingSpheres.center1Z);
+	writer.add(SceneCacheSection::MovingSphereTime0, mMovingSpheres.time0);
+	writer.add(SceneCacheSection::MovingSphereTime1, mMovingSpheres.time1);
+	writer.add(SceneCacheSection::MovingSphereRadius, mMovingSpheres.radius);
+	writer.add(SceneCacheSection::MovingSphereMaterials, mMovingSpheres.materials);
+	writer.add(SceneCacheSection::MovingSphereSlots, mMovingSpheres.slots);
+	return writer.write(aPath, aKey);
+}
+
+SceneRef Scene::loadCache(const std::string &aPath, uint64_t aKey)
+{
+	SceneCacheReader reader;
+	if (!reader.open(aPath, aKey))
+	{
+		return nullptr;
+	}
+
+	SceneRef scene = create();
+	Spheres &spheres = scene->mSpheres;
+	MovingSpheres &movingSpheres = scene->mMovingSpheres;
+	Buffer<MaterialDesc> materials;
+	bool valid = scene->mBVH.readCache(reader)
+		&& reader.read(SceneCacheSection::Materials, materials)
+		&& reader.read(SceneCacheSection::SphereCenterX, spheres.centerX)
+		&& reader.read(SceneCacheSection::SphereCenterY, spheres.centerY)
+		&& reader.read(SceneCacheSection::SphereCenterZ, spheres.centerZ)
+		&& reader.read(SceneCacheSection::SphereRadius, spheres.radius)
+		&& reader.read(SceneCacheSection::SphereMaterials, spheres.materials)
+		&& reader.read(SceneCacheSection::SphereSlots, spheres.slots)
+		&& reader.read(SceneCacheSection::MovingSphereCenter0X, movingSpheres.center0X)
+		&& reader.read(SceneCacheSection::MovingSphereCenter0Y, movingSpheres.center0Y)
+		&& reader.read(SceneCacheSection::MovingSphereCenter0Z, movingSpheres.center0Z)
+		&& reader.read(SceneCacheSection::MovingSphereCenter1X, movingSpheres.center1X)
+		&& reader.read(SceneCacheSection::MovingSphereCenter1Y, movingSpheres.center1Y)
+		&& reader.read(SceneCacheSection::MovingSphereCenter1Z, movingSpheres.center1Z)
+		&& reader.read(SceneCacheSection::MovingSphereTime0, movingSpheres.time0)
+		&& reader.read(SceneCacheSection::MovingSphereTime1, movingSpheres.time1)
+		&& reader.read(SceneCacheSection::MovingSphereRadius, movingSpheres.radius)
+		&& reader.read(SceneCacheSection::MovingSphereMaterials, movingSpheres.materials)
+		&& reader.read(SceneCacheSection::MovingSphereSlots, movingSpheres.slots);
+
+	// every array of a type holds one entry per primitive, and the BVH covers all of them
+	const size_t n = spheres.size();
+	const size_t m = movingSpheres.size();
+	valid = valid && spheres.centerX.size() == n && spheres.centerY.size() == n && spheres.centerZ.size() == n && spheres.materials.size() == n && spheres.slots.size() == n
+		&& movingSpheres.center0X.size() == m && movingSpheres.center0Y.size() == m && movingSpheres.center0Z.size() == m
+		&& movingSpheres.center1X.size() == m && movingSpheres.center1Y.size() == m && movingSpheres.center1Z.size() == m
+		&& movingSpheres.time0.size() == m && movingSpheres.time1.size() == m && movingSpheres.materials.size() == m && movingSpheres.slots.size() == m
+		&& scene->mBVH.primitiveIndices().size() == n + m;
+	if (!valid)
+	{
+		std::cerr << "Scene cache " << aPath << " is incomplete" << std::endl;
+		return nullptr;
+	}
+
+	for (const MaterialDesc &desc : materials)
+	{
+		scene->mMaterials.push_back(Material::create(desc));
+	}
+	return scene;
+}
@@ -0,0 +1,125 @@
+#include "../include/SceneCache.h"
+#include "../include/FileUtils.h"
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+	const char kMagic[8] = { 'R', 'T', 'S', 'C', 'A', 'C', 'H', 'E' };
+	const uint32_t kByteOrder = 0x01020304u;
+
+	//! rounds an offset up to the alignment of sections
+	uint64_t align(uint64_t aOffset)
+	{
+		return (aOffset + kSceneCacheAlignment - 1) / kSceneCacheAlignment * kSceneCacheAlignment;
+	}
+}
+
+//----------------------------------------------------------------------------------
+// scene cache writer
+bool SceneCacheWriter::write(const std::string &aPath, uint64_t aKey) const
+{
+	SceneCacheHeader header;
+	std::memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kSceneCacheVersion;
+	header.byteOrder = kByteOrder;
+	header.key = aKey;
+	header.sectionCount = static_cast<uint32_t>(mSections.size());
+	header.reserved = 0;
+
+	std::vector<SceneCacheEntry> entries(mSections.size());
+	uint64_t offset = align(sizeof(SceneCacheHeader) + entries.size() * sizeof(SceneCacheEntry));
+	for (size_t i = 0; i < mSections.size(); ++i)
+	{
+		entries[i] = { static_cast<uint32_t>(mSections[i].section), mSections[i].elementSize, offset, mSections[i].size };
+		offset = align(offset + mSections[i].size);
+	}
+
+	// the sections are streamed straight from the scene's arrays, with zeros up to the start of the next one
+	return writeFileAtomically(aPath, [&](std::ostream &aStream)
+	{
+		aStream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		aStream.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(SceneCacheEntry));
+		uint64_t position = sizeof(header) + entries.size() * sizeof(SceneCacheEntry);
+		const char padding[kSceneCacheAlignment] = {};
+		for (size_t i = 0; i < mSections.size(); ++i)
+		{
+			aStream.write(padding, entries[i].offset - position);
+			aStream.write(static_cast<const char*>(mSections[i].data), mSections[i].size);
+			position = entries[i].offset + entries[i].size;
+		}
+		return static_cast<bool>(aStream);
+	});
+}
+
+//----------------------------------------------------------------------------------
+// scene cache reader
+bool SceneCacheReader::open(const std::string &aPath, uint64_t aKey)
+{
+	mFile.reset();
+	mEntries.clear();
+
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	if (!file->open(aPath))
+	{
+		return false;
+	}
+
+	SceneCacheHeader header;
+	if (file->size() < sizeof(header))
+	{
+		std::cerr << aPath << " is not a scene cache" << std::endl;
+		return false;
+	}
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+	{
+		std::cerr << aPath << " is not a scene cache" << std::endl;
+		return false;
+	}
+	if (header.version != kSceneCacheVersion || header.byteOrder != kByteOrder)
+	{
+		std::cerr << "Scene cache " << aPath << " was written by another version or on another architecture" << std::endl;
+		return false;
+	}
+	if (header.key != aKey)
+	{
+		std::cerr << "Scene cache " << aPath << " was written for another scene" << std::endl;
+		return false;
+	}
+
+	uint64_t tableEnd = sizeof(header) + static_cast<uint64_t>(header.sectionCount) * sizeof(SceneCacheEntry);
+	if (file->size() < tableEnd)
+	{
+		std::cerr << "Scene cache " << aPath << " is truncated" << std::endl;
+		return false;
+	}
+	mEntries.resize(header.sectionCount);
+	std::memcpy(mEntries.data(), file->data() + sizeof(header), mEntries.size() * sizeof(SceneCacheEntry));
+	for (const auto &entry : mEntries)
+	{
+		if (entry.offset % kSceneCacheAlignment != 0 || entry.offset > file->size() || entry.size > file->size() - entry.offset)
+		{
+			std::cerr << "Scene cache " << aPath << " is truncated" << std::endl;
+			mEntries.clear();
+			return false;
+		}
+	}
+
+	mFile = file;
+	return true;
+}
+
+const SceneCacheEntry* SceneCacheReader::find(SceneCacheSection aSection, size_t aElementSize) const
+{
+	for (const auto &entry : mEntries)
+	{
+		if (entry.section == static_cast<uint32_t>(aSection))
+		{
+			bool valid = entry.elementSize == aElementSize && entry.size % aElementSize == 0;
+			return valid ? &entry : nullptr;
+		}
+	}
+	return nullptr;
+}
@@ -0,0 +1,285 @@
+#include "../include/SphereSet.h"
+
+#include <limits>
+
+SphereSetRef SphereSet::create()
+{
+	return SphereSetRef(new SphereSet());
+}
+
+void SphereSet::reserve(size_t aCount)
+{
+	mCenterX.reserve(aCount + kBatchSize);
+	mCenterY.reserve(aCount + kBatchSize);
+	mCenterZ.reserve(aCount + kBatchSize);
+	mRadius.reserve(aCount + kBatchSize);
+	mMaterialIds.reserve(aCount + kBatchSize);
+}
+
+uint32_t SphereSet::push_back(const glm::vec3 &aCenter, float aRadius, uint32_t aMaterial)
+{
+	uint32_t index = static_cast<uint32_t>(mCount);
+	resize(mCount + 1);
+	mCenterX[index] = aCenter.x;
+	mCenterY[index] = aCenter.y;
+	mCenterZ[index] = aCenter.z;
+	mRadius[index] = aRadius;
+	mMaterialIds[index] = aMaterial;
+	mSlots.push_back(index);
+	return index;
+}
+
+void SphereSet::setCenter(uint32_t aIndex, const glm::vec3 &aCenter)
+{
+	uint32_t slot = mSlots[aIndex];
+	mCenterX[slot] = aCenter.x;
+	mCenterY[slot] = aCenter.y;
+	mCenterZ[slot] = aCenter.z;
+}
+
+glm::vec3 SphereSet::center(uint32_t aIndex) const
+{
+	uint32_t slot = mSlots[aIndex];
+	return { mCenterX[slot], mCenterY[slot], mCenterZ[slot] };
+}
+
+void SphereSet::resize(size_t aCount)
+{
+	mCount = aCount;
+	mCenterX.resize(aCount + kBatchSize, 0.0f);
+	mCenterY.resize(aCount + kBatchSize, 0.0f);
+	mCenterZ.resize(aCount + kBatchSize, 0.0f);
+	mRadius.resize(aCount + kBatchSize, 0.0f);
+	mMaterialIds.resize(aCount + kBatchSize, 0);
+}
+
+std::vector<AABB> SphereSet::sphereBounds() const
+{
+	std::vector<AABB> bounds(mCount);
+	for (size_t i = 0; i < mCount; ++i)
+	{
+		glm::vec3 center{ mCenterX[i], mCenterY[i], mCenterZ[i] };
+		bounds[i] = AABB(center - glm::vec3(mRadius[i]), center + glm::vec3(mRadius[i]));
+	}
+	return bounds;
+}
+
+void SphereSet::build(const BVHBuildOptions &aOptions)
+{
+	// leaves hold at most one batch, so that every leaf is intersected by a single kernel call
+	BVHBuildOptions options = aOptions;
+	options.maxLeafSize = kBatchSize;
+	mBVH.build(sphereBounds(), options);
+	storeInLeafOrder();
+}
+
+void SphereSet::refit()
+{
+	if (mBVH.empty())
+	{
+		build();
+	}
+	else if (!mBVH.refit(sphereBounds()))
+	{
+		storeInLeafOrder();
+	}
+}
+
+void SphereSet::storeInLeafOrder()
+{
+	// store the spheres in leaf order, which turns every leaf into a contiguous run of the arrays
+	const Buffer<uint32_t> &order = mBVH.primitiveIndices();
+	auto reorder = [&](auto &aArray)
+	{
+		auto sorted = aArray;
+		for (size_t i = 0; i < mCount; ++i)
+		{
+			sorted[i] = aArray[order[i]];
+		}
+		aArray.swap(sorted);
+	};
+	reorder(mCenterX);
+	reorder(mCenterY);
+	reorder(mCenterZ);
+	reorder(mRadius);
+	reorder(mMaterialIds);
+
+	// every sphere moves from the position it was stored at to the slot that refers to it, and the hierarchy reads its
+	// bounds from there on the next refit
+	std::vector<uint32_t> slots(mCount);
+	std::vector<uint32_t> identity(mCount);
+	for (uint32_t i = 0; i < mCount; ++i)
+	{
+		slots[order[i]] = i;
+		identity[i] = i;
+	}
+	for (uint32_t &slot : mSlots)
+	{
+		slot = slots[slot];
+	}
+	mBVH.setPrimitiveIndices(std::move(identity));
+}
+
+bool SphereSet::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
+{
+	uint32_t index = 0;
+	float closest = aTMax;
+	bool hitAnything = false;
+	if (mBVH.empty())
+	{
+		// not built yet: test everything
+		hitAnything = intersectRange(0, static_cast<uint32_t>(mCount), aRay, aTMin, closest, index);
+	}
+	else
+	{
+		hitAnything = mBVH.intersect(aRay, aTMin, aTMax, [&](uint32_t aFirst, uint32_t aCount, uint32_t, float &aClosest)
+		{
+			if (intersectRange(aFirst, aCount, aRay, aTMin, aClosest, index))
+			{
+				closest = aClosest;
+				return true;
+			}
+			return false;
+		});
+	}
+
+	// only the closest hit gets a full record
+	if (hitAnything)
+	{
+		fillRecord(index, aRay, closest, aRecord);
+	}
+	return hitAnything;
+}
+
+bool SphereSet::boundingBox(float aTime0, float aTime1, AABB &aBox) const
+{
+	if (mCount == 0)
+	{
+		return false;
+	}
+	if (!mBVH.empty())
+	{
+		aBox = mBVH.bounds();
+		return true;
+	}
+
+	aBox = AABB::empty();
+	for (size_t i = 0; i < mCount; ++i)
+	{
+		glm::vec3 center{ mCenterX[i], mCenterY[i], mCenterZ[i] };
+		aBox.extend(AABB(center - glm::vec3(mRadius[i]), center + glm::vec3(mRadius[i])));
+	}
+	return true;
+}
+
+bool SphereSet::intersectRange(uint32_t aFirst, uint32_t aCount, const Ray &aRay, float aTMin, float &aTMax, uint32_t &aIndex) const
+{
+	bool hitAnything = false;
+	for (uint32_t first = aFirst; first < aFirst + aCount; first += kBatchSize)
+	{
+		int lane = intersectBatch(first, std::min(kBatchSize, aFirst + aCount - first), aRay, aTMin, aTMax);
+		if (lane >= 0)
+		{
+			aIndex = first + static_cast<uint32_t>(lane);
+			hitAnything = true;
+		}
+	}
+	return hitAnything;
+}
+
+void SphereSet::fillRecord(uint32_t aIndex, const Ray &aRay, float aT, HitRecord &aRecord) const
+{
+	glm::vec3 center{ mCenterX[aIndex], mCenterY[aIndex], mCenterZ[aIndex] };
+	aRecord.t = aT;
+	aRecord.position = aRay.pointAtTime(aT);
+	aRecord.normal = (aRecord.position - center) / mRadius[aIndex];
+	aRecord.materialId = mMaterialIds[aIndex];
+}
+
+int SphereSet::intersectBatch(uint32_t aFirst, uint32_t aCount, const Ray &aRay, float aTMin, float &aTMax) const
+{
+	// the same quadratic as Sphere::hit, evaluated for a whole batch: the nearer root is used if it lies within
+	// (tMin, tMax), otherwise the farther one
+	const glm::vec3 origin = aRay.origin();
+	const glm::vec3 direction = aRay.direction();
+	const float a = glm::dot(direction, direction);
+	const float inf = std::numeric_limits<float>::infinity();
+
+	float t[kBatchSize];
+
+#if defined(RT_SSE)
+	const __m128 ox = _mm_set1_ps(origin.x);
+	const __m128 oy = _mm_set1_ps(origin.y);
+	const __m128 oz = _mm_set1_ps(origin.z);
+	const __m128 dx = _mm_set1_ps(direction.x);
+	const __m128 dy = _mm_set1_ps(direction.y);
+	const __m128 dz = _mm_set1_ps(direction.z);
+	const __m128 fourA = _mm_set1_ps(4.0f * a);
+	const __m128 twoA = _mm_set1_ps(2.0f * a);
+	const __m128 tMin = _mm_set1_ps(aTMin);
+	const __m128 tMax = _mm_set1_ps(aTMax);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	// the batch is processed as two SSE halves
+	for (uint32_t half = 0; half < kBatchSize; half += 4)
+	{
+		uint32_t i = aFirst + half;
+		__m128 ocx = _mm_sub_ps(ox, _mm_loadu_ps(&mCenterX[i]));
+		__m128 ocy = _mm_sub_ps(oy, _mm_loadu_ps(&mCenterY[i]));
+		__m128 ocz = _mm_sub_ps(oz, _mm_loadu_ps(&mCenterZ[i]));
+		__m128 r = _mm_loadu_ps(&mRadius[i]);
+
+		__m128 b = _mm_mul_ps(_mm_set1_ps(2.0f), _mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, dx), _mm_mul_ps(ocy, dy)), _mm_mul_ps(ocz, dz)));
+		__m128 c = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ocx, ocx), _mm_mul_ps(ocy, ocy)), _mm_mul_ps(ocz, ocz)), _mm_mul_ps(r, r));
+		__m128 discriminant = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(fourA, c));
+		__m128 valid = _mm_cmpgt_ps(discriminant, _mm_setzero_ps());
+
+		__m128 root = _mm_sqrt_ps(_mm_max_ps(discriminant, _mm_setzero_ps()));
+		__m128 negB = _mm_xor_ps(b, signBit);
+		__m128 t0 = _mm_div_ps(_mm_sub_ps(negB, root), twoA);
+		__m128 t1 = _mm_div_ps(_mm_add_ps(negB, root), twoA);
+
+		__m128 use0 = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t0, tMin), _mm_cmplt_ps(t0, tMax)));
+		__m128 use1 = _mm_andnot_ps(use0, _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t1, tMin), _mm_cmplt_ps(t1, tMax))));
+		__m128 result = _mm_or_ps(_mm_and_ps(use0, t0), _mm_and_ps(use1, t1));
+		result = _mm_or_ps(result, _mm_andnot_ps(_mm_or_ps(use0, use1), _mm_set1_ps(inf)));
+		_mm_storeu_ps(&t[half], result);
+	}
+#else
+	for (uint32_t lane = 0; lane < kBatchSize; ++lane)
+	{
+		uint32_t i = aFirst + lane;
+		glm::vec3 oc = origin - glm::vec3(mCenterX[i], mCenterY[i], mCenterZ[i]);
+		float b = 2.0f * glm::dot(oc, direction);
+		float c = glm::dot(oc, oc) - mRadius[i] * mRadius[i];
+		float discriminant = b * b - 4.0f * a * c;
+
+		t[lane] = inf;
+		if (discriminant > 0.0f)
+		{
+			float t0 = (-b - sqrtf(discriminant)) / (2.0f * a);
+			float t1 = (-b + sqrtf(discriminant)) / (2.0f * a);
+			if (t0 > aTMin && t0 < aTMax)
+			{
+				t[lane] = t0;
+			}
+			else if (t1 > aTMin && t1 < aTMax)
+			{
+				t[lane] = t1;
+			}
+		}
+	}
+#endif
+
+	// pick the closest hit among the lanes that hold spheres
+	int closest = -1;
+	for (uint32_t lane = 0; lane < aCount; ++lane)
+	{
+		if (t[lane] < aTMax)
+		{
+			aTMax = t[lane];
+			closest = static_cast<int>(lane);
+		}
+	}
+	return closest;
+}
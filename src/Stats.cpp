@@ -0,0 +1,152 @@
+#include "../include/Stats.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+	const char *kCounterNames[] = {
+		"bvh_traversals", "bvh_nodes_visited", "bvh_leaves_visited", "bvh_primitive_tests",
+		"list_traversals", "list_object_tests",
+		"scatter_diffuse", "scatter_specular", "scatter_transmission", "scatter_absorbed",
+		"paths_escaped", "paths_absorbed", "paths_depth_limited", "paths_rouletted"
+	};
+	static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0]) == static_cast<size_t>(StatCounter::Count), "every counter needs a name");
+
+	//! the counters of every thread that has counted anything
+	struct Registry
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<StatCounters>> threads;
+	};
+
+	Registry& registry()
+	{
+		static Registry instance;
+		return instance;
+	}
+
+	//! returns aValue / aCount, or 0 if there is nothing to average over
+	double ratio(uint64_t aValue, uint64_t aCount)
+	{
+		return aCount > 0 ? static_cast<double>(aValue) / static_cast<double>(aCount) : 0.0;
+	}
+}
+
+//----------------------------------------------------------------------------------
+// stats
+StatCounters Stats::gather()
+{
+	StatCounters total;
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (const auto &thread : r.threads)
+	{
+		for (size_t i = 0; i < static_cast<size_t>(StatCounter::Count); ++i)
+		{
+			total.counts[i] += thread->counts[i];
+		}
+		for (uint32_t i = 0; i < kPathLengthBins; ++i)
+		{
+			total.pathLengths[i] += thread->pathLengths[i];
+		}
+	}
+	return total;
+}
+
+void Stats::reset()
+{
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	for (auto &thread : r.threads)
+	{
+		*thread = StatCounters();
+	}
+}
+
+StatCounters* Stats::registerThread()
+{
+	Registry &r = registry();
+	std::lock_guard<std::mutex> lock(r.mutex);
+	r.threads.emplace_back(new StatCounters());
+	return r.threads.back().get();
+}
+
+//----------------------------------------------------------------------------------
+// stats report
+void StatsReport::print(std::ostream &aStream) const
+{
+	std::streamsize precision = aStream.precision();
+	aStream << "statistics:\n" << std::fixed;
+
+	double renderSeconds = 0.0;
+	for (const auto &phase : phases)
+	{
+		aStream << "  " << std::left << std::setw(9) << (phase.first + ":") << std::right << std::setprecision(3) << phase.second << "s\n";
+		renderSeconds = phase.first == renderPhase ? phase.second : renderSeconds;
+	}
+	aStream << "  rays:    " << rayCount << " (" << std::setprecision(2) << ratio(rayCount, sampleCount) << " per sample, "
+			<< std::setprecision(3) << (renderSeconds > 0.0 ? 1e-6 * rayCount / renderSeconds : 0.0) << " Mrays/s)\n";
+
+#if RT_STATS
+	const StatCounters &c = counters;
+	uint64_t traversals = c[StatCounter::BVHTraversals];
+	aStream << "  bvh:     " << traversals << " traversals, " << std::setprecision(1)
+			<< ratio(c[StatCounter::BVHNodesVisited], traversals) << " nodes, "
+			<< ratio(c[StatCounter::BVHLeavesVisited], traversals) << " leaves, "
+			<< ratio(c[StatCounter::BVHPrimitiveTests], traversals) << " primitive tests per traversal\n";
+	if (c[StatCounter::ListTraversals] > 0)
+	{
+		aStream << "  list:    " << c[StatCounter::ListTraversals] << " traversals, "
+				<< ratio(c[StatCounter::ListObjectTests], c[StatCounter::ListTraversals]) << " object tests per traversal\n";
+	}
+	aStream << "  scatter: " << c[StatCounter::ScatterDiffuse] << " diffuse, " << c[StatCounter::ScatterSpecular] << " specular, "
+			<< c[StatCounter::ScatterTransmission] << " transmission, " << c[StatCounter::ScatterAbsorbed] << " absorbed\n";
+
+	uint64_t paths = c[StatCounter::PathsEscaped] + c[StatCounter::PathsAbsorbed] + c[StatCounter::PathsDepthLimited] + c[StatCounter::PathsRouletted];
+	uint64_t segments = 0;
+	for (uint32_t i = 0; i < kPathLengthBins; ++i)
+	{
+		segments += i * c.pathLengths[i];
+	}
+	aStream << "  paths:   " << paths << ", " << std::setprecision(2) << ratio(segments, paths) << " rays on average ("
+			<< c[StatCounter::PathsEscaped] << " escaped, " << c[StatCounter::PathsAbsorbed] << " absorbed, "
+			<< c[StatCounter::PathsDepthLimited] << " depth limited, " << c[StatCounter::PathsRouletted] << " rouletted)\n";
+
+	// the histogram, as a percentage of all paths per length
+	aStream << "  path lengths:";
+	for (uint32_t i = 1; i < kPathLengthBins; ++i)
+	{
+		aStream << " " << i << (i + 1 == kPathLengthBins ? "+" : "") << ":" << std::setprecision(1) << 100.0 * ratio(c.pathLengths[i], paths) << "%";
+	}
+	aStream << "\n";
+#else
+	aStream << "  counters compiled out (RT_STATS=0)\n";
+#endif
+	aStream << std::defaultfloat << std::setprecision(precision);
+}
+
+void StatsReport::writeJson(std::ostream &aStream) const
+{
+	std::streamsize precision = aStream.precision();
+	aStream << std::setprecision(9) << "{\n  \"phases\": {";
+	for (size_t i = 0; i < phases.size(); ++i)
+	{
+		aStream << (i > 0 ? ", " : "") << "\"" << phases[i].first << "\": " << phases[i].second;
+	}
+	aStream << "},\n  \"rays\": " << rayCount << ",\n  \"samples\": " << sampleCount << ",\n  \"counters_enabled\": " << (RT_STATS ? "true" : "false");
+
+	aStream << ",\n  \"counters\": {";
+	for (size_t i = 0; i < static_cast<size_t>(StatCounter::Count); ++i)
+	{
+		aStream << (i > 0 ? ", " : "") << "\"" << kCounterNames[i] << "\": " << counters.counts[i];
+	}
+	aStream << "},\n  \"path_lengths\": [";
+	for (uint32_t i = 0; i < kPathLengthBins; ++i)
+	{
+		aStream << (i > 0 ? ", " : "") << counters.pathLengths[i];
+	}
+	aStream << "]\n}" << std::endl;
+	aStream << std::setprecision(precision);
+}
@@ -0,0 +1,207 @@
+#include "../include/ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+
+namespace
+{
+	//! returns the number of threads a pool created for aThreadCount runs
+	size_t resolveThreadCount(size_t aThreadCount)
+	{
+		return aThreadCount == 0 ? std::max<size_t>(1, std::thread::hardware_concurrency()) : aThreadCount;
+	}
+}
+
+//----------------------------------------------------------------------------------
+// thread pool
+ThreadPool::ThreadPool(size_t aThreadCount)
+{
+	aThreadCount = resolveThreadCount(aThreadCount);
+
+	for (size_t i = 0; i < aThreadCount; ++i)
+	{
+		mWorkers.push_back(std::unique_ptr<Worker>(new Worker()));
+	}
+
+	// thread 0 is whichever thread calls dispatch(), so only spawn the rest
+	for (size_t i = 1; i < aThreadCount; ++i)
+	{
+		mThreads.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStop = true;
+	}
+	mWake.notify_all();
+	for (auto &thread : mThreads)
+	{
+		thread.join();
+	}
+}
+
+ThreadPoolRef ThreadPool::create(size_t aThreadCount)
+{
+	return ThreadPoolRef(new ThreadPool(aThreadCount));
+}
+
+ThreadPoolRef ThreadPool::shared(size_t aThreadCount)
+{
+	// pools are keyed by the number of threads they actually run, so that 0 and an explicit count of hardware threads
+	// share one
+	static std::mutex mutex;
+	static std::map<size_t, ThreadPoolRef> pools;
+	std::lock_guard<std::mutex> lock(mutex);
+	ThreadPoolRef &pool = pools[resolveThreadCount(aThreadCount)];
+	if (!pool)
+	{
+		pool = create(aThreadCount);
+	}
+	return pool;
+}
+
+void ThreadPool::dispatch(size_t aTaskCount, const Task &aTask)
+{
+	if (aTaskCount == 0)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> dispatchLock(mDispatchMutex);
+	auto start = std::chrono::steady_clock::now();
+
+	mTask = &aTask;
+	mRemaining = aTaskCount;
+
+	// hand every thread a contiguous run of tasks so that neighbouring tasks (i.e. neighbouring tiles) stay on one core
+	size_t n = mWorkers.size();
+	for (size_t i = 0; i < n; ++i)
+	{
+		size_t first = aTaskCount * i / n;
+		size_t last = aTaskCount * (i + 1) / n;
+
+		std::lock_guard<std::mutex> lock(mWorkers[i]->mutex);
+		for (size_t task = first; task < last; ++task)
+		{
+			mWorkers[i]->queue.push_back(task);
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mGeneration;
+	}
+	mWake.notify_all();
+
+	// the calling thread works too, then waits for any tasks still in flight on other threads
+	drain(0);
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mDone.wait(lock, [this] { return mRemaining == 0; });
+	}
+	mTask = nullptr;
+
+	mDispatchSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::vector<ThreadStats> ThreadPool::stats() const
+{
+	std::vector<ThreadStats> result;
+	for (const auto &worker : mWorkers)
+	{
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		result.push_back(worker->stats);
+	}
+	return result;
+}
+
+void ThreadPool::resetStats()
+{
+	std::lock_guard<std::mutex> dispatchLock(mDispatchMutex);
+	for (auto &worker : mWorkers)
+	{
+		std::lock_guard<std::mutex> lock(worker->mutex);
+		worker->stats = ThreadStats();
+	}
+	mDispatchSeconds = 0.0;
+}
+
+void ThreadPool::workerLoop(size_t aThreadIndex)
+{
+	uint64_t seenGeneration = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [&] { return mStop || mGeneration != seenGeneration; });
+			if (mStop)
+			{
+				return;
+			}
+			seenGeneration = mGeneration;
+		}
+		drain(aThreadIndex);
+	}
+}
+
+void ThreadPool::drain(size_t aThreadIndex)
+{
+	Worker &self = *mWorkers[aThreadIndex];
+	size_t taskIndex;
+	bool stolen;
+	while (acquire(aThreadIndex, taskIndex, stolen))
+	{
+		auto start = std::chrono::steady_clock::now();
+		(*mTask)(taskIndex, aThreadIndex);
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(self.mutex);
+			self.stats.busySeconds += elapsed;
+			self.stats.tasksExecuted++;
+			self.stats.tasksStolen += stolen ? 1 : 0;
+		}
+
+		if (--mRemaining == 0)
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mDone.notify_all();
+		}
+	}
+}
+
+bool ThreadPool::acquire(size_t aThreadIndex, size_t &aTaskIndex, bool &aStolen)
+{
+	// own queue first, oldest task first
+	{
+		Worker &self = *mWorkers[aThreadIndex];
+		std::lock_guard<std::mutex> lock(self.mutex);
+		if (!self.queue.empty())
+		{
+			aTaskIndex = self.queue.front();
+			self.queue.pop_front();
+			aStolen = false;
+			return true;
+		}
+	}
+
+	// then steal from the back of the other queues, starting with our neighbour
+	size_t n = mWorkers.size();
+	for (size_t offset = 1; offset < n; ++offset)
+	{
+		Worker &victim = *mWorkers[(aThreadIndex + offset) % n];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.queue.empty())
+		{
+			aTaskIndex = victim.queue.back();
+			victim.queue.pop_back();
+			aStolen = true;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,411 @@
+#include "../include/TriangleMesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	//! computes the 2D edge functions of the watertight test, which are the unnormalized barycentric coordinates of the
+	//! hit - if one of them comes out as exactly zero, the ray passes through an edge as far as single precision can tell,
+	//! and they are recomputed in double precision so that the triangles sharing the edge agree on which one is hit
+	inline void edgeFunctions(float aAx, float aAy, float aBx, float aBy, float aCx, float aCy, float &aU, float &aV, float &aW)
+	{
+		aU = aCx * aBy - aCy * aBx;
+		aV = aAx * aCy - aAy * aCx;
+		aW = aBx * aAy - aBy * aAx;
+		if (aU == 0.0f || aV == 0.0f || aW == 0.0f)
+		{
+			aU = static_cast<float>(static_cast<double>(aCx) * aBy - static_cast<double>(aCy) * aBx);
+			aV = static_cast<float>(static_cast<double>(aAx) * aCy - static_cast<double>(aAy) * aCx);
+			aW = static_cast<float>(static_cast<double>(aBx) * aAy - static_cast<double>(aBy) * aAx);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------------
+// watertight ray
+TriangleMesh::WatertightRay::WatertightRay(const Ray &aRay) :
+	origin(aRay.origin())
+{
+	// z is the dimension along which the direction is largest, and x and y are swapped for a negative z so that the
+	// winding of every triangle is preserved
+	const glm::vec3 direction = aRay.direction();
+	const glm::vec3 size = glm::abs(direction);
+	kz = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	kx = (kz + 1) % 3;
+	ky = (kx + 1) % 3;
+	if (direction[kz] < 0.0f)
+	{
+		std::swap(kx, ky);
+	}
+	sx = direction[kx] / direction[kz];
+	sy = direction[ky] / direction[kz];
+	sz = 1.0f / direction[kz];
+}
+
+//----------------------------------------------------------------------------------
+// triangle mesh
+TriangleMeshRef TriangleMesh::create()
+{
+	return TriangleMeshRef(new TriangleMesh());
+}
+
+void TriangleMesh::reserve(size_t aVertexCount, size_t aTriangleCount)
+{
+	mPositionX.reserve(aVertexCount);
+	mPositionY.reserve(aVertexCount);
+	mPositionZ.reserve(aVertexCount);
+	mIndices.reserve(3 * aTriangleCount);
+	mMaterialIds.reserve(aTriangleCount);
+}
+
+void TriangleMesh::resize(size_t aVertexCount, size_t aTriangleCount, bool aNormals)
+{
+	mPositionX.resize(aVertexCount);
+	mPositionY.resize(aVertexCount);
+	mPositionZ.resize(aVertexCount);
+	mNormalX.resize(aNormals ? aVertexCount : 0);
+	mNormalY.resize(aNormals ? aVertexCount : 0);
+	mNormalZ.resize(aNormals ? aVertexCount : 0);
+	mIndices.resize(3 * aTriangleCount);
+	mMaterialIds.resize(aTriangleCount);
+}
+
+uint32_t TriangleMesh::addVertex(const glm::vec3 &aPosition)
+{
+	mPositionX.push_back(aPosition.x);
+	mPositionY.push_back(aPosition.y);
+	mPositionZ.push_back(aPosition.z);
+	return static_cast<uint32_t>(mPositionX.size() - 1);
+}
+
+uint32_t TriangleMesh::addVertex(const glm::vec3 &aPosition, const glm::vec3 &aNormal)
+{
+	mNormalX.push_back(aNormal.x);
+	mNormalY.push_back(aNormal.y);
+	mNormalZ.push_back(aNormal.z);
+	return addVertex(aPosition);
+}
+
+void TriangleMesh::addTriangle(uint32_t aIndex0, uint32_t aIndex1, uint32_t aIndex2, uint32_t aMaterial)
+{
+	mIndices.push_back(aIndex0);
+	mIndices.push_back(aIndex1);
+	mIndices.push_back(aIndex2);
+	mMaterialIds.push_back(aMaterial);
+}
+
+void TriangleMesh::setPosition(uint32_t aIndex, const glm::vec3 &aPosition)
+{
+	mPositionX[aIndex] = aPosition.x;
+	mPositionY[aIndex] = aPosition.y;
+	mPositionZ[aIndex] = aPosition.z;
+}
+
+std::vector<AABB> TriangleMesh::triangleBounds() const
+{
+	const size_t count = triangleCount();
+	std::vector<AABB> bounds(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		AABB box = AABB::empty();
+		for (size_t corner = 0; corner < 3; ++corner)
+		{
+			box.extend(position(mIndices[3 * i + corner]));
+		}
+		bounds[i] = box;
+	}
+	return bounds;
+}
+
+void TriangleMesh::build(const BVHBuildOptions &aOptions)
+{
+	// leaves hold at most one batch, so that every leaf is intersected by a single kernel call
+	BVHBuildOptions options = aOptions;
+	options.maxLeafSize = kBatchSize;
+	mBVH.build(triangleBounds(), options);
+	storeInLeafOrder();
+}
+
+void TriangleMesh::refit()
+{
+	if (mBVH.empty())
+	{
+		build();
+		return;
+	}
+
+	if (mBVH.refit(triangleBounds()))
+	{
+		// the triangles keep their order, but their corners have moved
+		updateCorners();
+	}
+	else
+	{
+		storeInLeafOrder();
+	}
+}
+
+void TriangleMesh::storeInLeafOrder()
+{
+	// store the triangles in leaf order, which turns every leaf into a contiguous run - the vertices stay where they are
+	const size_t count = triangleCount();
+	std::vector<uint32_t> indices(mIndices.size());
+	std::vector<uint32_t> materialIds(count);
+	std::vector<uint32_t> identity(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		uint32_t source = mBVH.primitiveIndices()[i];
+		indices[3 * i + 0] = mIndices[3 * source + 0];
+		indices[3 * i + 1] = mIndices[3 * source + 1];
+		indices[3 * i + 2] = mIndices[3 * source + 2];
+		materialIds[i] = mMaterialIds[source];
+		identity[i] = static_cast<uint32_t>(i);
+	}
+	mIndices.swap(indices);
+	mMaterialIds.swap(materialIds);
+	updateCorners();
+
+	// the hierarchy reads the bounds of the triangles from their new positions on the next refit
+	mBVH.setPrimitiveIndices(std::move(identity));
+}
+
+void TriangleMesh::updateCorners()
+{
+	const size_t count = triangleCount();
+	const std::vector<float> *positions[3] = { &mPositionX, &mPositionY, &mPositionZ };
+	for (size_t corner = 0; corner < 3; ++corner)
+	{
+		for (size_t axis = 0; axis < 3; ++axis)
+		{
+			std::vector<float> &corners = mCorners[corner][axis];
+			corners.assign(count + kBatchSize, 0.0f);
+			for (size_t i = 0; i < count; ++i)
+			{
+				corners[i] = (*positions[axis])[mIndices[3 * i + corner]];
+			}
+		}
+	}
+}
+
+bool TriangleMesh::hit(const Ray &aRay, float aTMin, float aTMax, HitRecord &aRecord) const
+{
+	// triangles are only stored in the order the kernels expect once the BVH is built
+	if (mBVH.empty())
+	{
+		return false;
+	}
+
+	const WatertightRay ray(aRay);
+	uint32_t index = 0;
+	float closest = aTMax;
+	bool hitAnything = mBVH.intersect(aRay, aTMin, aTMax, [&](uint32_t aFirst, uint32_t aCount, uint32_t, float &aClosest)
+	{
+		if (intersectRange(aFirst, aCount, ray, aTMin, aClosest, index))
+		{
+			closest = aClosest;
+			return true;
+		}
+		return false;
+	});
+
+	// only the closest hit gets a full record
+	if (hitAnything)
+	{
+		fillRecord(index, aRay, closest, aRecord);
+	}
+	return hitAnything;
+}
+
+bool TriangleMesh::boundingBox(float aTime0, float aTime1, AABB &aBox) const
+{
+	if (triangleCount() == 0)
+	{
+		return false;
+	}
+	if (!mBVH.empty())
+	{
+		aBox = mBVH.bounds();
+		return true;
+	}
+
+	aBox = AABB::empty();
+	for (uint32_t index : mIndices)
+	{
+		aBox.extend(position(index));
+	}
+	return true;
+}
+
+bool TriangleMesh::intersectRange(uint32_t aFirst, uint32_t aCount, const WatertightRay &aRay, float aTMin, float &aTMax, uint32_t &aIndex) const
+{
+	bool hitAnything = false;
+	for (uint32_t first = aFirst; first < aFirst + aCount; first += kBatchSize)
+	{
+		int lane = intersectBatch(first, std::min(kBatchSize, aFirst + aCount - first), aRay, aTMin, aTMax);
+		if (lane >= 0)
+		{
+			aIndex = first + static_cast<uint32_t>(lane);
+			hitAnything = true;
+		}
+	}
+	return hitAnything;
+}
+
+void TriangleMesh::fillRecord(uint32_t aIndex, const Ray &aRay, float aT, HitRecord &aRecord) const
+{
+	const uint32_t *indices = &mIndices[3 * aIndex];
+	const glm::vec3 p0 = position(indices[0]);
+	const glm::vec3 e1 = position(indices[1]) - p0;
+	const glm::vec3 e2 = position(indices[2]) - p0;
+	const glm::vec3 geometricNormal = glm::normalize(glm::cross(e1, e2));
+
+	aRecord.t = aT;
+	aRecord.position = aRay.pointAtTime(aT);
+	aRecord.normal = geometricNormal;
+	aRecord.materialId = mMaterialIds[aIndex];
+
+	// interpolate the shading normals with the barycentric coordinates of the hit
+	if (!mNormalX.empty() && mNormalX.size() == vertexCount())
+	{
+		const glm::vec3 d = aRecord.position - p0;
+		const float d11 = glm::dot(e1, e1);
+		const float d12 = glm::dot(e1, e2);
+		const float d22 = glm::dot(e2, e2);
+		const float denominator = d11 * d22 - d12 * d12;
+		if (denominator > 0.0f)
+		{
+			const float b1 = (d22 * glm::dot(d, e1) - d12 * glm::dot(d, e2)) / denominator;
+			const float b2 = (d11 * glm::dot(d, e2) - d12 * glm::dot(d, e1)) / denominator;
+			auto normal = [&](uint32_t aVertex) { return glm::vec3(mNormalX[aVertex], mNormalY[aVertex], mNormalZ[aVertex]); };
+			glm::vec3 shading = (1.0f - b1 - b2) * normal(indices[0]) + b1 * normal(indices[1]) + b2 * normal(indices[2]);
+			if (glm::dot(shading, shading) > 0.0f)
+			{
+				aRecord.normal = glm::normalize(shading);
+			}
+		}
+	}
+}
+
+int TriangleMesh::intersectBatch(uint32_t aFirst, uint32_t aCount, const WatertightRay &aRay, float aTMin, float &aTMax) const
+{
+	// the watertight test of Woop, Benthin and Wald: the corners are moved relative to the ray origin, sheared so that
+	// the ray runs along z, and the signs of the 2D edge functions decide whether the ray passes inside the triangle
+	const float inf = std::numeric_limits<float>::infinity();
+	const int kx = aRay.kx;
+	const int ky = aRay.ky;
+	const int kz = aRay.kz;
+
+	float t[kBatchSize];
+
+#if defined(RT_SSE)
+	const uint32_t i = aFirst;
+	const __m128 ox = _mm_set1_ps(aRay.origin[kx]);
+	const __m128 oy = _mm_set1_ps(aRay.origin[ky]);
+	const __m128 oz = _mm_set1_ps(aRay.origin[kz]);
+	const __m128 sx = _mm_set1_ps(aRay.sx);
+	const __m128 sy = _mm_set1_ps(aRay.sy);
+	const __m128 sz = _mm_set1_ps(aRay.sz);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	__m128 az = _mm_sub_ps(_mm_loadu_ps(&mCorners[0][kz][i]), oz);
+	__m128 bz = _mm_sub_ps(_mm_loadu_ps(&mCorners[1][kz][i]), oz);
+	__m128 cz = _mm_sub_ps(_mm_loadu_ps(&mCorners[2][kz][i]), oz);
+	__m128 ax = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(&mCorners[0][kx][i]), ox), _mm_mul_ps(sx, az));
+	__m128 ay = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(&mCorners[0][ky][i]), oy), _mm_mul_ps(sy, az));
+	__m128 bx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(&mCorners[1][kx][i]), ox), _mm_mul_ps(sx, bz));
+	__m128 by = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(&mCorners[1][ky][i]), oy), _mm_mul_ps(sy, bz));
+	__m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(&mCorners[2][kx][i]), ox), _mm_mul_ps(sx, cz));
+	__m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(&mCorners[2][ky][i]), oy), _mm_mul_ps(sy, cz));
+
+	__m128 u = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+	__m128 v = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+	__m128 w = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+
+	// edge functions of exactly zero are rare, and recomputed lane by lane
+	__m128 onEdge = _mm_or_ps(_mm_cmpeq_ps(u, zero), _mm_or_ps(_mm_cmpeq_ps(v, zero), _mm_cmpeq_ps(w, zero)));
+	if (_mm_movemask_ps(onEdge))
+	{
+		alignas(16) float lanes[9][kBatchSize];
+		_mm_store_ps(lanes[0], ax);
+		_mm_store_ps(lanes[1], ay);
+		_mm_store_ps(lanes[2], bx);
+		_mm_store_ps(lanes[3], by);
+		_mm_store_ps(lanes[4], cx);
+		_mm_store_ps(lanes[5], cy);
+		for (uint32_t lane = 0; lane < kBatchSize; ++lane)
+		{
+			edgeFunctions(lanes[0][lane], lanes[1][lane], lanes[2][lane], lanes[3][lane], lanes[4][lane], lanes[5][lane], lanes[6][lane], lanes[7][lane], lanes[8][lane]);
+		}
+		u = _mm_load_ps(lanes[6]);
+		v = _mm_load_ps(lanes[7]);
+		w = _mm_load_ps(lanes[8]);
+	}
+
+	// the ray passes inside if no edge function is negative or none is positive - either winding is accepted
+	__m128 anyNegative = _mm_or_ps(_mm_cmplt_ps(u, zero), _mm_or_ps(_mm_cmplt_ps(v, zero), _mm_cmplt_ps(w, zero)));
+	__m128 anyPositive = _mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_or_ps(_mm_cmpgt_ps(v, zero), _mm_cmpgt_ps(w, zero)));
+	__m128 determinant = _mm_add_ps(u, _mm_add_ps(v, w));
+	__m128 valid = _mm_andnot_ps(_mm_and_ps(anyNegative, anyPositive), _mm_cmpneq_ps(determinant, zero));
+
+	// the scaled distance is compared against the interval scaled by the determinant, so only hits divide
+	__m128 scaledT = _mm_add_ps(_mm_mul_ps(u, _mm_mul_ps(sz, az)), _mm_add_ps(_mm_mul_ps(v, _mm_mul_ps(sz, bz)), _mm_mul_ps(w, _mm_mul_ps(sz, cz))));
+	__m128 determinantSign = _mm_and_ps(determinant, signBit);
+	__m128 absDeterminant = _mm_xor_ps(determinant, determinantSign);
+	__m128 signedT = _mm_xor_ps(scaledT, determinantSign);
+	valid = _mm_and_ps(valid, _mm_cmpgt_ps(signedT, _mm_mul_ps(_mm_set1_ps(aTMin), absDeterminant)));
+	valid = _mm_and_ps(valid, _mm_cmplt_ps(signedT, _mm_mul_ps(_mm_set1_ps(aTMax), absDeterminant)));
+
+	__m128 result = _mm_div_ps(scaledT, determinant);
+	result = _mm_or_ps(_mm_and_ps(valid, result), _mm_andnot_ps(valid, _mm_set1_ps(inf)));
+	_mm_storeu_ps(t, result);
+#else
+	for (uint32_t lane = 0; lane < kBatchSize; ++lane)
+	{
+		uint32_t i = aFirst + lane;
+		float az = mCorners[0][kz][i] - aRay.origin[kz];
+		float bz = mCorners[1][kz][i] - aRay.origin[kz];
+		float cz = mCorners[2][kz][i] - aRay.origin[kz];
+		float ax = mCorners[0][kx][i] - aRay.origin[kx] - aRay.sx * az;
+		float ay = mCorners[0][ky][i] - aRay.origin[ky] - aRay.sy * az;
+		float bx = mCorners[1][kx][i] - aRay.origin[kx] - aRay.sx * bz;
+		float by = mCorners[1][ky][i] - aRay.origin[ky] - aRay.sy * bz;
+		float cx = mCorners[2][kx][i] - aRay.origin[kx] - aRay.sx * cz;
+		float cy = mCorners[2][ky][i] - aRay.origin[ky] - aRay.sy * cz;
+
+		float u;
+		float v;
+		float w;
+		edgeFunctions(ax, ay, bx, by, cx, cy, u, v, w);
+
+		t[lane] = inf;
+		float determinant = u + v + w;
+		if (((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f)) || determinant == 0.0f)
+		{
+			continue;
+		}
+
+		float scaledT = u * (aRay.sz * az) + v * (aRay.sz * bz) + w * (aRay.sz * cz);
+		float signedT = determinant < 0.0f ? -scaledT : scaledT;
+		float absDeterminant = std::fabs(determinant);
+		if (signedT > aTMin * absDeterminant && signedT < aTMax * absDeterminant)
+		{
+			t[lane] = scaledT / determinant;
+		}
+	}
+#endif
+
+	// pick the closest hit among the lanes that hold triangles
+	int closest = -1;
+	for (uint32_t lane = 0; lane < aCount; ++lane)
+	{
+		if (t[lane] < aTMax)
+		{
+			aTMax = t[lane];
+			closest = static_cast<int>(lane);
+		}
+	}
+	return closest;
+}
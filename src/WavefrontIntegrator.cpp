@@ -0,0 +1,400 @@
+#include "../include/WavefrontIntegrator.h"
+#include "../include/Stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <limits>
+
+namespace
+{
+	//! returns the octant of a direction as three sign bits
+	inline uint32_t octant(const glm::vec3 &aDirection)
+	{
+		return (aDirection.x < 0.0f ? 4u : 0u) | (aDirection.y < 0.0f ? 2u : 0u) | (aDirection.z < 0.0f ? 1u : 0u);
+	}
+
+	//! interleaves the lower 5 bits of six values into a 30-bit key, the first value providing the most significant bit
+	inline uint32_t interleave6(const uint32_t aValues[6])
+	{
+		uint32_t key = 0;
+		for (int bit = 4; bit >= 0; --bit)
+		{
+			for (int i = 0; i < 6; ++i)
+			{
+				key = (key << 1) | ((aValues[i] >> bit) & 1u);
+			}
+		}
+		return key;
+	}
+
+	//! sorts values by their upper 32 bits with a least significant digit radix sort, which keeps values with equal keys
+	//! in order - the sorted values end up back in aValues
+	void radixSortByKey(std::vector<uint64_t> &aValues, std::vector<uint64_t> &aScratch)
+	{
+		aScratch.resize(aValues.size());
+		for (int shift = 32; shift < 64; shift += 8)
+		{
+			size_t offsets[257] = {};
+			for (uint64_t value : aValues)
+			{
+				++offsets[((value >> shift) & 0xFF) + 1];
+			}
+			for (int digit = 0; digit < 256; ++digit)
+			{
+				offsets[digit + 1] += offsets[digit];
+			}
+			for (uint64_t value : aValues)
+			{
+				aScratch[offsets[(value >> shift) & 0xFF]++] = value;
+			}
+			aValues.swap(aScratch);
+		}
+	}
+
+	//! returns the nanoseconds elapsed since the given time
+	inline uint64_t nanosecondsSince(std::chrono::steady_clock::time_point aStart)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - aStart).count());
+	}
+}
+
+//----------------------------------------------------------------------------------
+// path queue
+void PathQueue::resize(size_t aSize)
+{
+	rays.resize(aSize);
+	throughputs.resize(aSize);
+	samplers.resize(aSize);
+	slots.resize(aSize);
+	for (auto &depths : typeDepths)
+	{
+		depths.resize(aSize);
+	}
+	records.resize(aSize);
+	hits.resize(aSize);
+	alive.resize(aSize);
+	order.clear();
+}
+
+//----------------------------------------------------------------------------------
+// wavefront integrator
+WavefrontIntegrator::WavefrontIntegrator(const IntegratorOptions &aOptions) :
+	mOptions(aOptions)
+{
+	mOptions.wavefrontSize = std::max<uint32_t>(1, mOptions.wavefrontSize);
+}
+
+WavefrontIntegratorRef WavefrontIntegrator::create(const IntegratorOptions &aOptions)
+{
+	return WavefrontIntegratorRef(new WavefrontIntegrator(aOptions));
+}
+
+void WavefrontIntegrator::render(const Tile &aTile, Framebuffer &aFramebuffer, const Camera &aCamera, const Scene &aScene, uint32_t aFirstSample, uint32_t aSamples, uint32_t &aRayCount, const uint8_t *aActive) const
+{
+	const uint32_t width = aFramebuffer.width();
+	std::vector<uint32_t> pixels;
+	pixels.reserve((aTile.x1 - aTile.x0) * (aTile.y1 - aTile.y0));
+	for (uint32_t j = aTile.y0; j < aTile.y1; ++j)
+	{
+		for (uint32_t i = aTile.x0; i < aTile.x1; ++i)
+		{
+			if (!aActive || aActive[j * width + i])
+			{
+				pixels.push_back(j * width + i);
+			}
+		}
+	}
+	const uint32_t pixelCount = static_cast<uint32_t>(pixels.size());
+	const uint32_t pathCount = pixelCount * aSamples;
+
+	// every path writes its radiance into its own slot, so that the samples of a pixel can be summed in order afterwards
+	std::vector<glm::vec3> radiance(pathCount, glm::vec3(0.0f));
+	PathQueue queue;
+	for (uint32_t first = 0; first < pathCount; first += mOptions.wavefrontSize)
+	{
+		uint32_t count = std::min(mOptions.wavefrontSize, pathCount - first);
+		generate(pixels, first, count, aFramebuffer, aCamera, aFirstSample, aSamples, queue);
+
+		// the threshold follows the size of the batch, which a tile keeps small - a fixed number of rays would rule out
+		// sorting as soon as the first paths of a full tile end
+		const size_t sortMinimum = std::max<size_t>(2, static_cast<size_t>(mOptions.raySortFraction * count));
+		for (uint32_t depth = 0; queue.size() > 0; ++depth)
+		{
+			// camera rays leave the queue in scanline order, which is already coherent
+			if (depth > 0 && mOptions.raySort != RaySortMode::None && queue.size() >= sortMinimum)
+			{
+				auto start = std::chrono::steady_clock::now();
+				sort(queue);
+				mSortNanoseconds += nanosecondsSince(start);
+				++mSortedBatches;
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			extend(aScene, queue, aRayCount);
+			if (depth == 0)
+			{
+				mPrimaryNanoseconds += nanosecondsSince(start);
+				mPrimaryRays += queue.size();
+			}
+			else
+			{
+				mSecondaryNanoseconds += nanosecondsSince(start);
+				mSecondaryRays += queue.size();
+			}
+			shade(aScene, depth, queue, radiance.data() + first);
+			compact(queue);
+		}
+	}
+
+	for (uint32_t pixel = 0; pixel < pixelCount; ++pixel)
+	{
+		glm::vec3 accumColor{ 0.0f };
+		for (uint32_t samp = 0; samp < aSamples; ++samp)
+		{
+			accumColor += radiance[pixel * aSamples + samp];
+		}
+		aFramebuffer.set(pixels[pixel] % width, pixels[pixel] / width, accumColor / float(aSamples));
+	}
+}
+
+WavefrontStats WavefrontIntegrator::stats() const
+{
+	WavefrontStats stats;
+	stats.primaryRays = mPrimaryRays;
+	stats.secondaryRays = mSecondaryRays;
+	stats.primarySeconds = mPrimaryNanoseconds * 1e-9;
+	stats.secondarySeconds = mSecondaryNanoseconds * 1e-9;
+	stats.sortSeconds = mSortNanoseconds * 1e-9;
+	stats.sortedBatches = mSortedBatches;
+	return stats;
+}
+
+void WavefrontIntegrator::resetStats()
+{
+	mPrimaryRays = 0;
+	mSecondaryRays = 0;
+	mPrimaryNanoseconds = 0;
+	mSecondaryNanoseconds = 0;
+	mSortNanoseconds = 0;
+	mSortedBatches = 0;
+}
+
+void WavefrontIntegrator::printStats(std::ostream &aStream) const
+{
+	const char *modes[] = { "none", "octant", "morton" };
+	WavefrontStats s = stats();
+	std::streamsize precision = aStream.precision();
+
+	auto perRay = [](double aSeconds, uint64_t aRays) { return aRays > 0 ? 1e9 * aSeconds / aRays : 0.0; };
+	aStream << "wavefront, ray sort " << modes[static_cast<int>(mOptions.raySort)] << ":\n" << std::fixed
+			<< "  camera rays:    " << std::setw(10) << s.primaryRays << " in " << std::setprecision(3) << s.primarySeconds << "s ("
+			<< std::setprecision(1) << perRay(s.primarySeconds, s.primaryRays) << " ns/ray)\n"
+			<< "  secondary rays: " << std::setw(10) << s.secondaryRays << " in " << std::setprecision(3) << s.secondarySeconds << "s ("
+			<< std::setprecision(1) << perRay(s.secondarySeconds, s.secondaryRays) << " ns/ray)\n"
+			<< "  sorting:        " << std::setw(10) << s.sortedBatches << " batches in " << std::setprecision(3) << s.sortSeconds << "s, "
+			<< "secondary rays incl. sorting " << std::setprecision(1) << perRay(s.secondarySeconds + s.sortSeconds, s.secondaryRays) << " ns/ray" << std::endl;
+	aStream << std::defaultfloat << std::setprecision(precision);
+}
+
+void WavefrontIntegrator::generate(const std::vector<uint32_t> &aPixels, uint32_t aFirst, uint32_t aCount, const Framebuffer &aFramebuffer, const Camera &aCamera, uint32_t aFirstSample, uint32_t aSamples, PathQueue &aQueue) const
+{
+	const uint32_t width = aFramebuffer.width();
+	const uint32_t height = aFramebuffer.height();
+
+	aQueue.resize(aCount);
+	for (uint32_t slot = 0; slot < aCount; ++slot)
+	{
+		uint32_t path = aFirst + slot;
+		uint32_t pixel = aPixels[path / aSamples];
+		uint32_t i = pixel % width;
+		uint32_t j = pixel / width;
+
+		// the same sampler, jitter and camera ray as when the pixel is rendered by Integrator
+		Sampler sampler{ pixel, aFirstSample + path % aSamples };
+		glm::vec2 jitter = sampler.next2D();
+		float u = float(i + jitter.x) / float(width);
+		float v = float(j + jitter.y) / float(height);
+		aQueue.rays[slot] = aCamera.generateRay(u, v, sampler);
+
+		aQueue.samplers[slot] = sampler;
+		aQueue.throughputs[slot] = glm::vec3(1.0f);
+		aQueue.slots[slot] = slot;
+		for (auto &depths : aQueue.typeDepths)
+		{
+			depths[slot] = 0;
+		}
+	}
+}
+
+void WavefrontIntegrator::sort(PathQueue &aQueue) const
+{
+	const size_t size = aQueue.size();
+
+	// origins are placed in the bounds of the batch rather than those of the scene, whose ground sphere would squeeze
+	// everything else into a handful of cells
+	glm::vec3 lower{ std::numeric_limits<float>::max() };
+	glm::vec3 upper{ -std::numeric_limits<float>::max() };
+	for (const Ray &ray : aQueue.rays)
+	{
+		lower = glm::min(lower, ray.origin());
+		upper = glm::max(upper, ray.origin());
+	}
+	glm::vec3 scale = 1.0f / glm::max(upper - lower, glm::vec3(1e-6f));
+
+	// the key goes in the upper half and the index in the lower, so sorting them yields the permutation
+	std::vector<uint64_t> keys(size);
+	for (size_t i = 0; i < size; ++i)
+	{
+		const Ray &ray = aQueue.rays[i];
+		glm::vec3 origin = (ray.origin() - lower) * scale;
+		uint32_t key;
+		if (mOptions.raySort == RaySortMode::Octant)
+		{
+			key = (octant(ray.direction()) << 27) | (mortonCode(origin) >> 3);
+		}
+		else
+		{
+			glm::vec3 direction = glm::normalize(ray.direction()) * 0.5f + 0.5f;
+			glm::uvec3 d = glm::uvec3(glm::clamp(direction * 32.0f, glm::vec3(0.0f), glm::vec3(31.0f)));
+			glm::uvec3 o = glm::uvec3(glm::clamp(origin * 32.0f, glm::vec3(0.0f), glm::vec3(31.0f)));
+			const uint32_t values[] = { d.x, d.y, d.z, o.x, o.y, o.z };
+			key = interleave6(values);
+		}
+		keys[i] = (static_cast<uint64_t>(key) << 32) | i;
+	}
+	std::vector<uint64_t> sorted;
+	radixSortByKey(keys, sorted);
+
+	aQueue.order.resize(size);
+	for (size_t k = 0; k < size; ++k)
+	{
+		aQueue.order[k] = static_cast<uint32_t>(keys[k]);
+	}
+}
+
+void WavefrontIntegrator::extend(const Scene &aScene, PathQueue &aQueue, uint32_t &aRayCount) const
+{
+	const size_t size = aQueue.size();
+	const bool sorted = !aQueue.order.empty();
+	for (size_t k = 0; k < size; ++k)
+	{
+		size_t i = sorted ? aQueue.order[k] : k;
+		aQueue.hits[i] = aScene.hit(aQueue.rays[i], mOptions.tMin, std::numeric_limits<float>::max(), aQueue.records[i]) ? 1 : 0;
+	}
+	aRayCount += static_cast<uint32_t>(size);
+}
+
+void WavefrontIntegrator::shade(const Scene &aScene, uint32_t aDepth, PathQueue &aQueue, glm::vec3 *aRadiance) const
+{
+	const uint32_t maxDepths[] = { mOptions.maxDiffuseDepth, mOptions.maxSpecularDepth, mOptions.maxTransmissionDepth };
+	const size_t size = aQueue.size();
+	const size_t materialCount = aScene.materialCount();
+
+	// paths that escaped see the sky, paths past the depth limit end in darkness - either way they end here, and the
+	// rest are counted per material
+	std::vector<uint32_t> offsets(materialCount + 1, 0);
+	for (size_t i = 0; i < size; ++i)
+	{
+		aQueue.alive[i] = 0;
+		if (!aQueue.hits[i])
+		{
+			RT_STAT_PATH(StatCounter::PathsEscaped, aDepth + 1);
+			aRadiance[aQueue.slots[i]] = aQueue.throughputs[i] * Integrator::sky(aQueue.rays[i].direction());
+		}
+		else if (aDepth < mOptions.maxDepth)
+		{
+			++offsets[aQueue.records[i].materialId + 1];
+		}
+		else
+		{
+			RT_STAT_PATH(StatCounter::PathsDepthLimited, aDepth + 1);
+		}
+	}
+
+	// counting sort of the paths that hit something by material, keeping queue order within a material
+	for (size_t m = 0; m < materialCount; ++m)
+	{
+		offsets[m + 1] += offsets[m];
+	}
+	std::vector<uint32_t> order(offsets[materialCount]);
+	std::vector<uint32_t> cursors(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (aQueue.hits[i] && aDepth < mOptions.maxDepth)
+		{
+			order[cursors[aQueue.records[i].materialId]++] = static_cast<uint32_t>(i);
+		}
+	}
+
+	for (size_t m = 0; m < materialCount; ++m)
+	{
+		const Material &material = aScene.material(static_cast<uint32_t>(m));
+		for (uint32_t k = offsets[m]; k < offsets[m + 1]; ++k)
+		{
+			uint32_t i = order[k];
+			Sampler &sampler = aQueue.samplers[i];
+			sampler.startBounce(aDepth + 1);
+
+			Ray scattered;
+			glm::vec3 attenuation;
+			ScatterType type;
+			if (!material.scatter(aQueue.rays[i], aQueue.records[i], sampler, attenuation, scattered, type))
+			{
+				RT_STAT_PATH(StatCounter::PathsAbsorbed, aDepth + 1);
+				continue;
+			}
+			uint32_t &typeDepth = aQueue.typeDepths[static_cast<int>(type)][i];
+			if (++typeDepth > maxDepths[static_cast<int>(type)])
+			{
+				RT_STAT_PATH(StatCounter::PathsDepthLimited, aDepth + 1);
+				continue;
+			}
+			glm::vec3 &throughput = aQueue.throughputs[i];
+			throughput *= attenuation;
+
+			// terminate dim paths early - the survivors carry the energy of the terminated ones
+			if (aDepth + 1 >= mOptions.rouletteDepth)
+			{
+				float survival = std::min(0.95f, std::max(throughput.r, std::max(throughput.g, throughput.b)));
+				if (sampler.next1D() >= survival)
+				{
+					RT_STAT_PATH(StatCounter::PathsRouletted, aDepth + 1);
+					continue;
+				}
+				throughput /= survival;
+			}
+
+			aQueue.rays[i] = scattered;
+			aQueue.alive[i] = 1;
+		}
+	}
+}
+
+void WavefrontIntegrator::compact(PathQueue &aQueue) const
+{
+	const size_t size = aQueue.size();
+	size_t count = 0;
+	for (size_t i = 0; i < size; ++i)
+	{
+		if (!aQueue.alive[i])
+		{
+			continue;
+		}
+		if (count != i)
+		{
+			aQueue.rays[count] = aQueue.rays[i];
+			aQueue.throughputs[count] = aQueue.throughputs[i];
+			aQueue.samplers[count] = aQueue.samplers[i];
+			aQueue.slots[count] = aQueue.slots[i];
+			for (auto &depths : aQueue.typeDepths)
+			{
+				depths[count] = depths[i];
+			}
+		}
+		++count;
+	}
+
+	// hit records, hit and alive flags are rewritten by the next bounce before they are read
+	aQueue.resize(count);
+}
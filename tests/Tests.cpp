@@ -0,0 +1,561 @@
+#include "../include/BVH.h"
+#include "../include/Hitable.h"
+#include "../include/Scene.h"
+#include "../include/SphereSet.h"
+#include "../include/TriangleMesh.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// correctness tests over fixed inputs, run by ctest: "tests NAME" runs the test of that name and "tests" runs all of
+// them - the exit status is non-zero if any of them failed, and every failed check is described on stderr
+
+namespace
+{
+	//! a stream of reproducible random numbers
+	class Random
+	{
+	public:
+		Random(uint32_t aSeed) : mEngine(aSeed) {}
+
+		float next() { return mDistribution(mEngine); };
+		float next(float aMin, float aMax) { return aMin + (aMax - aMin) * next(); };
+		glm::vec3 nextVec3(float aMin, float aMax) { float x = next(aMin, aMax); float y = next(aMin, aMax); return { x, y, next(aMin, aMax) }; };
+	private:
+		std::mt19937 mEngine;
+		std::uniform_real_distribution<float> mDistribution;
+	};
+
+	//! reports a failed check and returns aCondition, so that checks can be chained with &=
+	bool check(bool aCondition, const std::string &aMessage)
+	{
+		if (!aCondition)
+		{
+			std::cerr << "  failed: " << aMessage << std::endl;
+		}
+		return aCondition;
+	}
+
+	//! rays from random points on a shell of radius 2 * aExtent towards random points within aExtent of the origin, at
+	//! random times within [0, 1]
+	std::vector<Ray> makeRays(size_t aCount, uint32_t aSeed, float aExtent)
+	{
+		Random random{ aSeed };
+		std::vector<Ray> rays;
+		rays.reserve(aCount);
+		for (size_t i = 0; i < aCount; ++i)
+		{
+			glm::vec3 origin = 2.0f * aExtent * glm::normalize(random.nextVec3(-1.0f, 1.0f) + glm::vec3(1e-3f));
+			glm::vec3 target = random.nextVec3(-aExtent, aExtent);
+			rays.push_back(Ray(origin, target - origin, random.next()));
+		}
+		return rays;
+	}
+
+	//! compares the closest hits of two hitables along every ray and returns true if they agree - the distances may differ
+	//! by rounding, since the intersection kernels do not all evaluate the same expressions in the same order
+	bool sameHits(const Hitable &aHitable, const Hitable &aReference, const std::vector<Ray> &aRays, const std::string &aName)
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		size_t mismatches = 0;
+		size_t hits = 0;
+		for (const Ray &ray : aRays)
+		{
+			HitRecord record;
+			HitRecord reference;
+			bool hit = aHitable.hit(ray, 0.001f, inf, record);
+			bool referenceHit = aReference.hit(ray, 0.001f, inf, reference);
+			bool same = hit == referenceHit;
+			if (same && hit)
+			{
+				same = std::abs(record.t - reference.t) <= 1e-4f * std::max(1.0f, reference.t) && record.materialId == reference.materialId;
+			}
+			mismatches += same ? 0 : 1;
+			hits += referenceHit ? 1 : 0;
+		}
+		return check(mismatches == 0, aName + ": " + std::to_string(mismatches) + " of " + std::to_string(aRays.size()) + " rays disagree")
+			& check(hits > aRays.size() / 10, aName + ": only " + std::to_string(hits) + " rays hit anything");
+	}
+
+	//! random spheres in a box, every third of them moving up during [0, 1], each with a material index of its own
+	struct RandomSpheres
+	{
+		std::vector<glm::vec3> centers;
+		std::vector<glm::vec3> motions;
+		std::vector<float> radii;
+
+		RandomSpheres(uint32_t aCount, uint32_t aSeed, float aExtent)
+		{
+			Random random{ aSeed };
+			for (uint32_t i = 0; i < aCount; ++i)
+			{
+				centers.push_back(random.nextVec3(-aExtent, aExtent));
+				motions.push_back(glm::vec3(0.0f, i % 3 == 0 ? random.next(0.0f, 1.0f) : 0.0f, 0.0f));
+				radii.push_back(random.next(0.2f, 0.6f));
+			}
+		}
+
+		//! adds the spheres to a scene, moving or not
+		void addTo(Scene &aScene) const
+		{
+			for (uint32_t i = 0; i < centers.size(); ++i)
+			{
+				if (motions[i] != glm::vec3(0.0f))
+				{
+					aScene.addMovingSphere(centers[i], centers[i] + motions[i], 0.0f, 1.0f, radii[i], i);
+				}
+				else
+				{
+					aScene.addSphere(centers[i], radii[i], i);
+				}
+			}
+		}
+
+		//! returns the spheres as a list of hitables, which is intersected by brute force
+		HitableListRef list() const
+		{
+			HitableListRef list = HitableList::create();
+			for (uint32_t i = 0; i < centers.size(); ++i)
+			{
+				if (motions[i] != glm::vec3(0.0f))
+				{
+					list->push_back(MovingSphere::create(centers[i], centers[i] + motions[i], 0.0f, 1.0f, radii[i], i));
+				}
+				else
+				{
+					list->push_back(Sphere::create(centers[i], radii[i], i));
+				}
+			}
+			return list;
+		}
+	};
+
+	//! the same scene traversed through binary, 4-wide and 8-wide hierarchies, with and without moving spheres, has to
+	//! find the same hits as testing every sphere
+	bool testTraversal()
+	{
+		bool passed = true;
+		for (bool moving : { false, true })
+		{
+			RandomSpheres spheres{ 5000, 1, 20.0f };
+			if (!moving)
+			{
+				spheres.motions.assign(spheres.centers.size(), glm::vec3(0.0f));
+			}
+			HitableListRef list = spheres.list();
+			std::vector<Ray> rays = makeRays(2000, 2, 20.0f);
+			for (uint32_t width : { 2u, 4u, 8u })
+			{
+				BVHBuildOptions options;
+				options.width = width;
+				Scene scene;
+				spheres.addTo(scene);
+				scene.build(0.0f, 1.0f, options);
+				passed &= sameHits(scene, *list, rays, std::string(moving ? "moving" : "static") + " scene, width " + std::to_string(width));
+			}
+		}
+		return passed;
+	}
+
+	//! a closed mesh approximating a unit sphere, made of aRings rings of aSegments vertices between two poles, with
+	//! counter-clockwise triangles seen from outside
+	TriangleMeshRef closedMesh(uint32_t aRings, uint32_t aSegments)
+	{
+		TriangleMeshRef mesh = TriangleMesh::create();
+		const float pi = 3.14159265f;
+		uint32_t top = mesh->addVertex(glm::vec3(0.0f, 1.0f, 0.0f));
+		for (uint32_t ring = 1; ring <= aRings; ++ring)
+		{
+			float theta = pi * ring / (aRings + 1);
+			for (uint32_t segment = 0; segment < aSegments; ++segment)
+			{
+				float phi = 2.0f * pi * segment / aSegments;
+				mesh->addVertex(glm::vec3(sinf(theta) * cosf(phi), cosf(theta), -sinf(theta) * sinf(phi)));
+			}
+		}
+		uint32_t bottom = mesh->addVertex(glm::vec3(0.0f, -1.0f, 0.0f));
+
+		auto vertex = [&](uint32_t aRing, uint32_t aSegment) { return 1 + aRing * aSegments + aSegment % aSegments; };
+		for (uint32_t segment = 0; segment < aSegments; ++segment)
+		{
+			mesh->addTriangle(top, vertex(0, segment), vertex(0, segment + 1), 0);
+			for (uint32_t ring = 0; ring + 1 < aRings; ++ring)
+			{
+				mesh->addTriangle(vertex(ring, segment), vertex(ring + 1, segment), vertex(ring + 1, segment + 1), 0);
+				mesh->addTriangle(vertex(ring, segment), vertex(ring + 1, segment + 1), vertex(ring, segment + 1), 0);
+			}
+			mesh->addTriangle(vertex(aRings - 1, segment), bottom, vertex(aRings - 1, segment + 1), 0);
+		}
+		return mesh;
+	}
+
+	//! a closed mesh of the cube [-1, 1]^3 whose faces are split into aCells x aCells squares of two triangles each, with
+	//! counter-clockwise triangles seen from outside
+	TriangleMeshRef closedBox(uint32_t aCells)
+	{
+		// the vertices lie on a grid of aCells + 1 points along every axis, and are shared by the faces that meet there
+		TriangleMeshRef mesh = TriangleMesh::create();
+		std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint32_t> vertices;
+		auto vertex = [&](glm::uvec3 aPoint)
+		{
+			auto key = std::make_tuple(aPoint.x, aPoint.y, aPoint.z);
+			auto found = vertices.find(key);
+			if (found == vertices.end())
+			{
+				found = vertices.emplace(key, mesh->addVertex(glm::vec3(aPoint) * (2.0f / aCells) - 1.0f)).first;
+			}
+			return found->second;
+		};
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (uint32_t side = 0; side < 2; ++side)
+			{
+				// u, v and the outward normal form a right-handed frame on the positive side, so the corners are swapped
+				// on the negative one
+				int u = (axis + 1) % 3;
+				int v = (axis + 2) % 3;
+				for (uint32_t i = 0; i < aCells; ++i)
+				{
+					for (uint32_t j = 0; j < aCells; ++j)
+					{
+						glm::uvec3 corners[4];
+						for (uint32_t corner = 0; corner < 4; ++corner)
+						{
+							corners[corner][axis] = side * aCells;
+							corners[corner][u] = i + (corner == 1 || corner == 2 ? 1 : 0);
+							corners[corner][v] = j + (corner >= 2 ? 1 : 0);
+						}
+						uint32_t a = vertex(corners[0]);
+						uint32_t b = vertex(side ? corners[1] : corners[3]);
+						uint32_t c = vertex(corners[2]);
+						uint32_t d = vertex(side ? corners[3] : corners[1]);
+						mesh->addTriangle(a, b, c, 0);
+						mesh->addTriangle(a, c, d, 0);
+					}
+				}
+			}
+		}
+		return mesh;
+	}
+
+	//! returns the number of rays that miss a mesh
+	size_t countMisses(const TriangleMesh &aMesh, const std::vector<Ray> &aRays)
+	{
+		size_t misses = 0;
+		for (const Ray &ray : aRays)
+		{
+			HitRecord record;
+			misses += aMesh.hit(ray, 0.0f, std::numeric_limits<float>::infinity(), record) ? 0 : 1;
+		}
+		return misses;
+	}
+
+	//! rays through the vertices and edges of a closed mesh, where neighbouring triangles meet, have to hit it - from
+	//! inside as well as from outside
+	bool testWatertight()
+	{
+		// a round mesh, aimed at every vertex and the middle of every edge from random points inside and outside
+		TriangleMeshRef sphere = closedMesh(32, 48);
+		sphere->build();
+		std::vector<Ray> sphereRays;
+		Random random{ 3 };
+		const uint32_t *indices = sphere->indices();
+		for (size_t i = 0; i < sphere->triangleCount(); ++i)
+		{
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				glm::vec3 a = sphere->position(indices[3 * i + corner]);
+				glm::vec3 b = sphere->position(indices[3 * i + (corner + 1) % 3]);
+				for (const glm::vec3 &target : { a, 0.5f * (a + b) })
+				{
+					glm::vec3 inside = random.nextVec3(-0.2f, 0.2f);
+					glm::vec3 outside = 3.0f * glm::normalize(target) + random.nextVec3(-0.5f, 0.5f);
+					sphereRays.push_back(Ray(inside, target - inside));
+					sphereRays.push_back(Ray(outside, target - outside));
+				}
+			}
+		}
+
+		// a box, hit head-on by rays along the axes through every point of its faces on a grid of half a cell - the
+		// vertices, edges and diagonals there are exactly representable, so the rays pass exactly through them
+		const uint32_t cells = 4;
+		TriangleMeshRef box = closedBox(cells);
+		box->build();
+		std::vector<Ray> boxRays;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			for (uint32_t i = 1; i < 2 * cells; ++i)
+			{
+				for (uint32_t j = 1; j < 2 * cells; ++j)
+				{
+					glm::vec3 point{ 0.0f };
+					point[(axis + 1) % 3] = i * (1.0f / cells) - 1.0f;
+					point[(axis + 2) % 3] = j * (1.0f / cells) - 1.0f;
+					glm::vec3 direction{ 0.0f };
+					direction[axis] = 1.0f;
+					for (float sign : { -1.0f, 1.0f })
+					{
+						glm::vec3 outside = point;
+						outside[axis] = 3.0f * sign;
+						boxRays.push_back(Ray(point, sign * direction));
+						boxRays.push_back(Ray(outside, -sign * direction));
+					}
+				}
+			}
+		}
+
+		size_t sphereMisses = countMisses(*sphere, sphereRays);
+		size_t boxMisses = countMisses(*box, boxRays);
+		return check(sphereMisses == 0, std::to_string(sphereMisses) + " of " + std::to_string(sphereRays.size()) + " rays through the vertices and edges of a round mesh miss")
+			& check(boxMisses == 0, std::to_string(boxMisses) + " of " + std::to_string(boxRays.size()) + " rays through the vertices and edges of a box miss");
+	}
+
+	//! a scene saved to a cache and loaded again has to find the same hits, and the cache must be rejected for another
+	//! key or once it is cut short
+	bool testSceneCache()
+	{
+		const std::string path = "tests_scene.cache";
+		const uint64_t key = 0x1234;
+		RandomSpheres spheres{ 3000, 4, 15.0f };
+		Scene scene;
+		spheres.addTo(scene);
+		scene.build(0.0f, 1.0f);
+
+		bool passed = check(scene.saveCache(path, key), "the scene cannot be saved");
+		SceneRef loaded = Scene::loadCache(path, key);
+		passed &= check(loaded != nullptr, "the saved scene cannot be loaded");
+		if (loaded)
+		{
+			passed &= sameHits(*loaded, scene, makeRays(2000, 5, 15.0f), "loaded scene");
+		}
+		passed &= check(Scene::loadCache(path, key + 1) == nullptr, "a cache is accepted for another key");
+
+		// the same file without its last bytes
+		std::vector<char> bytes;
+		{
+			std::ifstream file{ path, std::ios::binary };
+			bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		{
+			std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+			file.write(bytes.data(), bytes.size() / 2);
+		}
+		passed &= check(Scene::loadCache(path, key) == nullptr, "a truncated cache is accepted");
+		std::remove(path.c_str());
+		return passed;
+	}
+
+	//! refitting sphere sets, meshes and scenes to moved primitives has to find the same hits as building them anew - both
+	//! when the hierarchy is refitted and when it rebuilds itself and reorders the primitives, which the next refit has
+	//! to take into account
+	bool testRefit()
+	{
+		bool passed = true;
+		Random random{ 6 };
+		// moving the primitives never makes the hierarchies rebuild themselves, only adding primitives does, so that the
+		// test knows which of the two happens
+		BVHBuildOptions options;
+		options.refitCostLimit = std::numeric_limits<float>::max();
+
+		// a sphere set, compared against one built from the moved spheres
+		{
+			RandomSpheres spheres{ 3000, 7, 15.0f };
+			SphereSet set;
+			for (uint32_t i = 0; i < spheres.centers.size(); ++i)
+			{
+				set.push_back(spheres.centers[i], spheres.radii[i], i);
+			}
+			set.build(options);
+
+			auto compare = [&](const std::string &aName)
+			{
+				SphereSet rebuilt;
+				for (uint32_t i = 0; i < spheres.centers.size(); ++i)
+				{
+					rebuilt.push_back(spheres.centers[i], spheres.radii[i], i);
+				}
+				rebuilt.build();
+				passed &= sameHits(set, rebuilt, makeRays(2000, 8, 15.0f), aName);
+			};
+			auto move = [&]()
+			{
+				for (uint32_t i = 0; i < spheres.centers.size(); ++i)
+				{
+					spheres.centers[i] += random.nextVec3(-1.0f, 1.0f);
+					set.setCenter(i, spheres.centers[i]);
+				}
+			};
+
+			move();
+			set.refit();
+			compare("refitted sphere set");
+
+			// a new sphere rebuilds the set, and the refit after that has to find the spheres where they now are
+			spheres.centers.push_back(glm::vec3(0.0f));
+			spheres.radii.push_back(1.0f);
+			set.push_back(spheres.centers.back(), spheres.radii.back(), static_cast<uint32_t>(spheres.centers.size() - 1));
+			set.refit();
+			compare("rebuilt sphere set");
+			move();
+			set.refit();
+			compare("sphere set refitted after a rebuild");
+		}
+
+		// a mesh deformed by moving its vertices, compared against the same mesh built from scratch
+		{
+			TriangleMeshRef mesh = closedMesh(24, 32);
+			std::vector<glm::vec3> positions;
+			for (uint32_t i = 0; i < mesh->vertexCount(); ++i)
+			{
+				positions.push_back(mesh->position(i));
+			}
+			mesh->build(options);
+
+			// triangles added to the mesh after it was first built
+			std::vector<glm::uvec3> added;
+			auto compare = [&](const std::string &aName)
+			{
+				TriangleMeshRef rebuilt = closedMesh(24, 32);
+				for (uint32_t i = 0; i < mesh->vertexCount(); ++i)
+				{
+					rebuilt->setPosition(i, mesh->position(i));
+				}
+				for (const glm::uvec3 &triangle : added)
+				{
+					rebuilt->addTriangle(triangle.x, triangle.y, triangle.z, 0);
+				}
+				rebuilt->build();
+				passed &= sameHits(*mesh, *rebuilt, makeRays(2000, 9, 1.2f), aName);
+			};
+			auto move = [&]()
+			{
+				for (uint32_t i = 0; i < mesh->vertexCount(); ++i)
+				{
+					mesh->setPosition(i, positions[i] * random.next(0.8f, 1.2f));
+				}
+			};
+
+			move();
+			mesh->refit();
+			compare("refitted mesh");
+
+			// a new triangle - a cap across the top of the mesh - rebuilds it, so the triangles end up in another order
+			added.push_back(glm::uvec3(1, 9, 17));
+			mesh->addTriangle(added.back().x, added.back().y, added.back().z, 0);
+			mesh->refit();
+			compare("rebuilt mesh");
+			move();
+			mesh->refit();
+			compare("mesh refitted after a rebuild");
+		}
+
+		// a scene of static and moving spheres, compared against testing every sphere
+		{
+			RandomSpheres spheres{ 3000, 10, 15.0f };
+			Scene scene;
+			spheres.addTo(scene);
+			scene.build(0.0f, 1.0f, options);
+
+			// spheres are moved by their index among the spheres of their own type, in the order they were added
+			auto move = [&](Scene &aScene)
+			{
+				uint32_t sphere = 0;
+				uint32_t movingSphere = 0;
+				for (uint32_t i = 0; i < spheres.centers.size(); ++i)
+				{
+					spheres.centers[i] += random.nextVec3(-1.0f, 1.0f);
+					if (spheres.motions[i] != glm::vec3(0.0f))
+					{
+						aScene.setMovingSphereCenters(movingSphere++, spheres.centers[i], spheres.centers[i] + spheres.motions[i]);
+					}
+					else
+					{
+						aScene.setSphereCenter(sphere++, spheres.centers[i]);
+					}
+				}
+			};
+			auto compare = [&](const Scene &aScene, const std::string &aName)
+			{
+				passed &= sameHits(aScene, *spheres.list(), makeRays(2000, 11, 15.0f), aName);
+			};
+
+			move(scene);
+			scene.refit(0.0f, 1.0f);
+			compare(scene, "refitted scene");
+
+			// a new static sphere rebuilds the scene
+			spheres.centers.push_back(glm::vec3(0.0f));
+			spheres.motions.push_back(glm::vec3(0.0f));
+			spheres.radii.push_back(1.0f);
+			scene.addSphere(spheres.centers.back(), spheres.radii.back(), static_cast<uint32_t>(spheres.centers.size() - 1));
+			scene.refit(0.0f, 1.0f);
+			compare(scene, "rebuilt scene");
+			move(scene);
+			scene.refit(0.0f, 1.0f);
+			compare(scene, "scene refitted after a rebuild");
+
+			// a scene loaded from a cache keeps track of where its spheres are stored as well
+			const std::string path = "tests_refit.cache";
+			passed &= check(scene.saveCache(path, 0), "the refitted scene cannot be saved");
+			SceneRef loaded = Scene::loadCache(path, 0);
+			std::remove(path.c_str());
+			passed &= check(loaded != nullptr, "the refitted scene cannot be loaded");
+			if (loaded)
+			{
+				move(*loaded);
+				loaded->refit(0.0f, 1.0f);
+				compare(*loaded, "loaded scene refitted");
+			}
+		}
+
+		return passed;
+	}
+
+	//! a test and the name it is run by
+	struct Test
+	{
+		const char *name;
+		std::function<bool()> run;
+	};
+}
+
+int main(int argc, char **argv)
+{
+	const std::vector<Test> tests = {
+		{ "traversal", testTraversal },
+		{ "watertight", testWatertight },
+		{ "scene_cache", testSceneCache },
+		{ "refit", testRefit },
+	};
+
+	int failed = 0;
+	int run = 0;
+	for (const Test &test : tests)
+	{
+		if (argc > 1 && test.name != std::string(argv[1]))
+		{
+			continue;
+		}
+		bool passed = test.run();
+		std::cout << (passed ? "passed: " : "FAILED: ") << test.name << std::endl;
+		failed += passed ? 0 : 1;
+		++run;
+	}
+	if (run == 0)
+	{
+		std::cerr << "No test named " << argv[1] << std::endl;
+		return 1;
+	}
+	return failed == 0 ? 0 : 1;
+}